@@ -33,6 +33,18 @@
 #define PHY_PAGE_NUM 20
 #define PHY_ADDR 32 // = PHY_PAGE_NUM + PAGE_OFFSET
 
+/* a PUD (resp. PMD) entry with this bit set directly maps a 1 GiB (resp. 2 MiB)
+ * page instead of pointing to the next level table (same bit as x86 "PS")
+ */
+#define PTE_PAGE_SIZE_BIT 0x80
+
+/* physical address of the PGD of the default address space; each other
+ * address space (ASID) has its own PGD, anywhere in memory (page aligned)
+ */
+#define PGD_DEFAULT_ROOT 0
+#define HUGE_2M_OFFSET 21 // = PMD_PREV_SIZE
+#define HUGE_1G_OFFSET 30 // = PUD_PREV_SIZE
+
 /**
  * @brief type representing a word in memory
  */
@@ -48,6 +60,35 @@ typedef uint8_t byte_t;
  */
 typedef uint32_t pte_t;
 
+/**
+ * @brief size of the page mapped by a translation
+ */
+typedef enum
+{
+	PAGE_4K,
+	PAGE_2M,
+	PAGE_1G,
+	NB_PAGE_SIZES
+} page_size_t;
+
+/**
+ * @brief number of low virtual page number bits covered by a page of size S
+ * (i.e. 0 for 4 kiB, 9 for 2 MiB and 18 for 1 GiB pages)
+ */
+#define page_size_vpn_bits(S) ((S) * PTE_ENTRY)
+
+/**
+ * @brief an address space: its identifier (ASID), which tags TLB entries,
+ * and the physical address of its page-table root (PGD)
+ */
+typedef struct
+{
+	uint16_t asid;
+	pte_t pgd;
+} addr_space_t;
+
+#define ADDR_SPACE_DEFAULT { 0, PGD_DEFAULT_ROOT }
+
 /**
  * @brief type representing a virtual address in memory organized in 4 chunks of 
  * 9 bits a page offset  of 12 bits (shared by the the physical address) 
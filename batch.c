@@ -0,0 +1,71 @@
+/**
+ * @file batch.c
+ * @brief tool running a batch of simulations given by a manifest on a
+ * work-stealing pool of threads, printing the results of all of them.
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32 || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "error.h"
+#include "sim_batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// ======================================================================
+static void error(const char *pgm, const char *msg)
+{
+    assert(msg != NULL);
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s manifest_filename [nb_threads [segment_lines [warmup_lines]]]\n", pgm);
+    fprintf(stderr, "examples: %s nightly.txt\n", pgm);
+    fprintf(stderr, "          %s nightly.txt 8 100000 10000\n", pgm);
+    fprintf(stderr, "(one job per line of manifest_filename: (dump|desc|image) memory_filename command_filename [config],\n"
+                    " see sim_config_parse() for the configuration; traces longer than segment_lines (if not 0)\n"
+                    " are split into segments, each warmed up by the warmup_lines commands before it)\n");
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        error(argv[0], "please provide a manifest filename:");
+        return 1;
+    }
+    size_t values[3] = { 1, 0, 0 }; // threads, segment lines, warm-up lines
+    for (int k = 2; k < argc && k < 5; ++k)
+    {
+        if (sscanf(argv[k], "%zu", &values[k - 2]) != 1)
+        {
+            error(argv[0], "wrong number.");
+            return 1;
+        }
+    }
+
+    sim_job_t *jobs = NULL;
+    size_t nb_jobs = 0;
+    if (sim_batch_read(argv[1], &jobs, &nb_jobs) != ERR_NONE)
+    {
+        error(argv[0], "problem reading the jobs from provided manifest.");
+        return 3;
+    }
+
+    int err = sim_batch_run(jobs, nb_jobs, values[0], values[1], values[2]);
+    if (err == ERR_NONE)
+        err = sim_batch_print(stdout, jobs, nb_jobs);
+    if (err != ERR_NONE)
+        fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+    int failed = 0;
+    for (size_t k = 0; k < nb_jobs; ++k)
+        failed |= jobs[k].error != ERR_NONE;
+
+    sim_batch_free(jobs, nb_jobs);
+    return err != ERR_NONE ? 4 : failed ? 5 : 0;
+}
@@ -82,11 +82,25 @@ typedef struct l1_icache_entry_
     word_t line[L1_ICACHE_WORDS_PER_LINE];
 } l1_icache_entry_t;
 
+/**
+ * @brief coherence state of a line of an L1 data cache, in multi-core mode
+ * (see multicore.h); MESI_OWNED is only used by MOESI
+ */
+typedef enum
+{
+    MESI_INVALID,
+    MESI_SHARED,
+    MESI_EXCLUSIVE,
+    MESI_MODIFIED,
+    MESI_OWNED
+} mesi_state_t;
+
 typedef struct l1_dcache_entry_
 {
 
     uint8_t v : 1;
     uint8_t age : 2;
+    uint8_t state : 3; // mesi_state_t, only maintained in multi-core mode
     uint32_t tag : 22;
     word_t line[L1_DCACHE_WORDS_PER_LINE];
 } l1_dcache_entry_t;
@@ -105,6 +119,7 @@ typedef enum cache_
     L1_DCACHE,
     L2_CACHE
 } cache_t;
+#define NB_CACHE_TYPES 3
 
 // --------------------------------------------------
 #define cache_cast(TYPE) ((TYPE *)cache)
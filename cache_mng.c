@@ -51,12 +51,12 @@ int cache_flush(void *cache, cache_t cache_type)
 
 //=========================================================================
 
-static inline uint32_t compose_phys_addr(phy_addr_t *paddr)
+static inline uint32_t compose_phys_addr(const phy_addr_t *paddr)
 {
     uint32_t a = (paddr->phy_page_num << PAGE_OFFSET) | paddr->page_offset;
     return a;
 }
-static uint32_t index_for_paddr(phy_addr_t *paddr, cache_t cache_type)
+static uint32_t index_for_paddr(const phy_addr_t *paddr, cache_t cache_type)
 {
     switch (cache_type)
     {
@@ -166,7 +166,7 @@ int cache_entry_init(const void *mem_space, const phy_addr_t *paddr, void *cache
     ((type *)cache_entry)->tag = phys >> shift_value;                            \
     for (size_t i = 0; i < words_per_line; i++)                                  \
     {                                                                            \
-        ((type *)cache_entry)->line[i] = ((word_t *)mem_space)[(phys >> 2) + i]; \
+        ((type *)cache_entry)->line[i] = ((word_t *)mem_space)[((phys >> 4) << 2) + i]; \
     }
     M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(paddr);
@@ -191,223 +191,271 @@ int cache_entry_init(const void *mem_space, const phy_addr_t *paddr, void *cache
     }
     return ERR_NONE;
 }
-static int isWordAligned(phy_addr_t *paddr)
-{
-    int ret = compose_phys_addr(paddr) % 4 ? ERR_NONE : ERR_BAD_PARAMETER;
-    return ret;
-}
-
-static void entry_to_evict(phy_addr_t *paddr, void *cache, uint8_t *evict, uint8_t *way_to_write, cache_t cache_type)
-{
-
-#define find_entry_to_evict(type, ways, lines, words_per_line, cache_type)        \
-    do                                                                            \
-    {                                                                             \
-        uint32_t line_index = index_for_paddr(paddr, cache_type);                 \
-        *evict = 1;                                                               \
-        *way_to_write = 0;                                                        \
-        uint8_t oldest_way = 0;                                                   \
-        foreach_way(j, ways)                                                      \
-        {                                                                         \
-            if (!cache_valid(type, ways, line_index, j))                          \
-            {                                                                     \
-                *evict = 0;                                                       \
-                *way_to_write = j;                                                \
-                return;                                                           \
-            }                                                                     \
-            else if (cache_age(type, L1_ICACHE_WAYS, line_index, j) > oldest_way) \
-            {                                                                     \
-                *way_to_write = j;                                                \
-                oldest_way = cache_age(type, L1_ICACHE_WAYS, line_index, j);      \
-            }                                                                     \
-        }                                                                         \
-    } while (0);
+// ======================================================================
+// cache line placement (exclusive hierarchy: L1 victims go to L2, L2 victims are dropped)
 
-    M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(cache);
-    M_REQUIRE_NON_NULL(evict);
-    M_REQUIRE_NON_NULL(way_to_write);
+// number of bits of the set index of a cache
+#define L1_ICACHE_INDEX_BITS 6 // log_2(L1_ICACHE_LINES)
+#define L1_DCACHE_INDEX_BITS 6 // log_2(L1_DCACHE_LINES)
+#define L2_CACHE_INDEX_BITS 9  // log_2(L2_CACHE_LINES)
+#define LINE_OFFSET_BITS 4     // log_2(L1_ICACHE_LINE)
+
+// physical address of the first byte of the line held in the given set with the given tag
+static uint32_t line_paddr(uint32_t tag, uint32_t index, cache_t cache_type)
+{
+    const uint8_t remaining = cache_type == L2_CACHE ? L2_CACHE_TAG_REMANING : L1_ICACHE_TAG_REMANING;
+    return (tag << remaining) | (index << LINE_OFFSET_BITS);
+}
+
+/*
+ * Inserts the line starting at physical address line_addr, holding the given
+ * words, in its set: in the first invalid way if any (ages of the set increased),
+ * otherwise in place of the least recently used way (ages updated).
+ * *evicted tells whether a valid line was replaced; if so, *evicted_addr and
+ * evicted_words get it.
+ */
+static int cache_place(void *cache, cache_t cache_type, uint32_t line_addr, const word_t *words,
+                       int *evicted, uint32_t *evicted_addr, word_t *evicted_words)
+{
+#define place(TYPE, WAYS, LINES, REMAINING, WORDS_PER_LINE)                                              \
+    do                                                                                                \
+    {                                                                                                 \
+        const uint16_t index = (uint16_t)((line_addr >> LINE_OFFSET_BITS) % (LINES));                 \
+        uint8_t way = 0;                                                                              \
+        while (way < (WAYS) && cache_valid(TYPE, WAYS, index, way))                                   \
+            ++way;                                                                                    \
+        *evicted = way == (WAYS);                                                                     \
+        if (*evicted)                                                                                  \
+        {                                                                                             \
+            way = 0;                                                                                  \
+            foreach_way(j, WAYS) if (cache_age(TYPE, WAYS, index, j) > cache_age(TYPE, WAYS, index, way)) \
+                way = j;                                                                              \
+            *evicted_addr = line_paddr(cache_tag(TYPE, WAYS, index, way), index, cache_type);         \
+            memcpy(evicted_words, cache_line(TYPE, WAYS, index, way), (WORDS_PER_LINE) * sizeof(word_t)); \
+        }                                                                                             \
+        TYPE entry;                                                                                   \
+        memset(&entry, 0, sizeof(TYPE));                                                              \
+        entry.v = 1;                                                                                  \
+        entry.age = 0;                                                                                \
+        entry.tag = line_addr >> (REMAINING);                                                         \
+        memcpy(entry.line, words, (WORDS_PER_LINE) * sizeof(word_t));                                 \
+        M_EXIT_IF_ERR(cache_insert(index, way, &entry, cache, cache_type), "inserting a cache line"); \
+        if (*evicted)                                                                                 \
+        {                                                                                             \
+            LRU_age_update(TYPE, WAYS, way, index);                                                   \
+        }                                                                                             \
+        else                                                                                          \
+        {                                                                                             \
+            LRU_age_increase(TYPE, WAYS, way, index);                                                 \
+        }                                                                                             \
+        return ERR_NONE;                                                                              \
+    } while (0)
 
     switch (cache_type)
     {
     case L1_ICACHE:
-    {
-        find_entry_to_evict(l1_icache_entry_t, L1_ICACHE_WAYS, L1_ICACHE_LINES, L1_ICACHE_WORDS_PER_LINE, L1_ICACHE);
-        break;
-    }
+        place(l1_icache_entry_t, L1_ICACHE_WAYS, L1_ICACHE_LINES, L1_ICACHE_TAG_REMANING, L1_ICACHE_WORDS_PER_LINE);
     case L1_DCACHE:
-    {
-        find_entry_to_evict(l1_dcache_entry_t, L1_DCACHE_WAYS, L1_DCACHE_LINES, L1_DCACHE_WORDS_PER_LINE, L1_DCACHE);
-        break;
-    }
+        place(l1_dcache_entry_t, L1_DCACHE_WAYS, L1_DCACHE_LINES, L1_DCACHE_TAG_REMANING, L1_DCACHE_WORDS_PER_LINE);
     case L2_CACHE:
-    {
-        find_entry_to_evict(l2_cache_entry_t, L2_CACHE_WAYS, L2_CACHE_LINES, L2_CACHE_WORDS_PER_LINE, L2_CACHE);
-        break;
-    }
+        place(l2_cache_entry_t, L2_CACHE_WAYS, L2_CACHE_LINES, L2_CACHE_TAG_REMANING, L2_CACHE_WORDS_PER_LINE);
     default:
-        break;
+        M_EXIT(ERR_BAD_PARAMETER, "unknown cache type %d", cache_type);
     }
 }
 
-static l2_cache_entry_t transform_l1_entry_to_l2(void *l1_entry, cache_t source_type)
+// a permutation of the L2 set indexes (multiplications by odd numbers and
+// xorshifts are bijective modulo a power of 2), to spread the sampled sets
+static uint16_t set_shuffle(uint16_t index)
+{
+    uint32_t h = index;
+    h = (h * 0x9Du) % L2_CACHE_LINES;
+    h ^= h >> 5;
+    h = (h * 0x13Bu) % L2_CACHE_LINES;
+    h ^= h >> 4;
+    return (uint16_t)h;
+}
+
+int cache_l2_set_sampled(const cache_sampling_t *sampling, uint16_t index)
 {
-    l2_cache_entry_t newEntry;
-    newEntry.age = 0;
-    newEntry.v = 1;
-    switch (source_type)
+    if (sampling == NULL || sampling->one_in <= 1)
+        return 1;
+    return set_shuffle(index % L2_CACHE_LINES) < L2_CACHE_LINES / sampling->one_in;
+}
+
+// whether the L2 set of the line starting at physical address line_addr is simulated
+static int line_sampled(const cache_sampling_t *sampling, uint32_t line_addr)
+{
+    return cache_l2_set_sampled(sampling, (uint16_t)((line_addr >> LINE_OFFSET_BITS) % L2_CACHE_LINES));
+}
+
+// brings a line into L1; its L1 victim, if any, is moved to L2 (if its set is simulated)
+static int l1_fill(void *l1_cache, cache_t l1_type, void *l2_cache, uint32_t line_addr, const word_t *words,
+                   const cache_sampling_t *sampling)
+{
+    int evicted = 0;
+    uint32_t evicted_addr = 0;
+    word_t evicted_words[L1_ICACHE_WORDS_PER_LINE];
+    M_EXIT_IF_ERR(cache_place(l1_cache, l1_type, line_addr, words, &evicted, &evicted_addr, evicted_words), "placing a line in L1");
+    if (evicted && line_sampled(sampling, evicted_addr))
     {
-    case L1_ICACHE:
+        int dropped = 0;
+        uint32_t dropped_addr = 0;
+        word_t dropped_words[L2_CACHE_WORDS_PER_LINE];
+        M_EXIT_IF_ERR(cache_place(l2_cache, L2_CACHE, evicted_addr, evicted_words, &dropped, &dropped_addr, dropped_words),
+                      "placing an L1 victim in L2");
+    }
+    return ERR_NONE;
+}
+
+/*
+ * Finds the line holding a physical address: in L1 (the line is returned), in L2 (it is
+ * moved to L1) or in memory (it is brought into L1). *served_by gets the cache which hit,
+ * NB_CACHE_TYPES for memory, or CACHE_UNSAMPLED if L2 was skipped (its set is not
+ * simulated). Returns the (L1) line through p_line.
+ */
+static int line_fetch(const void *mem_space, phy_addr_t *paddr, cache_t l1_type,
+                      void *l1_cache, void *l2_cache, const cache_sampling_t *sampling,
+                      word_t **p_line, int *served_by)
+{
+    const word_t *line = NULL;
+    uint8_t hit_way = HIT_WAY_MISS;
+    uint16_t hit_index = HIT_INDEX_MISS;
+    M_EXIT_IF_ERR(cache_hit(mem_space, l1_cache, paddr, &line, &hit_way, &hit_index, l1_type), "looking L1 up");
+    if (hit_way != HIT_WAY_MISS)
     {
-        memcpy(newEntry.line, ((l1_icache_entry_t *)l1_entry)->line, L1_ICACHE_WORDS_PER_LINE * sizeof(word_t));
-        newEntry.tag = ((l1_icache_entry_t *)l1_entry)->tag >> 3;
+        *p_line = (word_t *)line;
+        *served_by = l1_type;
+        return ERR_NONE;
     }
-    break;
-    case L1_DCACHE:
+
+    const uint32_t line_addr = compose_phys_addr(paddr) & ~(uint32_t)(L1_ICACHE_LINE - 1);
+    word_t words[L1_ICACHE_WORDS_PER_LINE];
+    // L2 is only looked up if the set of the line is simulated (hit_way is still a miss otherwise)
+    const int sampled = line_sampled(sampling, line_addr);
+    if (sampled)
+        M_EXIT_IF_ERR(cache_hit(mem_space, l2_cache, paddr, &line, &hit_way, &hit_index, L2_CACHE), "looking L2 up");
+    if (hit_way != HIT_WAY_MISS)
     {
-        memcpy(newEntry.line, ((l1_dcache_entry_t *)l1_entry)->line, L1_DCACHE_WORDS_PER_LINE * sizeof(word_t));
-        newEntry.tag = ((l1_dcache_entry_t *)l1_entry)->tag >> 3;
+        // exclusive: the line moves from L2 to L1
+        void *cache = l2_cache; // for cache_valid()
+        memcpy(words, line, sizeof(words));
+        cache_valid(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way) = 0;
+        *served_by = L2_CACHE;
     }
-    break;
-    default:
-        break;
+    else
+    {
+        memcpy(words, (const word_t *)mem_space + (line_addr >> 2), sizeof(words));
+        *served_by = sampled ? NB_CACHE_TYPES : CACHE_UNSAMPLED;
     }
-    return newEntry;
+    M_EXIT_IF_ERR(l1_fill(l1_cache, l1_type, l2_cache, line_addr, words, sampling), "filling L1");
+
+    M_EXIT_IF_ERR(cache_hit(mem_space, l1_cache, paddr, &line, &hit_way, &hit_index, l1_type), "looking L1 up");
+    M_REQUIRE(hit_way != HIT_WAY_MISS, ERR_BAD_PARAMETER, "line of 0x%08" PRIX32 " not found after fill", line_addr);
+    *p_line = (word_t *)line;
+    return ERR_NONE;
 }
 
-static phy_addr_t paddr_from_index_and_tag(uint16_t index, uint32_t tag, cache_t source_cache)
+//=========================================================================
+int cache_lookup(void *cache, const phy_addr_t *paddr, cache_t cache_type, void **entry)
 {
-    uint32_t addr = 0;
-    switch (source_cache)
+#define lookup(TYPE, WAYS, LINES, REMAINING)                                          \
+    do                                                                                \
+    {                                                                                 \
+        const uint32_t phys_addr = compose_phys_addr(paddr);                          \
+        const uint16_t index = (uint16_t)((phys_addr >> LINE_OFFSET_BITS) % (LINES)); \
+        foreach_way(j, WAYS)                                                          \
+        {                                                                             \
+            if (cache_valid(TYPE, WAYS, index, j)                                     \
+                && cache_tag(TYPE, WAYS, index, j) == phys_addr >> (REMAINING))       \
+            {                                                                         \
+                *entry = cache_entry(TYPE, WAYS, index, j);                           \
+                return ERR_NONE;                                                      \
+            }                                                                         \
+        }                                                                             \
+        return ERR_NONE;                                                              \
+    } while (0)
+
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(entry);
+    *entry = NULL;
+    switch (cache_type)
     {
-    case L1_ICACHE || L1_DCACHE:
-        addr = (tag << 10) | (index << 4);
-        break;
+    case L1_ICACHE:
+        lookup(l1_icache_entry_t, L1_ICACHE_WAYS, L1_ICACHE_LINES, L1_ICACHE_TAG_REMANING);
+    case L1_DCACHE:
+        lookup(l1_dcache_entry_t, L1_DCACHE_WAYS, L1_DCACHE_LINES, L1_DCACHE_TAG_REMANING);
     case L2_CACHE:
-        addr = (tag << 13) | (index << 4);
-        break;
+        lookup(l2_cache_entry_t, L2_CACHE_WAYS, L2_CACHE_LINES, L2_CACHE_TAG_REMANING);
     default:
-        break;
+        M_EXIT(ERR_BAD_PARAMETER, "unknown cache type %d", cache_type);
+    }
+}
+
+//=========================================================================
+int cache_fill(phy_addr_t *paddr, cache_t l1_type, void *l1_cache, void *l2_cache, const word_t *words)
+{
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(words);
+    M_REQUIRE(l1_type == L1_ICACHE || l1_type == L1_DCACHE, ERR_BAD_PARAMETER, "%d is not an L1 cache", l1_type);
+    void *entry = NULL;
+    M_EXIT_IF_ERR(cache_lookup(l1_cache, paddr, l1_type, &entry), "looking L1 up");
+    if (entry != NULL)
+        return ERR_NONE;
+    // exclusive: an L2 copy would be duplicated
+    M_EXIT_IF_ERR(cache_lookup(l2_cache, paddr, L2_CACHE, &entry), "looking L2 up");
+    if (entry != NULL)
+        ((l2_cache_entry_t *)entry)->v = 0;
+    const uint32_t line_addr = compose_phys_addr(paddr) & ~(uint32_t)(L1_ICACHE_LINE - 1);
+    return l1_fill(l1_cache, l1_type, l2_cache, line_addr, words, NULL);
+}
+
+static void count(cache_stats_t *stats, int served_by)
+{
+    if (stats != NULL)
+    {
+        if (served_by == CACHE_UNSAMPLED)
+            stats->unsampled++;
+        else if (served_by == NB_CACHE_TYPES)
+            stats->misses++;
+        else
+            stats->hits[served_by]++;
     }
-    phy_addr_t p;
-    init_phy_addr(&p, addr >> PAGE_OFFSET, addr & 0xFFF);
-    return p;
 }
 
 //=========================================================================
 int cache_read(const void *mem_space, phy_addr_t *paddr, mem_access_t access, void *l1_cache, void *l2_cache, uint32_t *word, cache_replace_t replace)
 {
+    return cache_read_with_stats(mem_space, paddr, access, l1_cache, l2_cache, word, replace, NULL);
+}
 
-#define cache_read_modular(type, words_per_line, ways, cache_type)                                                                                                                            \
-    do                                                                                                                                                                                        \
-    {                                                                                                                                                                                         \
-        void *cache = l1_cache;                                                                                                                                                               \
-        word_t *p_line;                                                                                                                                                                       \
-        M_EXIT_IF_ERR(cache_hit(mem_space, cache, paddr, &p_line, &hit_way, &hit_index, cache_type), "Error in cache hit");                                                                   \
-        if (hit_way != HIT_WAY_MISS)                                                                                                                                                          \
-        {                                                                                                                                                                                     \
-            *word = p_line[(paddr->page_offset >> 2) % words_per_line];                                                                                                                       \
-            LRU_age_update(type, ways, hit_way, hit_index);                                                                                                                                   \
-        }                                                                                                                                                                                     \
-        else                                                                                                                                                                                  \
-        {                                                                                                                                                                                     \
-            cache = l2_cache;                                                                                                                                                                 \
-            M_EXIT_IF_ERR(cache_hit(mem_space, cache, paddr, &p_line, &hit_way, &hit_index, L2_CACHE), "Error in cache hit");                                                                 \
-            if (hit_way != HIT_WAY_MISS)                                                                                                                                                      \
-            {                                                                                                                                                                                 \
-                type new_l1_entry;                                                                                                                                                            \
-                *word = p_line[(paddr->page_offset >> 2) % words_per_line];                                                                                                                   \
-                new_l1_entry.age = 0;                                                                                                                                                         \
-                new_l1_entry.v = 1;                                                                                                                                                           \
-                M_REQUIRE_NON_NULL_CUSTOM_ERR(memcpy(new_l1_entry.line, cache_line(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way), L2_CACHE_WORDS_PER_LINE * sizeof(word_t)), ERR_MEM); \
-                new_l1_entry.tag = (cache_tag(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way) << 3) | (hit_index >> 6);                                                                  \
-                uint8_t evict = 1;               ;                                                                                                                                             \
-                uint8_t way_to_write = 0;                                                                                                                                                     \
-                entry_to_evict(paddr, l1_cache, &evict, &way_to_write, cache_type);                                                                                                           \
-                if (evict)                                                                                                                                                                    \
-                {                                                                                                                                                                             \
-                    cache = l1_cache;                                                                                                                                                         \
-                    l2_cache_entry_t new_l2_entry = transform_l1_entry_to_l2(cache_entry(type, ways, index_for_paddr(paddr, cache_type), way_to_write), L1_ICACHE);                           \
-                    cache = l2_cache;                                                                                                                                                         \
-                                                                                                                                                                                              \
-                    M_EXIT_IF_ERR(cache_insert(index_for_paddr(paddr, cache_type), way_to_write, &new_l1_entry, l1_cache, cache_type), "Error in cache insert");                              \
-                    phy_addr_t first_word_paddr = paddr_from_index_and_tag(hit_index, new_l2_entry.tag, L2_CACHE);                                                                            \
-                                                                                                                                                                                              \
-                    entry_to_evict(&first_word_paddr, l2_cache, evict, way_to_write, L2_CACHE);                                                                                               \
-                                                                                                                                                                                              \
-                    M_EXIT_IF_ERR(cache_insert(index_for_paddr(paddr, L2_CACHE), way_to_write, &new_l2_entry, l2_cache, L2_CACHE), "Error in cache insert");                                  \
-                }                                                                                                                                                                             \
-                else                                                                                                                                                                          \
-                {                                                                                                                                                                             \
-                    cache = l1_cache;                                                                                                                                                         \
-                    M_EXIT_IF_ERR(cache_insert(index_for_paddr(paddr, cache_type), way_to_write, &new_l1_entry, l1_cache, cache_type), "Error in cache insert");                              \
-                    LRU_age_increase(type, ways, way_to_write, index_for_paddr(paddr, cache_type));                                                                                           \
-                }                                                                                                                                                                             \
-            }                                                                                                                                                                                 \
-            else                                                                                                                                                                              \
-            {                                                                                                                                                                                 \
-                uint8_t evict = 1;                                                                                                                                                            \
-                uint8_t way_to_write = 0;                                                                                                                                                     \
-                entry_to_evict(paddr, l1_cache, &evict, &way_to_write, cache_type);                                                                                                           \
-                type new_l1_entry;                                                                                                                                                            \
-                cache_entry_init(mem_space, paddr, &new_l1_entry, cache_type);                                                                                                                \
-                if (evict)                                                                                                                                                                    \
-                {                                                                                                                                                                             \
-                    cache = l1_cache;                                                                                                                                                         \
-                    l2_cache_entry_t new_l2_entry = transform_l1_entry_to_l2(cache_entry(type, ways, index_for_paddr(paddr, cache_type), way_to_write), cache_type);                          \
-                    cache = l2_cache;                                                                                                                                                         \
-                                                                                                                                                                                              \
-                    M_EXIT_IF_ERR(cache_insert(index_for_paddr(paddr, cache_type), way_to_write, &new_l1_entry, l1_cache, cache_type), "error in insertion");                                 \
-                    phy_addr_t first_word_paddr = paddr_from_index_and_tag(hit_index, new_l2_entry.tag, L2_CACHE);                                                                            \
-                                                                                                                                                                                              \
-                    entry_to_evict(&first_word_paddr, l2_cache, evict, way_to_write, L2_CACHE);                                                                                               \
-                    M_EXIT_IF_ERR(cache_insert(index_for_paddr(paddr, L2_CACHE), way_to_write, &new_l2_entry, l2_cache, L2_CACHE), "error in insertion");                                     \
-                    LRU_age_update(type, ways, hit_way, index_for_paddr(paddr, cache_type));                                                                                                  \
-                }                                                                                                                                                                             \
-                else                                                                                                                                                                          \
-                {                                                                                                                                                                             \
-                    cache = l1_cache;                                                                                                                                                         \
-                    M_EXIT_IF_ERR(cache_entry_init(mem_space, paddr, &new_l1_entry, cache_type), "Err in cache entry init");                                                                  \
-                    M_EXIT_IF_ERR(cache_insert(index_for_paddr(paddr, cache_type), way_to_write, &new_l1_entry, l1_cache, cache_type), "ERRin cache insert");                                 \
-                    LRU_age_increase(type, ways, way_to_write, index_for_paddr(paddr, cache_type));                                                                                           \
-                }                                                                                                                                                                             \
-                uint16_t hit_index = HIT_INDEX_MISS;                                                                                                                                          \
-                uint8_t hit_way = HIT_WAY_MISS;                                                                                                                                               \
-                word_t p_line[words_per_line];                                                                                                                                                \
-                M_EXIT_IF_ERR(cache_hit(mem_space, l1_cache, paddr, &p_line, &hit_way, &hit_index, cache_type), "Err in cache hit");                                                          \
-                                                                                                                                                                                              \
-                *word = p_line[(paddr->page_offset >> 2) % words_per_line];                                                                                                                   \
-                return ERR_NONE;                                                                                                                                                              \
-            }                                                                                                                                                                                 \
-        }                                                                                                                                                                                     \
-    } while (0);
+int cache_read_with_stats(const void *mem_space, phy_addr_t *paddr, mem_access_t access, void *l1_cache, void *l2_cache,
+                          uint32_t *word, cache_replace_t replace, cache_stats_t *stats)
+{
+    return cache_read_sampled(mem_space, paddr, access, l1_cache, l2_cache, word, replace, NULL, stats);
+}
 
+int cache_read_sampled(const void *mem_space, phy_addr_t *paddr, mem_access_t access, void *l1_cache, void *l2_cache,
+                       uint32_t *word, cache_replace_t replace, const cache_sampling_t *sampling, cache_stats_t *stats)
+{
     M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(access);
     M_REQUIRE_NON_NULL(l1_cache);
     M_REQUIRE_NON_NULL(l2_cache);
     M_REQUIRE_NON_NULL(word);
-    M_EXIT_ERR(isWordAligned(paddr), "address is not word aligned");
-    M_REQUIRE(replace == LRU, ERR_BAD_PARAMETER, "only LRU replacement policy implemented");
-
-    int hit_way = HIT_WAY_MISS;
-    int hit_index = HIT_INDEX_MISS;
-    switch (access)
-    {
-    case INSTRUCTION:
-    {
-        cache_read_modular(l1_icache_entry_t, L1_ICACHE_WORDS_PER_LINE, L1_ICACHE_WAYS, L1_ICACHE);
-        break;
-    }
-    case DATA:
-    {
-        cache_read_modular(l1_dcache_entry_t, L1_DCACHE_WORDS_PER_LINE, L1_DCACHE_WAYS, L1_DCACHE);
-        break;
-    }
-    default:
-        break;
-    }
+    M_REQUIRE(paddr->page_offset % sizeof(word_t) == 0, ERR_BAD_PARAMETER, "address is not word aligned", NULL);
+    M_REQUIRE(replace == LRU, ERR_POLICY, "only LRU replacement policy implemented", NULL);
+
+    word_t *line = NULL;
+    int served_by = NB_CACHE_TYPES;
+    M_EXIT_IF_ERR(line_fetch(mem_space, paddr, access == INSTRUCTION ? L1_ICACHE : L1_DCACHE,
+                             l1_cache, l2_cache, sampling, &line, &served_by), "fetching a cache line");
+    *word = line[(paddr->page_offset >> 2) % L1_ICACHE_WORDS_PER_LINE];
+    count(stats, served_by);
+    return ERR_NONE;
 }
 
 //=========================================================================
@@ -419,11 +467,29 @@ int cache_read_byte(const void *mem_space,
                     uint8_t *p_byte,
                     cache_replace_t replace)
 {
+    return cache_read_byte_with_stats(mem_space, p_paddr, access, l1_cache, l2_cache, p_byte, replace, NULL);
+}
+
+int cache_read_byte_with_stats(const void *mem_space, phy_addr_t *p_paddr, mem_access_t access, void *l1_cache,
+                               void *l2_cache, uint8_t *p_byte, cache_replace_t replace, cache_stats_t *stats)
+{
+    return cache_read_byte_sampled(mem_space, p_paddr, access, l1_cache, l2_cache, p_byte, replace, NULL, stats);
+}
+
+int cache_read_byte_sampled(const void *mem_space, phy_addr_t *p_paddr, mem_access_t access, void *l1_cache,
+                            void *l2_cache, uint8_t *p_byte, cache_replace_t replace,
+                            const cache_sampling_t *sampling, cache_stats_t *stats)
+{
+    M_REQUIRE_NON_NULL(p_paddr);
+    M_REQUIRE_NON_NULL(p_byte);
+    phy_addr_t word_addr = *p_paddr;
+    word_addr.page_offset &= (uint16_t)~(sizeof(word_t) - 1);
     word_t word = 0;
-    M_EXIT_IF_ERR(cache_read(mem_space, p_paddr, access, l1_cache, l2_cache, &word, replace), "Error when reading");
-    *p_byte = word & 0x0000000F;
+    M_EXIT_IF_ERR(cache_read_sampled(mem_space, &word_addr, access, l1_cache, l2_cache, &word, replace, sampling, stats), "Error when reading");
+    *p_byte = (uint8_t)(word >> (8 * (p_paddr->page_offset % sizeof(word_t))));
     return ERR_NONE;
 }
+
 //=========================================================================
 int cache_write(void *mem_space,
                 phy_addr_t *paddr,
@@ -432,58 +498,34 @@ int cache_write(void *mem_space,
                 const uint32_t *word,
                 cache_replace_t replace)
 {
-#define hit_in_cache(cache_type, lines)                                                                   \
-    do                                                                                                    \
-    {                                                                                                     \
-        size_t lineIndex = (paddr->phy_page_num >> 4) % lines;                                            \
-        p_line[hit_way] = *word;                                                                          \
-        M_EXIT_IF_ERR(cache_insert(lineIndex, hit_way, p_line, cache, cache_type), "Error in insertion"); \
-        ((word_t *)mem_space)[compose_phys_addr(paddr) >> 2] = *word;                                     \
-    } while (0)
+    return cache_write_with_stats(mem_space, paddr, l1_cache, l2_cache, word, replace, NULL);
+}
+
+int cache_write_with_stats(void *mem_space, phy_addr_t *paddr, void *l1_cache, void *l2_cache,
+                           const uint32_t *word, cache_replace_t replace, cache_stats_t *stats)
+{
+    return cache_write_sampled(mem_space, paddr, l1_cache, l2_cache, word, replace, NULL, stats);
+}
 
+int cache_write_sampled(void *mem_space, phy_addr_t *paddr, void *l1_cache, void *l2_cache,
+                        const uint32_t *word, cache_replace_t replace, const cache_sampling_t *sampling, cache_stats_t *stats)
+{
     M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(paddr);
     M_REQUIRE_NON_NULL(l1_cache);
     M_REQUIRE_NON_NULL(l2_cache);
     M_REQUIRE_NON_NULL(word);
-    M_REQUIRE(paddr->page_offset % 4, ERR_BAD_PARAMETER, "Physical address not aligned", NULL);
-
-    word_t p_line[L1_DCACHE_WORDS_PER_LINE];
-    uint8_t hit_way = 0;
-    uint16_t hit_index = 0;
-    void *cache = l1_cache; //For functionning macros
-
-    //L1 lookup
-    M_EXIT_IF_ERR(cache_hit(mem_space, cache, paddr, &p_line, &hit_way, &hit_index, L1_DCACHE), "Error in hit");
-    if (hit_way != HIT_WAY_MISS)
-    {
-        p_line[hit_way] = *word;
-        cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way)[(compose_phys_addr(paddr) >> 2) % L1_DCACHE_WORDS_PER_LINE] = *word;
-        LRU_age_update(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_way, hit_index);
-        return ERR_NONE;
-    }
-
-    //L2 lookup
-    cache = l2_cache;
-    M_EXIT_IF_ERR(cache_hit(mem_space, cache, paddr, &p_line, &hit_way, hit_index, L2_CACHE), "Error in hit");
-    if (hit_way != HIT_WAY_MISS)
-    {
-        hit_in_cache(L2_CACHE, L2_CACHE_LINES);
-    }
+    M_REQUIRE(paddr->page_offset % sizeof(word_t) == 0, ERR_BAD_PARAMETER, "address is not word aligned", NULL);
+    M_REQUIRE(replace == LRU, ERR_POLICY, "only LRU replacement policy implemented", NULL);
+
+    // write-allocate: the line is brought into L1D, then written through
+    word_t *line = NULL;
+    int served_by = NB_CACHE_TYPES;
+    M_EXIT_IF_ERR(line_fetch(mem_space, paddr, L1_DCACHE, l1_cache, l2_cache, sampling, &line, &served_by), "fetching a cache line");
+    line[(paddr->page_offset >> 2) % L1_DCACHE_WORDS_PER_LINE] = *word;
     ((word_t *)mem_space)[compose_phys_addr(paddr) >> 2] = *word;
-
-    uint32_t tag = paddr->phy_page_num >> L1_DCACHE_TAG_REMANING;
-    size_t lineIndex = (paddr->phy_page_num >> 4) % L1_DCACHE_LINES;
-    uint8_t oldest = 0;
-    uint8_t overwrite = 0;
-    ;
-    //Put evicted in victim cache
-    if (overwrite)
-    {
-    }
-
-    //TODO: Put in the new word, evict the old and eventually put in 2 if it should be done
-    //Also do the copyback from L2 to L1.
+    count(stats, served_by);
+    return ERR_NONE;
 }
 
 //=========================================================================
@@ -494,13 +536,106 @@ int cache_write_byte(void *mem_space,
                      uint8_t p_byte,
                      cache_replace_t replace)
 {
+    return cache_write_byte_with_stats(mem_space, paddr, l1_cache, l2_cache, p_byte, replace, NULL);
+}
+
+int cache_write_byte_with_stats(void *mem_space, phy_addr_t *paddr, void *l1_cache, void *l2_cache,
+                                uint8_t p_byte, cache_replace_t replace, cache_stats_t *stats)
+{
+    return cache_write_byte_sampled(mem_space, paddr, l1_cache, l2_cache, p_byte, replace, NULL, stats);
+}
+
+int cache_write_byte_sampled(void *mem_space, phy_addr_t *paddr, void *l1_cache, void *l2_cache,
+                             uint8_t p_byte, cache_replace_t replace, const cache_sampling_t *sampling, cache_stats_t *stats)
+{
+    M_REQUIRE_NON_NULL(paddr);
+    phy_addr_t word_addr = *paddr;
+    word_addr.page_offset &= (uint16_t)~(sizeof(word_t) - 1);
+    const unsigned shift = 8 * (paddr->page_offset % sizeof(word_t));
     word_t word = 0;
-    M_EXIT_IF_ERR(cache_read(mem_space, paddr, DATA, l1_cache, l2_cache, word, replace), "cache read error");
-    word = (word & 0xFFFFFFF0) | (p_byte & ~(0xFFFFFFF0));
-    M_EXIT_IF_ERR(cache_write(mem_space, paddr, l1_cache, l2_cache, word, replace), "cache write error");
+    // the read brings the line into L1D: only that access is counted
+    M_EXIT_IF_ERR(cache_read_sampled(mem_space, &word_addr, DATA, l1_cache, l2_cache, &word, replace, sampling, stats), "cache read error");
+    word = (word & ~((word_t)0xFF << shift)) | ((word_t)p_byte << shift);
+    M_EXIT_IF_ERR(cache_write_sampled(mem_space, &word_addr, l1_cache, l2_cache, &word, replace, sampling, NULL), "cache write error");
     return ERR_NONE;
 }
 
+//=========================================================================
+int cache_set_index(const phy_addr_t *paddr, cache_t cache_type, uint16_t *index)
+{
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(index);
+    M_REQUIRE(cache_type < NB_CACHE_TYPES, ERR_BAD_PARAMETER, "unknown cache type %d", cache_type);
+    *index = (uint16_t)index_for_paddr(paddr, cache_type);
+    return ERR_NONE;
+}
+
+//=========================================================================
+// virtually-indexed, physically-tagged L1 caches
+
+// number of bits (line offset + set index) of an address selecting a set of the cache
+static uint8_t set_selection_bits(cache_t cache_type)
+{
+    switch (cache_type)
+    {
+    case L1_ICACHE:
+        return LINE_OFFSET_BITS + L1_ICACHE_INDEX_BITS;
+    case L1_DCACHE:
+        return LINE_OFFSET_BITS + L1_DCACHE_INDEX_BITS;
+    case L2_CACHE:
+        return LINE_OFFSET_BITS + L2_CACHE_INDEX_BITS;
+    default:
+        return UINT8_MAX;
+    }
+}
+
+int cache_vipt_check(cache_t cache_type)
+{
+    M_REQUIRE(cache_type < NB_CACHE_TYPES, ERR_BAD_PARAMETER, "unknown cache type %d", cache_type);
+    M_REQUIRE(set_selection_bits(cache_type) <= PAGE_OFFSET, ERR_SIZE,
+              "%u set selection bits exceed the %d page offset bits: virtual aliases would map to different sets",
+              set_selection_bits(cache_type), PAGE_OFFSET);
+    return ERR_NONE;
+}
+
+int cache_vipt_index(const virt_addr_t *vaddr, cache_t cache_type, uint16_t *index)
+{
+    M_REQUIRE_NON_NULL(vaddr);
+    M_REQUIRE_NON_NULL(index);
+    M_EXIT_IF_ERR(cache_vipt_check(cache_type), "checking VIPT geometry");
+    const uint16_t lines = cache_type == L1_ICACHE ? L1_ICACHE_LINES : cache_type == L1_DCACHE ? L1_DCACHE_LINES : L2_CACHE_LINES;
+    *index = (uint16_t)((vaddr->page_offset >> LINE_OFFSET_BITS) % lines);
+    return ERR_NONE;
+}
+
+uint32_t cache_access_latency(const cache_latency_t *latency, cache_indexing_t indexing, int served_by)
+{
+    if (latency == NULL)
+        return 0;
+    uint32_t cycles = indexing == CACHE_VIPT
+                          ? (latency->translation > latency->l1 ? latency->translation : latency->l1)
+                          : latency->translation + latency->l1;
+    if (served_by == L2_CACHE || served_by == NB_CACHE_TYPES || served_by == CACHE_UNSAMPLED)
+        cycles += latency->l2;
+    if (served_by == NB_CACHE_TYPES)
+        cycles += latency->memory;
+    return cycles;
+}
+
+int cache_served_by(const cache_stats_t *before, const cache_stats_t *after)
+{
+    if (before == NULL || after == NULL)
+        return NB_CACHE_TYPES;
+    if (after->unsampled != before->unsampled)
+        return CACHE_UNSAMPLED;
+    for (int c = L1_ICACHE; c < NB_CACHE_TYPES; ++c)
+    {
+        if (after->hits[c] != before->hits[c])
+            return c;
+    }
+    return NB_CACHE_TYPES;
+}
+
 //=========================================================================
 int cache_dump(FILE *output, const void *cache, cache_t cache_type);
 
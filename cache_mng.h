@@ -22,6 +22,63 @@ typedef enum cache_replacement_policy cache_replace_t;
 #define HIT_WAY_MISS ((uint8_t)-1)
 #define HIT_INDEX_MISS ((uint16_t)-1)
 
+/**
+ * @brief cache hierarchy statistics: accesses served by each cache, or by memory
+ */
+typedef struct
+{
+    uint64_t hits[NB_CACHE_TYPES];
+    uint64_t misses; // lines brought from memory
+    uint64_t unsampled; // L1 misses to an L2 set not simulated (see cache_sampling_t)
+} cache_stats_t;
+
+/**
+ * @brief L2 set sampling: only one L2 set out of one_in (a power of 2, 1 for
+ * all of them), chosen by hashing the set index, is simulated. An L1 miss
+ * to another set does no L2 work at all: its line comes from memory (as up
+ * to date as L2, the caches writing through), and is served by
+ * CACHE_UNSAMPLED. The L1 victims of such sets are dropped, so that the
+ * sets simulated go through exactly what they would in a full simulation.
+ */
+typedef struct
+{
+    uint16_t one_in;
+} cache_sampling_t;
+
+#define CACHE_SAMPLING_NONE { 1 }
+#define CACHE_UNSAMPLED (NB_CACHE_TYPES + 1) // "served_by" of an L1 miss to an L2 set not simulated
+
+/**
+ * @brief how an L1 cache is indexed:
+ *  - PIPT: the set index is taken from the physical address, so the cache is
+ *    only looked up once the address is translated;
+ *  - VIPT: the set index is taken from the page offset of the virtual address
+ *    (see cache_vipt_index()), so the set is read while the TLB translates;
+ *    tags still come from the physical address.
+ */
+typedef enum
+{
+    CACHE_PIPT,
+    CACHE_VIPT,
+    NB_CACHE_INDEXINGS
+} cache_indexing_t;
+
+/**
+ * @brief latencies (in cycles) of a translation (TLB hit), of an access to
+ * each level of the hierarchy, and of a coherence transaction between L1
+ * caches (multi-core mode: cache-to-cache transfer or invalidations)
+ */
+typedef struct
+{
+    uint32_t translation;
+    uint32_t l1;
+    uint32_t l2;
+    uint32_t memory;
+    uint32_t coherence;
+} cache_latency_t;
+
+#define CACHE_LATENCY_DEFAULT { 1, 2, 10, 100, 20 }
+
 //=========================================================================
 /**
  * @brief Useful macro to loop over ways
@@ -200,3 +257,229 @@ int cache_write_byte(void *mem_space,
  * @return error code
  */
 int cache_dump(FILE *output, const void *cache, cache_t cache_type);
+
+//=========================================================================
+/**
+ * @brief Find the entry of a cache holding a physical address, without
+ * updating the ages of its set (e.g. to snoop the cache of another core).
+ * @param cache the cache to look up
+ * @param paddr the physical address
+ * @param cache_type the type of the cache
+ * @param entry (modified) the entry holding the line, NULL if none
+ * @return error code
+ */
+int cache_lookup(void *cache, const phy_addr_t *paddr, cache_t cache_type, void **entry);
+
+//=========================================================================
+/**
+ * @brief Bring into an L1 cache the line of a physical address, supplied by
+ * another cache (cache-to-cache transfer) rather than by L2 or memory. Any L2
+ * copy of the line is dropped, the L1 victim (if any) moves to L2.
+ * Nothing is done if the L1 cache already holds the line.
+ * @param paddr the physical address
+ * @param l1_type the L1 cache to fill
+ * @param l1_cache pointer to that L1 cache
+ * @param l2_cache pointer to the L2 cache
+ * @param words the content of the line
+ * @return error code
+ */
+int cache_fill(phy_addr_t *paddr, cache_t l1_type, void *l1_cache, void *l2_cache, const word_t *words);
+
+//=========================================================================
+/**
+ * @brief Same as cache_read(), also accounting the access in stats.
+ * @param stats (modified) statistics to update, may be NULL
+ * (other parameters: see cache_read())
+ * @return error code
+ */
+int cache_read_with_stats(const void *mem_space,
+                          phy_addr_t *paddr,
+                          mem_access_t access,
+                          void *l1_cache,
+                          void *l2_cache,
+                          uint32_t *word,
+                          cache_replace_t replace,
+                          cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as cache_read_with_stats(), the L2 cache only simulating the
+ * sets selected by sampling.
+ * @param sampling the L2 sets simulated, NULL for all of them
+ * (other parameters: see cache_read_with_stats())
+ * @return error code
+ */
+int cache_read_sampled(const void *mem_space,
+                       phy_addr_t *paddr,
+                       mem_access_t access,
+                       void *l1_cache,
+                       void *l2_cache,
+                       uint32_t *word,
+                       cache_replace_t replace,
+                       const cache_sampling_t *sampling,
+                       cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as cache_read_byte(), also accounting the access in stats.
+ * @param stats (modified) statistics to update, may be NULL
+ * (other parameters: see cache_read_byte())
+ * @return error code
+ */
+int cache_read_byte_with_stats(const void *mem_space,
+                               phy_addr_t *p_paddr,
+                               mem_access_t access,
+                               void *l1_cache,
+                               void *l2_cache,
+                               uint8_t *p_byte,
+                               cache_replace_t replace,
+                               cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as cache_read_byte_with_stats(), the L2 cache only simulating
+ * the sets selected by sampling.
+ * @param sampling the L2 sets simulated, NULL for all of them
+ * (other parameters: see cache_read_byte_with_stats())
+ * @return error code
+ */
+int cache_read_byte_sampled(const void *mem_space,
+                            phy_addr_t *p_paddr,
+                            mem_access_t access,
+                            void *l1_cache,
+                            void *l2_cache,
+                            uint8_t *p_byte,
+                            cache_replace_t replace,
+                            const cache_sampling_t *sampling,
+                            cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as cache_write(), also accounting the access in stats.
+ * @param stats (modified) statistics to update, may be NULL
+ * (other parameters: see cache_write())
+ * @return error code
+ */
+int cache_write_with_stats(void *mem_space,
+                           phy_addr_t *paddr,
+                           void *l1_cache,
+                           void *l2_cache,
+                           const uint32_t *word,
+                           cache_replace_t replace,
+                           cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as cache_write_with_stats(), the L2 cache only simulating the
+ * sets selected by sampling.
+ * @param sampling the L2 sets simulated, NULL for all of them
+ * (other parameters: see cache_write_with_stats())
+ * @return error code
+ */
+int cache_write_sampled(void *mem_space,
+                        phy_addr_t *paddr,
+                        void *l1_cache,
+                        void *l2_cache,
+                        const uint32_t *word,
+                        cache_replace_t replace,
+                        const cache_sampling_t *sampling,
+                        cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as cache_write_byte(), also accounting the access in stats
+ * (a byte write counts as one access).
+ * @param stats (modified) statistics to update, may be NULL
+ * (other parameters: see cache_write_byte())
+ * @return error code
+ */
+int cache_write_byte_with_stats(void *mem_space,
+                                phy_addr_t *paddr,
+                                void *l1_cache,
+                                void *l2_cache,
+                                uint8_t p_byte,
+                                cache_replace_t replace,
+                                cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as cache_write_byte_with_stats(), the L2 cache only
+ * simulating the sets selected by sampling.
+ * @param sampling the L2 sets simulated, NULL for all of them
+ * (other parameters: see cache_write_byte_with_stats())
+ * @return error code
+ */
+int cache_write_byte_sampled(void *mem_space,
+                             phy_addr_t *paddr,
+                             void *l1_cache,
+                             void *l2_cache,
+                             uint8_t p_byte,
+                             cache_replace_t replace,
+                             const cache_sampling_t *sampling,
+                             cache_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Tell whether an L2 set is simulated: the sets are shuffled by a
+ * fixed permutation of their indexes, the first L2_CACHE_LINES / one_in of
+ * them being sampled.
+ * @param sampling the L2 sets simulated, NULL for all of them
+ * @param index the set index
+ * @return 1 if the set is simulated, 0 otherwise
+ */
+int cache_l2_set_sampled(const cache_sampling_t *sampling, uint16_t index);
+
+//=========================================================================
+/**
+ * @brief Compute the set of a cache holding (or to hold) a physical address.
+ * @param paddr the physical address
+ * @param cache_type the cache
+ * @param index (modified) the set index
+ * @return error code
+ */
+int cache_set_index(const phy_addr_t *paddr, cache_t cache_type, uint16_t *index);
+
+//=========================================================================
+/**
+ * @brief Check that a cache can be virtually indexed without aliasing: its
+ * set index and line offset bits must all lie within the page offset, so that
+ * every virtual alias of a physical line selects the same set.
+ * @param cache_type the cache to check
+ * @return ERR_NONE if it can, ERR_SIZE otherwise
+ */
+int cache_vipt_check(cache_t cache_type);
+
+//=========================================================================
+/**
+ * @brief Compute the set index of an access from its virtual address only,
+ * i.e. before translation (VIPT). For caches passing cache_vipt_check(), it
+ * is the set index of the translated address.
+ * @param vaddr the virtual address
+ * @param cache_type the (L1) cache
+ * @param index (modified) the set index
+ * @return error code
+ */
+int cache_vipt_index(const virt_addr_t *vaddr, cache_t cache_type, uint16_t *index);
+
+//=========================================================================
+/**
+ * @brief Latency of an access, given the cache which served it: the L1 lookup
+ * follows the translation (PIPT) or overlaps it (VIPT); L2 and memory are
+ * only accessed after an L1 miss, once the address is translated.
+ * An access served by CACHE_UNSAMPLED costs as much as an L2 hit.
+ * @param latency the latencies of each step
+ * @param indexing how the L1 caches are indexed
+ * @param served_by the cache which hit, NB_CACHE_TYPES for memory, or CACHE_UNSAMPLED
+ * @return the latency, in cycles
+ */
+uint32_t cache_access_latency(const cache_latency_t *latency, cache_indexing_t indexing, int served_by);
+
+//=========================================================================
+/**
+ * @brief The cache which served an access, from the statistics of the
+ * hierarchy right before and right after it.
+ * @param before the statistics before the access
+ * @param after the statistics after the access
+ * @return the cache which hit, NB_CACHE_TYPES for memory, or CACHE_UNSAMPLED
+ */
+int cache_served_by(const cache_stats_t *before, const cache_stats_t *after);
@@ -0,0 +1,262 @@
+/**
+ * @file cache_parallel.c
+ * @brief set-partitioned parallel simulation of the cache hierarchy
+ *
+ * @date 2019
+ */
+
+#include "cache_parallel.h"
+#include "page_memo.h"
+#include "error.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a translated access
+typedef struct
+{
+    const command_t *command;
+    phy_addr_t paddr;
+} routed_t;
+
+// a worker: its accesses (in program order), and what they cost
+typedef struct
+{
+    void *mem_space;
+    l1_icache_entry_t *l1_icache;
+    l1_dcache_entry_t *l1_dcache;
+    l2_cache_entry_t *l2_cache;
+    const cache_latency_t *latency;
+    cache_indexing_t indexing;
+    routed_t *accesses;
+    size_t nb_accesses;
+    cache_stats_t stats;
+    uint64_t cycles;
+    int err;
+} worker_t;
+
+static int access_line(worker_t *w, routed_t *access)
+{
+    const command_t *command = access->command;
+    uint32_t word = 0;
+    uint8_t byte = 0;
+    switch (command->order)
+    {
+    case READ:
+    {
+        void *l1_cache = command->type == INSTRUCTION ? (void *)w->l1_icache : (void *)w->l1_dcache;
+        if (command->data_size == sizeof(word_t))
+            return cache_read_with_stats(w->mem_space, &access->paddr, command->type, l1_cache, w->l2_cache,
+                                         &word, LRU, &w->stats);
+        return cache_read_byte_with_stats(w->mem_space, &access->paddr, command->type, l1_cache, w->l2_cache,
+                                          &byte, LRU, &w->stats);
+    }
+    case WRITE:
+        if (command->data_size == sizeof(word_t))
+            return cache_write_with_stats(w->mem_space, &access->paddr, w->l1_dcache, w->l2_cache,
+                                          &command->write_data, LRU, &w->stats);
+        return cache_write_byte_with_stats(w->mem_space, &access->paddr, w->l1_dcache, w->l2_cache,
+                                           (uint8_t)command->write_data, LRU, &w->stats);
+    default:
+        M_EXIT_ERR(ERR_BAD_PARAMETER, "unknown order %d", command->order);
+    }
+}
+
+// simulates one access, adding its latency to the cycles of the worker
+static int worker_access(worker_t *w, routed_t *access)
+{
+    const cache_stats_t before = w->stats;
+    M_EXIT_IF_ERR(access_line(w, access), "simulating an access");
+    w->cycles += cache_access_latency(w->latency, w->indexing, cache_served_by(&before, &w->stats));
+    return ERR_NONE;
+}
+
+static void *worker_run(void *arg)
+{
+    worker_t *w = arg;
+    for (size_t i = 0; i < w->nb_accesses && w->err == ERR_NONE; ++i)
+        w->err = worker_access(w, &w->accesses[i]);
+    return NULL;
+}
+
+// whether a page table read by the walks memoized in memo is one of the written pages
+static int tables_written(const page_memo_t *memo, const uint8_t *written)
+{
+    for (size_t i = 0; i < memo->tables_capacity; ++i)
+    {
+        const uint64_t key = memo->tables[i].key;
+        if (key != 0 && (written[(key - 1) / 8] >> ((key - 1) % 8)) & 1)
+            return 1;
+    }
+    return 0;
+}
+
+// translates the accesses of program (in order) into accesses, noting the worker of each in owner;
+// sets *stale when the program writes into a page table it walks: as the writes are only done
+// afterwards by the workers, some of these translations may then differ from the serial ones
+static int translate_all(const void *mem_space, const program_t *program, size_t nb_workers,
+                         routed_t *accesses, size_t *owner, size_t *nb_accesses, int *stale)
+{
+    uint8_t *written = calloc(((size_t)1 << PHY_PAGE_NUM) / 8, sizeof(uint8_t));
+    M_EXIT_IF_NULL(written, ((size_t)1 << PHY_PAGE_NUM) / 8);
+    page_memo_t memo;
+    int err = page_memo_init(&memo, PAGE_MEMO_MIN_CAPACITY);
+    if (err != ERR_NONE)
+    {
+        free(written);
+        return err;
+    }
+    *nb_accesses = 0;
+    *stale = 0;
+    for_all_lines(line, program)
+    {
+        if (line->order == SWITCH || line->order == INVALIDATE)
+        {
+            *stale = *stale || tables_written(&memo, written);
+            err = line->order == SWITCH ? page_memo_set_root(&memo, line->pgd) : page_memo_invalidate(&memo);
+        }
+        else
+        {
+            routed_t *access = &accesses[*nb_accesses];
+            access->command = line;
+            if (line->translated)
+                access->paddr = line->paddr;
+            else
+                err = page_memo_translate(&memo, mem_space, &line->vaddr, &access->paddr);
+            if (line->order == WRITE)
+                written[access->paddr.phy_page_num / 8] |= (uint8_t)(1 << (access->paddr.phy_page_num % 8));
+            uint16_t set = 0;
+            if (err == ERR_NONE)
+                err = cache_set_index(&access->paddr, L1_ICACHE, &set);
+            owner[(*nb_accesses)++] = set % nb_workers;
+        }
+        if (err != ERR_NONE)
+            break;
+    }
+    *stale = *stale || tables_written(&memo, written);
+    (void)page_memo_free(&memo);
+    free(written);
+    return err;
+}
+
+// simulates program in the calling thread, translating each access just before it (as the serial
+// simulation does), so that writes into the page tables are seen by the next translations
+static int serial_run(worker_t *w, const program_t *program)
+{
+    page_memo_t memo;
+    M_EXIT_IF_ERR(page_memo_init(&memo, PAGE_MEMO_MIN_CAPACITY), "initializing translations");
+    int err = ERR_NONE;
+    for_all_lines(line, program)
+    {
+        if (line->order == SWITCH)
+            err = page_memo_set_root(&memo, line->pgd);
+        else if (line->order == INVALIDATE)
+            err = page_memo_invalidate(&memo);
+        else
+        {
+            routed_t access = { line, line->paddr };
+            if (!line->translated)
+                err = page_memo_translate(&memo, w->mem_space, &line->vaddr, &access.paddr);
+            if (err == ERR_NONE)
+                err = worker_access(w, &access);
+            if (err == ERR_NONE && line->order == WRITE)
+                err = page_memo_write(&memo, &access.paddr);
+        }
+        if (err != ERR_NONE)
+            break;
+    }
+    (void)page_memo_free(&memo);
+    return err;
+}
+
+int cache_parallel_run(void *mem_space, const program_t *program,
+                       l1_icache_entry_t *l1_icache, l1_dcache_entry_t *l1_dcache, l2_cache_entry_t *l2_cache,
+                       const cache_latency_t *latency, cache_indexing_t indexing, size_t nb_workers,
+                       cache_stats_t *stats, uint64_t *cycles)
+{
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE_NON_NULL(l1_icache);
+    M_REQUIRE_NON_NULL(l1_dcache);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(stats);
+    M_REQUIRE_NON_NULL(cycles);
+    M_REQUIRE(indexing < NB_CACHE_INDEXINGS, ERR_BAD_PARAMETER, "unknown indexing %d", indexing);
+    M_REQUIRE(nb_workers >= 1 && nb_workers <= CACHE_PARALLEL_MAX_WORKERS, ERR_BAD_PARAMETER,
+              "%zu workers (1 to %d)", nb_workers, CACHE_PARALLEL_MAX_WORKERS);
+    if (program->nb_lines == 0)
+        return ERR_NONE;
+
+    routed_t *translated = calloc(program->nb_lines, sizeof(routed_t));
+    routed_t *sorted = calloc(program->nb_lines, sizeof(routed_t));
+    size_t *owner = calloc(program->nb_lines, sizeof(size_t));
+    worker_t *workers = calloc(nb_workers, sizeof(worker_t));
+    pthread_t *threads = calloc(nb_workers, sizeof(pthread_t));
+    int err = ERR_MEM;
+    size_t nb_accesses = 0;
+    int stale = 0;
+    if (translated != NULL && sorted != NULL && owner != NULL && workers != NULL && threads != NULL)
+        err = translate_all(mem_space, program, nb_workers, translated, owner, &nb_accesses, &stale);
+
+    if (err == ERR_NONE)
+    {
+        // groups the accesses of each worker, keeping their order
+        for (size_t i = 0; i < nb_accesses; ++i)
+            workers[owner[i]].nb_accesses++;
+        size_t start = 0;
+        for (size_t k = 0; k < nb_workers; ++k)
+        {
+            worker_t *w = &workers[k];
+            w->mem_space = mem_space;
+            w->l1_icache = l1_icache;
+            w->l1_dcache = l1_dcache;
+            w->l2_cache = l2_cache;
+            w->latency = latency;
+            w->indexing = indexing;
+            w->accesses = sorted + start;
+            start += w->nb_accesses;
+            w->nb_accesses = 0;
+        }
+        for (size_t i = 0; i < nb_accesses; ++i)
+        {
+            worker_t *w = &workers[owner[i]];
+            w->accesses[w->nb_accesses++] = translated[i];
+        }
+
+        if (stale) // the program edits its page tables: the calling thread simulates it alone
+            workers[0].err = serial_run(&workers[0], program);
+        else
+        {
+            // the calling thread is worker 0, and runs the workers whose thread could not be created
+            size_t started = 1;
+            for (; started < nb_workers; ++started)
+            {
+                if (pthread_create(&threads[started], NULL, worker_run, &workers[started]) != 0)
+                    break;
+            }
+            worker_run(&workers[0]);
+            for (size_t k = started; k < nb_workers; ++k)
+                worker_run(&workers[k]);
+            for (size_t k = 1; k < started; ++k)
+                pthread_join(threads[k], NULL);
+        }
+
+        for (size_t k = 0; k < nb_workers && err == ERR_NONE; ++k)
+            err = workers[k].err;
+        for (size_t k = 0; k < nb_workers && err == ERR_NONE; ++k)
+        {
+            for (int c = L1_ICACHE; c < NB_CACHE_TYPES; ++c)
+                stats->hits[c] += workers[k].stats.hits[c];
+            stats->misses += workers[k].stats.misses;
+            *cycles += workers[k].cycles;
+        }
+    }
+
+    free(threads);
+    free(workers);
+    free(owner);
+    free(sorted);
+    free(translated);
+    return err;
+}
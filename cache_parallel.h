@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * @file cache_parallel.h
+ * @brief set-partitioned parallel simulation of the cache hierarchy
+ *
+ * Without prefetching nor coherence, an access only touches one set of each
+ * cache: set s of L1 (instruction or data), and one of the sets of L2 whose
+ * index is s modulo L1_ICACHE_LINES (L1 victims go to the L2 set of their own
+ * address). Accesses to different L1 sets are hence independent: each worker
+ * owns the L1 sets s with s % nb_workers equal to its number, together with
+ * the matching L2 sets, and replays the accesses to them in program order.
+ * The final caches and statistics are those of the serial simulation.
+ *
+ * As the addresses are all translated before any access is simulated, a
+ * program writing into the page tables it walks cannot be split this way:
+ * it is then simulated serially, by the calling thread alone.
+ *
+ * @date 2019
+ */
+
+#include "cache.h"
+#include "cache_mng.h"
+#include "commands.h"
+
+#include <stddef.h> // for size_t
+
+#if L1_DCACHE_LINES != L1_ICACHE_LINES || L2_CACHE_LINES % L1_ICACHE_LINES != 0
+#error "set partitioning requires L1 caches of the same number of sets, dividing that of L2"
+#endif
+
+#define CACHE_PARALLEL_MAX_WORKERS L1_ICACHE_LINES // one L1 set each
+
+//=========================================================================
+/**
+ * @brief Run a program on a cache hierarchy with several threads. Addresses
+ * are first translated in program order (walking the page tables of the
+ * current address space, or taken from a pre-translated trace), then each
+ * access is handed to the worker owning its sets. Falls back to the serial
+ * simulation if the program writes into a page table read by the walks.
+ *
+ * @param mem_space the memory (written through by the workers)
+ * @param program the program (SWITCH and INVALIDATE only affect translation)
+ * @param l1_icache the L1 instruction cache
+ * @param l1_dcache the L1 data cache
+ * @param l2_cache the L2 cache
+ * @param latency the latencies of each step (may be NULL: no cycles counted)
+ * @param indexing how the L1 caches are indexed
+ * @param nb_workers the number of threads (1 to CACHE_PARALLEL_MAX_WORKERS)
+ * @param stats (modified) statistics of the accesses, added to
+ * @param cycles (modified) their latency, added to
+ * @return error code
+ */
+int cache_parallel_run(void *mem_space, const program_t *program,
+                       l1_icache_entry_t *l1_icache, l1_dcache_entry_t *l1_dcache, l2_cache_entry_t *l2_cache,
+                       const cache_latency_t *latency, cache_indexing_t indexing, size_t nb_workers,
+                       cache_stats_t *stats, uint64_t *cycles);
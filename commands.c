@@ -2,17 +2,47 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
 #include "commands.h"
 #include "addr_mng.h"
 #include "error.h"
+#include "util.h"
 
 static const size_t MAX_CHAR_NUMBER = 2;
-static size_t handle_line_calls = 0;
 static const size_t WORD_SIZE = 4;
 static const size_t BYTE_SIZE = 1;
 
 static int printline(const command_t *command, FILE *stream)
 {
+	if (command->timestamp != 0)
+		fprintf(stream, "T%" PRIu64 " ", command->timestamp);
+	if (command->core != 0)
+		fprintf(stream, "%" PRIu16 ": ", command->core);
+	if (command->order == SWITCH)
+	{
+		fprintf(stream, "C 0x%04" PRIX16 " @0x%08" PRIX32 "\n", command->asid, command->pgd);
+		return ferror(stream) == 1 ? ERR_IO : ERR_NONE;
+	}
+	if (command->order == INVALIDATE)
+	{
+		switch (command->scope)
+		{
+		case INVAL_PAGE:
+			fprintf(stream, "F @0x%016" PRIX64 "\n", virt_addr_t_to_uint64_t(&(command->vaddr)));
+			break;
+		case INVAL_RANGE:
+			fprintf(stream, "F @0x%016" PRIX64 " @0x%016" PRIX64 "\n", virt_addr_t_to_uint64_t(&(command->vaddr)), command->vaddr_end);
+			break;
+		case INVAL_ASID:
+			fprintf(stream, "F ASID\n");
+			break;
+		default:
+			fprintf(stream, "F ALL\n");
+			break;
+		}
+		return ferror(stream) == 1 ? ERR_IO : ERR_NONE;
+	}
 	if (command->order == READ)
 		fprintf(stream, "R ");
 	else
@@ -28,7 +58,10 @@ static int printline(const command_t *command, FILE *stream)
 		fprintf(stream, "0x%02" PRIX32 " ", command->write_data);
 	else if (command->order == WRITE)
 		fprintf(stream, "0x%08" PRIX32 " ", command->write_data);
-	fprintf(stream, "@0x%016" PRIX64 "\n", virt_addr_t_to_uint64_t(&(command->vaddr)));
+	fprintf(stream, "@0x%016" PRIX64, virt_addr_t_to_uint64_t(&(command->vaddr)));
+	if (command->translated)
+		fprintf(stream, " P@0x%08" PRIX32, ((uint32_t)command->paddr.phy_page_num << PAGE_OFFSET) | command->paddr.page_offset);
+	fputc('\n', stream);
 	return ferror(stream) == 1 ? ERR_IO : ERR_NONE;
 }
 
@@ -57,14 +90,60 @@ static void handle_line_data_write(FILE *input, command_t *line, char size)
 	line->type = DATA;
 }
 
-static command_t handle_line(FILE *input)
+static int handle_line(FILE *input, command_t *command)
 {
 	command_t line;
+	zero_init_var(line);
 	char accessType;
-	char word_byte[MAX_CHAR_NUMBER];
-	fscanf(input, " %c %2s", &accessType, word_byte);
+	char word_byte[MAX_CHAR_NUMBER + 1];
+	if (fscanf(input, " %c", &accessType) != 1)
+		return ERR_EOF;
+	if (accessType == 'T')
+	{
+		if (fscanf(input, "%" SCNu64 " %c", &line.timestamp, &accessType) != 2)
+			return ERR_EOF;
+	}
+	if (isdigit((unsigned char)accessType))
+	{
+		char colon = 0;
+		ungetc(accessType, input);
+		if (fscanf(input, "%" SCNu16 "%c %c", &line.core, &colon, &accessType) != 3 || colon != ':')
+			return ERR_EOF;
+	}
+	if (accessType == 'C')
+	{
+		if (fscanf(input, " %" SCNx16 " @%" SCNx32, &line.asid, &line.pgd) != 2)
+			return ERR_EOF;
+		line.order = SWITCH;
+		line.type = DATA;
+		line.data_size = WORD_SIZE;
+		*command = line;
+		return ERR_NONE;
+	}
+	if (accessType == 'F')
+	{
+		char scope[5];
+		uint64_t vaddr = 0;
+		if (fscanf(input, " @%" SCNx64, &vaddr) == 1)
+		{
+			init_virt_addr64(&line.vaddr, vaddr);
+			line.scope = fscanf(input, " @%" SCNx64, &line.vaddr_end) == 1 ? INVAL_RANGE : INVAL_PAGE;
+		}
+		else if (fscanf(input, " %4s", scope) == 1 && (!strcmp(scope, "ASID") || !strcmp(scope, "ALL")))
+			line.scope = !strcmp(scope, "ASID") ? INVAL_ASID : INVAL_ALL;
+		else
+			return ERR_EOF;
+		line.order = INVALIDATE;
+		line.type = DATA;
+		line.data_size = WORD_SIZE;
+		*command = line;
+		return ERR_NONE;
+	}
+	if (fscanf(input, " %2s", word_byte) != 1)
+		return ERR_EOF;
 	line.order = accessType == 'R' ? READ : WRITE;
 	uint64_t vaddr = 0;
+	uint32_t paddr = 0;
 
 	if (line.order == READ)
 	{
@@ -76,7 +155,57 @@ static command_t handle_line(FILE *input)
 	}
 	fscanf(input, " %*c%" SCNx64, &vaddr);
 	init_virt_addr64(&line.vaddr, vaddr);
-	return line;
+	line.translated = fscanf(input, " P@%" SCNx32, &paddr) == 1;
+	if (!line.translated || init_phy_addr(&line.paddr, paddr & ~(uint32_t)(PAGE_SIZE - 1), paddr % PAGE_SIZE) != ERR_NONE)
+	{
+		line.translated = 0;
+		line.paddr.phy_page_num = 0;
+		line.paddr.page_offset = 0;
+	}
+	*command = line;
+	return ERR_NONE;
+}
+
+static int command_check(const command_t *command)
+{
+	if (command->order == SWITCH)
+	{
+		M_REQUIRE(command->pgd % PAGE_SIZE == 0, ERR_BAD_PARAMETER, "page-table root 0x%08" PRIX32 " is not page aligned", command->pgd);
+	}
+	if (command->order == INVALIDATE)
+	{
+		M_REQUIRE(command->scope <= INVAL_ALL, ERR_BAD_PARAMETER, "unknown invalidation scope %d", command->scope);
+		M_REQUIRE(command->scope != INVAL_RANGE || virt_addr_t_to_uint64_t(&command->vaddr) <= command->vaddr_end,
+				  ERR_BAD_PARAMETER, "empty invalidation range ending at 0x%016" PRIX64, command->vaddr_end);
+	}
+	bool wrongSize = (command->data_size != sizeof(word_t) && command->type == INSTRUCTION) || (command->type == DATA && command->data_size != sizeof(word_t) && command->data_size != 1);
+	bool writingInstruction = command->type == INSTRUCTION && command->order == WRITE;
+	bool invalidAddr = command->order != INVALIDATE && ((command->vaddr).page_offset % (uint16_t)command->data_size) != 0;
+	bool wrongWriteData = (command->order == READ && command->write_data != 0);
+	//bool wrongAligned = (command->vaddr).page_offset % 4 != 0;
+
+	// correcteur can be diff than READ / WRITE
+	// corecteur can be diff than DATA / INSTRUCTION
+	//???
+
+	if (wrongSize || writingInstruction || invalidAddr || wrongWriteData)
+	{
+		return ERR_BAD_PARAMETER;
+	}
+	return ERR_NONE;
+}
+
+int command_read(FILE *input, command_t *command)
+{
+	M_REQUIRE_NON_NULL(input);
+	M_REQUIRE_NON_NULL(command);
+	// invalid commands are skipped, as program_add_command() refuses them
+	while (handle_line(input, command) == ERR_NONE)
+	{
+		if (command_check(command) == ERR_NONE)
+			return ERR_NONE;
+	}
+	return ferror(input) ? ERR_IO : ERR_EOF;
 }
 
 int program_read(const char *filename, program_t *program)
@@ -94,21 +223,21 @@ int program_read(const char *filename, program_t *program)
 	int error = ERR_NONE;
 	M_REQUIRE_NON_NULL_CUSTOM_ERR(input, ERR_IO);
 
-	do
+	command_t lineCo;
+	while ((error = command_read(input, &lineCo)) == ERR_NONE)
 	{
-		command_t lineCo = handle_line(input);
-		error = program_add_command(program, &lineCo); // correcteur error is still not checked (the variable)
-	} while (!feof(input) && !ferror(input));
-	if (ferror(input))
-	{
-		fclose(input);
-		return ERR_IO;
+		error = program_add_command(program, &lineCo);
+		if (error != ERR_NONE)
+		{
+			fclose(input);
+			return error;
+		}
 	}
 	fclose(input);
-	if (program->nb_lines != 0)
-		program->nb_lines--;
+	if (error == ERR_IO)
+		return ERR_IO;
 	error = program_shrink(program);
-	return ferror(input) ? ERR_IO : error;
+	return error;
 }
 int program_init(program_t *program)
 {
@@ -157,20 +286,7 @@ int program_add_command(program_t *program, const command_t *command)
 	M_REQUIRE_NON_NULL(program);
 	M_REQUIRE_NON_NULL(command);
 
-	bool wrongSize = (command->data_size != sizeof(word_t) && command->type == INSTRUCTION) || (command->type == DATA && command->data_size != sizeof(word_t) && command->data_size != 1);
-	bool writingInstruction = command->type == INSTRUCTION && command->order == WRITE;
-	bool invalidAddr = ((command->vaddr).page_offset % (uint16_t)command->data_size) != 0;
-	bool wrongWriteData = (command->order == READ && command->write_data != 0);
-	//bool wrongAligned = (command->vaddr).page_offset % 4 != 0;
-
-	// correcteur can be diff than READ / WRITE
-	// corecteur can be diff than DATA / INSTRUCTION
-	//???
-
-	if (wrongSize || writingInstruction || invalidAddr || wrongWriteData)
-	{
-		return ERR_BAD_PARAMETER;
-	}
+	M_EXIT_IF_ERR(command_check(command), "checking a command");
 	if (program->nb_lines * sizeof(command_t) == program->allocated)
 	{
 		if ((program->listing = realloc(program->listing, sizeof(command_t) * 2 * program->allocated)) == NULL)
@@ -198,3 +314,45 @@ int program_free(program_t *program)
 	program->allocated = 0;
 	return ERR_NONE;
 }
+
+int program_interleave(const program_t *traces, size_t nb_traces, interleave_t mode, program_t *program)
+{
+	M_REQUIRE_NON_NULL(traces);
+	M_REQUIRE_NON_NULL(program);
+	M_REQUIRE(nb_traces > 0 && nb_traces <= UINT16_MAX + 1, ERR_BAD_PARAMETER, "cannot interleave %zu traces", nb_traces);
+	M_REQUIRE(mode < NB_INTERLEAVINGS, ERR_BAD_PARAMETER, "unknown interleaving %d", mode);
+
+	size_t *next = calloc(nb_traces, sizeof(size_t)); // next command of each trace
+	M_EXIT_IF_NULL(next, nb_traces * sizeof(size_t));
+	int error = program_init(program);
+	size_t turn = 0; // round robin: trace to take the next command from
+	while (error == ERR_NONE)
+	{
+		size_t k = nb_traces;
+		for (size_t i = 0; i < nb_traces; ++i)
+		{
+			const size_t t = mode == INTERLEAVE_ROUND_ROBIN ? (turn + i) % nb_traces : i;
+			if (next[t] < traces[t].nb_lines
+				&& (k == nb_traces
+					|| (mode == INTERLEAVE_TIMESTAMP && traces[t].listing[next[t]].timestamp < traces[k].listing[next[k]].timestamp)))
+			{
+				k = t;
+				if (mode == INTERLEAVE_ROUND_ROBIN)
+					break;
+			}
+		}
+		if (k == nb_traces) // all traces exhausted
+			break;
+		command_t command = traces[k].listing[next[k]++];
+		command.core = (uint16_t)k;
+		error = program_add_command(program, &command);
+		turn = k + 1;
+	}
+	free(next);
+	if (error != ERR_NONE)
+	{
+		program_free(program);
+		return error;
+	}
+	return program_shrink(program);
+}
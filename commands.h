@@ -20,9 +20,22 @@
 typedef enum
 {
 	READ,
-	WRITE
+	WRITE,
+	SWITCH,	   // context switch to another address space
+	INVALIDATE // TLB invalidation in the current address space
 } command_word_t;
 
+/** 
+ * @brief what an INVALIDATE command invalidates
+ **/
+typedef enum
+{
+	INVAL_PAGE,	 // the page of vaddr
+	INVAL_RANGE, // the pages of [vaddr, vaddr_end)
+	INVAL_ASID,	 // the whole current address space
+	INVAL_ALL	 // all address spaces
+} inval_scope_t;
+
 /** 
  * @brief a structure representing an abstraction of an assembly instruction
  **/
@@ -33,6 +46,14 @@ typedef struct
 	size_t data_size;
 	word_t write_data;
 	virt_addr_t vaddr;
+	int translated;	  // non zero when paddr holds the translation of vaddr
+	phy_addr_t paddr; // only meaningful when translated (see translate.h)
+	uint16_t asid;	  // SWITCH only: the address space switched to
+	pte_t pgd;		  // SWITCH only: physical address of its page-table root
+	inval_scope_t scope; // INVALIDATE only
+	uint64_t vaddr_end;	 // INVALIDATE of an INVAL_RANGE only: end of the range
+	uint16_t core;		 // core issuing the command (multi-core simulation, see multicore.h)
+	uint64_t timestamp;	 // time it is issued at, for program_interleave() (0 if none)
 } command_t;
 
 /** 
@@ -47,6 +68,16 @@ typedef struct
 	size_t allocated;
 } program_t;
 
+/**
+ * @brief how program_interleave() merges the traces of several cores
+ **/
+typedef enum
+{
+	INTERLEAVE_ROUND_ROBIN, // one command of each trace in turn
+	INTERLEAVE_TIMESTAMP,	// by increasing timestamp
+	NB_INTERLEAVINGS
+} interleave_t;
+
 /**
  * @brief A useful macro to loop over all program lines.
  * X is the name of the variable to be used for the line;
@@ -86,14 +117,34 @@ int program_shrink(program_t *program);
 
 /**
  * @brief Print the content of a program to a stream.
+ * Translated commands also get their physical address printed.
  * @param output the stream to print to.
  * @param program the program to be printed.
  * @return ERR_NONE if ok, appropriate error code otherwise.
  */
 int program_print(FILE *output, const program_t *program);
 
+/**
+ * @brief Read the next command of a file (see program_read() for the syntax),
+ * skipping the commands program_add_command() would refuse.
+ * @param input the stream to read from.
+ * @param command (modified) the command read.
+ * @return ERR_NONE if ok, ERR_EOF at the end of the stream (or of what can be
+ * parsed), ERR_IO on a read error.
+ */
+int command_read(FILE *input, command_t *command);
+
 /**
  * @brief Read a program (list of commands) from a file.
+ * A line may end with the physical address of its access, written as
+ * "P@0x" followed by 8 hexadecimal digits (see program_print()).
+ * A context switch is written "C 0x<asid> @0x<pgd>", where pgd is the
+ * (page aligned) physical address of the page-table root of that ASID.
+ * A TLB invalidation is written "F @0x<vaddr>" (one page),
+ * "F @0x<from> @0x<to>" (the pages of [from, to)), "F ASID" (the current
+ * address space) or "F ALL".
+ * Any command may be prefixed by "T<timestamp> " (decimal) and then by
+ * "<core>: " (decimal), e.g. "T120 1: R DW @0x0000000000001000".
  * @param filename the name of the file to read from.
  * @param program the program to be filled from file.
  * @return ERR_NONE if ok, appropriate error code otherwise.
@@ -107,3 +158,18 @@ int program_read(const char *filename, program_t *program);
  * @return ERR_NONE if ok, appropriate error code otherwise.
  */
 int program_free(program_t *program);
+
+/**
+ * @brief Merge the traces of several cores into a single program, the
+ * commands of traces[k] being issued by core k (their core is overwritten).
+ * Round robin takes one command of each (non exhausted) trace in turn;
+ * timestamp takes the command with the lowest timestamp among the next
+ * command of each trace, the lowest core first on ties. The order of the
+ * commands of a trace is always kept.
+ * @param traces the traces, one per core
+ * @param nb_traces the number of traces
+ * @param mode how the traces are merged
+ * @param program (modified) the merged program, to be freed by program_free()
+ * @return ERR_NONE if ok, appropriate error code otherwise.
+ */
+int program_interleave(const program_t *traces, size_t nb_traces, interleave_t mode, program_t *program);
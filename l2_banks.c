@@ -0,0 +1,169 @@
+/**
+ * @file l2_banks.c
+ * @brief contention model of a banked shared L2 cache
+ *
+ * @date 2019
+ */
+
+#include "l2_banks.h"
+#include "cache.h"
+#include "cache_mng.h"
+#include "error.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// parses a field of the geometry, ending with one of the chars of ends
+static int field_parse(const char **p, const char *ends, uint32_t *value)
+{
+    char *end = NULL;
+    const unsigned long v = strtoul(*p, &end, 10);
+    M_REQUIRE(end != *p && v <= UINT32_MAX && strchr(ends, *end) != NULL, ERR_BAD_PARAMETER,
+              "bad L2 banks field \"%s\"", *p);
+    *value = (uint32_t)v;
+    *p = *end == '\0' ? end : end + 1;
+    return ERR_NONE;
+}
+
+int l2_banks_config_parse(const char *spec, l2_banks_config_t *config)
+{
+    M_REQUIRE_NON_NULL(spec);
+    M_REQUIRE_NON_NULL(config);
+    const l2_banks_config_t none = L2_BANKS_CONFIG_NONE;
+    *config = none;
+    if (!strcmp(spec, "none"))
+        return ERR_NONE;
+    const char *p = spec;
+    M_EXIT_IF_ERR(field_parse(&p, "x", &config->banks), "parsing the number of banks");
+    M_EXIT_IF_ERR(field_parse(&p, ":", &config->ports), "parsing the number of ports");
+    if (*p != '\0')
+        M_EXIT_IF_ERR(field_parse(&p, ":", &config->busy), "parsing the occupancy");
+    if (*p != '\0')
+        M_EXIT_IF_ERR(field_parse(&p, "", &config->queue), "parsing the size of the queue");
+    return ERR_NONE;
+}
+
+int l2_banks_init(l2_banks_t *banks, const l2_banks_config_t *config)
+{
+    M_REQUIRE_NON_NULL(banks);
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE((config->banks & (config->banks - 1)) == 0 && config->banks <= L2_BANKS_MAX
+              && config->banks <= L2_CACHE_LINES, ERR_BAD_PARAMETER,
+              "number of banks (%" PRIu32 ") must be a power of 2 up to %d", config->banks, L2_BANKS_MAX);
+    M_REQUIRE(config->ports >= 1 && config->ports <= L2_BANKS_MAX_PORTS, ERR_BAD_PARAMETER,
+              "number of ports (%" PRIu32 ") out of bounds", config->ports);
+    M_REQUIRE(config->busy >= 1, ERR_BAD_PARAMETER, "%s", "an access must keep its port at least a cycle");
+    M_REQUIRE(config->queue <= L2_BANKS_MAX_QUEUE, ERR_BAD_PARAMETER,
+              "size of the queue (%" PRIu32 ") out of bounds", config->queue);
+
+    banks->config = *config;
+    banks->bank = NULL;
+    if (config->banks == 0)
+        return ERR_NONE;
+    banks->bank = calloc(config->banks, sizeof(l2_bank_t));
+    M_EXIT_IF_NULL(banks->bank, config->banks * sizeof(l2_bank_t));
+    return ERR_NONE;
+}
+
+void l2_banks_free(l2_banks_t *banks)
+{
+    if (banks != NULL)
+    {
+        free(banks->bank);
+        banks->bank = NULL;
+    }
+}
+
+int l2_banks_access(l2_banks_t *banks, const phy_addr_t *paddr, uint64_t arrival, uint32_t *delay)
+{
+    M_REQUIRE_NON_NULL(banks);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(delay);
+    *delay = 0;
+    if (banks->bank == NULL)
+        return ERR_NONE;
+
+    const l2_banks_config_t *config = &banks->config;
+    uint16_t set = 0;
+    M_EXIT_IF_ERR(cache_set_index(paddr, L2_CACHE, &set), "indexing L2");
+    l2_bank_t *bank = &banks->bank[set & (config->banks - 1)];
+
+    // with a full queue (all the last accesses still waiting), waits for the first of them to start
+    uint64_t ready = arrival;
+    if (config->queue != 0)
+    {
+        uint64_t first = UINT64_MAX;
+        for (uint32_t q = 0; q < config->queue; ++q)
+        {
+            if (bank->starts[q] < first)
+                first = bank->starts[q];
+        }
+        if (first > arrival)
+        {
+            ready = first;
+            bank->stats.full_stalls++;
+        }
+    }
+
+    uint32_t port = 0;
+    for (uint32_t p = 1; p < config->ports; ++p)
+    {
+        if (bank->free_at[p] < bank->free_at[port])
+            port = p;
+    }
+    const uint64_t start = bank->free_at[port] > ready ? bank->free_at[port] : ready;
+    bank->free_at[port] = start + config->busy;
+    if (config->queue != 0)
+    {
+        bank->starts[bank->next] = start;
+        bank->next = (bank->next + 1) % config->queue;
+    }
+
+    const uint64_t wait = start - arrival;
+    M_REQUIRE(wait <= UINT32_MAX, ERR_SIZE, "queueing delay (%" PRIu64 ") too large", wait);
+    *delay = (uint32_t)wait;
+    bank->stats.accesses++;
+    bank->stats.busy_cycles += config->busy;
+    bank->stats.delay += wait;
+    if (wait > bank->stats.max_delay)
+        bank->stats.max_delay = wait;
+    return ERR_NONE;
+}
+
+// prints the statistics of banks available during cycles, numbers with two decimals
+static void print_bank(FILE *output, const l2_bank_stats_t *stats, uint32_t ports, uint64_t cycles)
+{
+    const uint64_t available = (uint64_t)ports * cycles;
+    const uint64_t utilization = available == 0 ? 0 : stats->busy_cycles * 10000 / available;
+    const uint64_t average = stats->accesses == 0 ? 0 : stats->delay * 100 / stats->accesses;
+    fprintf(output, "ACCESSES: %" PRIu64 "; UTILIZATION: %" PRIu64 ".%02" PRIu64 "%%; QUEUEING DELAY: %" PRIu64
+            "; AVERAGE: %" PRIu64 ".%02" PRIu64 "; MAX: %" PRIu64 "; FULL QUEUE: %" PRIu64 "\n",
+            stats->accesses, utilization / 100, utilization % 100, stats->delay,
+            average / 100, average % 100, stats->max_delay, stats->full_stalls);
+}
+
+int l2_banks_print_stats(FILE *output, const l2_banks_t *banks, uint64_t cycles)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(banks);
+    if (banks->bank == NULL)
+        return ERR_NONE;
+    l2_bank_stats_t total;
+    memset(&total, 0, sizeof(l2_bank_stats_t));
+    for (uint32_t b = 0; b < banks->config.banks; ++b)
+    {
+        const l2_bank_stats_t *stats = &banks->bank[b].stats;
+        fprintf(output, "L2 BANK %" PRIu32 ": ", b);
+        print_bank(output, stats, banks->config.ports, cycles);
+        total.accesses += stats->accesses;
+        total.busy_cycles += stats->busy_cycles;
+        total.delay += stats->delay;
+        if (stats->max_delay > total.max_delay)
+            total.max_delay = stats->max_delay;
+        total.full_stalls += stats->full_stalls;
+    }
+    fprintf(output, "L2 BANKS: ");
+    print_bank(output, &total, banks->config.ports * banks->config.banks, cycles);
+    return ferror(output) ? ERR_IO : ERR_NONE;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+/**
+ * @file l2_banks.h
+ * @brief contention model of a banked shared L2 cache: the sets of L2 are
+ * interleaved over banks (set index modulo the number of banks), each bank
+ * starting at most PORTS accesses per cycle, each access keeping its port
+ * BUSY cycles. Accesses wait their turn in a FIFO request queue of the
+ * bank, of QUEUE entries: an access finding the queue full first waits for
+ * the oldest waiting one to be started. Accesses are served in trace order,
+ * at the time they reach the bank (the clock of the core issuing them).
+ *
+ * @date 2019
+ */
+
+#include "addr.h"
+
+#include <stdio.h>  // for FILE
+#include <stdint.h>
+
+#define L2_BANKS_MAX 64      // banks, at most L2_CACHE_LINES
+#define L2_BANKS_MAX_PORTS 8 // accesses started per cycle by a bank
+#define L2_BANKS_MAX_QUEUE 64
+
+/**
+ * @brief geometry of the banks; no model at all with 0 banks
+ */
+typedef struct
+{
+    uint32_t banks; // a power of 2, 0 for none
+    uint32_t ports; // accesses started per cycle, from 1 to L2_BANKS_MAX_PORTS
+    uint32_t busy;  // cycles a port is held by an access, at least 1
+    uint32_t queue; // waiting accesses, up to L2_BANKS_MAX_QUEUE, 0 for unbounded
+} l2_banks_config_t;
+
+#define L2_BANKS_CONFIG_NONE { 0, 1, 1, 0 }
+
+/**
+ * @brief what the accesses to a bank cost
+ */
+typedef struct
+{
+    uint64_t accesses;
+    uint64_t busy_cycles; // port cycles used
+    uint64_t delay;       // cycles spent waiting, over all accesses
+    uint64_t max_delay;
+    uint64_t full_stalls; // accesses which found the queue full
+} l2_bank_stats_t;
+
+/**
+ * @brief a bank: when each port is free again, and when the last accesses
+ * (up to the size of the queue, in a ring) were started
+ */
+typedef struct
+{
+    uint64_t free_at[L2_BANKS_MAX_PORTS];
+    uint64_t starts[L2_BANKS_MAX_QUEUE];
+    uint32_t next; // next slot of starts
+    l2_bank_stats_t stats;
+} l2_bank_t;
+
+typedef struct
+{
+    l2_banks_config_t config;
+    l2_bank_t *bank;
+} l2_banks_t;
+
+//=========================================================================
+/**
+ * @brief Parse the geometry of the banks: "BANKSxPORTS[:BUSY[:QUEUE]]"
+ * (BUSY being 1 and the queue unbounded by default), or "none".
+ *
+ * @param spec the string to parse
+ * @param config (modified) the parsed configuration
+ * @return error code
+ */
+int l2_banks_config_parse(const char *spec, l2_banks_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Allocate idle banks.
+ *
+ * @param banks (modified) the banks to initialize
+ * @param config their geometry (with 0 banks, nothing is allocated)
+ * @return error code
+ */
+int l2_banks_init(l2_banks_t *banks, const l2_banks_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Free the memory of banks.
+ *
+ * @param banks the banks to free
+ */
+void l2_banks_free(l2_banks_t *banks);
+
+//=========================================================================
+/**
+ * @brief Account an access to L2 in the bank of its set.
+ *
+ * @param banks the banks (nothing done without any)
+ * @param paddr the physical address accessed
+ * @param arrival the cycle it reaches L2 at
+ * @param delay (modified) the cycles it waits before being served
+ * @return error code
+ */
+int l2_banks_access(l2_banks_t *banks, const phy_addr_t *paddr, uint64_t arrival, uint32_t *delay);
+
+//=========================================================================
+/**
+ * @brief Print the accesses, the utilization (busy port cycles over the
+ * available ones) and the queueing delay of each bank, then of all of
+ * them. Nothing is printed without any bank.
+ *
+ * @param output the stream to print to
+ * @param banks the banks
+ * @param cycles the duration of the simulation
+ * @return error code
+ */
+int l2_banks_print_stats(FILE *output, const l2_banks_t *banks, uint64_t cycles);
@@ -3,6 +3,158 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#ifdef LIST_POOL
+
+// ======================================================================
+// pool-backed implementation: nodes are taken from the array of the list
+
+#define index_of(L, N) ((list_index_t)((N) - (L)->nodes))
+
+int is_empty_list(const list_t *list)
+{
+    M_REQUIRE_NON_NULL(list);
+    return list->front == LIST_NIL && list->back == LIST_NIL;
+}
+
+void init_list(list_t *list)
+{
+    M_REQUIRE_NON_NULL(list);
+    list->front = LIST_NIL;
+    list->back = LIST_NIL;
+    for (list_index_t i = 0; i < LIST_POOL_CAPACITY; ++i)
+        list->nodes[i].next = (list_index_t)(i + 1 < LIST_POOL_CAPACITY ? i + 1 : LIST_NIL);
+    list->free = 0;
+}
+
+void clear_list(list_t *list)
+{
+    if (list == NULL)
+        return;
+    init_list(list);
+}
+
+// takes a node from the free chain, or returns NULL if the pool is exhausted
+static node_t *node_alloc(list_t *list, const list_content_t *content)
+{
+    if (list->free == LIST_NIL)
+        return NULL;
+    node_t *newNode = &list->nodes[list->free];
+    list->free = newNode->next;
+    newNode->value = *content;
+    return newNode;
+}
+
+static void node_free(list_t *list, node_t *node)
+{
+    node->next = list->free;
+    list->free = index_of(list, node);
+}
+
+node_t *push_back(list_t *list, const list_content_t *content)
+{
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(list, NULL);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(content, NULL);
+    node_t *newNode = node_alloc(list, content);
+    if (newNode == NULL)
+        return NULL;
+    const list_index_t index = index_of(list, newNode);
+    newNode->next = LIST_NIL;
+    newNode->previous = list->back;
+    if (is_empty_list(list))
+        list->front = index;
+    else
+        list->nodes[list->back].next = index;
+    list->back = index;
+    return newNode;
+}
+
+node_t *push_front(list_t *list, const list_content_t *content)
+{
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(list, NULL);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(content, NULL);
+    node_t *newNode = node_alloc(list, content);
+    if (newNode == NULL)
+        return NULL;
+    const list_index_t index = index_of(list, newNode);
+    newNode->previous = LIST_NIL;
+    newNode->next = list->front;
+    if (is_empty_list(list))
+        list->back = index;
+    else
+        list->nodes[list->front].previous = index;
+    list->front = index;
+    return newNode;
+}
+
+void pop_back(list_t *list)
+{
+    M_REQUIRE_NON_NULL(list);
+    M_REQUIRE(!is_empty_list(list), ERR_SIZE, "Popping empty list", NULL);
+    node_t *toPop = &list->nodes[list->back];
+    list->back = toPop->previous;
+    if (list->back == LIST_NIL)
+        list->front = LIST_NIL;
+    else
+        list->nodes[list->back].next = LIST_NIL;
+    node_free(list, toPop);
+}
+
+void pop_front(list_t *list)
+{
+    M_REQUIRE_NON_NULL(list);
+    M_REQUIRE(!is_empty_list(list), ERR_SIZE, "Popping empty list", NULL);
+    node_t *toPop = &list->nodes[list->front];
+    list->front = toPop->next;
+    if (list->front == LIST_NIL)
+        list->back = LIST_NIL;
+    else
+        list->nodes[list->front].previous = LIST_NIL;
+    node_free(list, toPop);
+}
+
+void move_back(list_t *list, node_t *node)
+{
+    M_REQUIRE_NON_NULL(list);
+    M_REQUIRE_NON_NULL(node);
+    if (node->next == LIST_NIL)
+        return; //Node already at the back
+    const list_index_t index = index_of(list, node);
+    list->nodes[node->next].previous = node->previous;
+    if (node->previous != LIST_NIL)
+        list->nodes[node->previous].next = node->next;
+    else
+        list->front = node->next;
+
+    list->nodes[list->back].next = index;
+    node->previous = list->back;
+    node->next = LIST_NIL;
+    list->back = index;
+}
+
+void move_front(list_t *list, node_t *node)
+{
+    M_REQUIRE_NON_NULL(list);
+    M_REQUIRE_NON_NULL(node);
+    if (node->previous == LIST_NIL)
+        return; //Node already at the front
+    const list_index_t index = index_of(list, node);
+    list->nodes[node->previous].next = node->next;
+    if (node->next != LIST_NIL)
+        list->nodes[node->next].previous = node->previous;
+    else
+        list->back = node->previous;
+
+    list->nodes[list->front].previous = index;
+    node->next = list->front;
+    node->previous = LIST_NIL;
+    list->front = index;
+}
+
+#else
+
+// ======================================================================
+// heap-backed implementation: one allocation per node
+
 int is_empty_list(const list_t *list)
 {
     M_REQUIRE_NON_NULL(list);
@@ -120,6 +272,28 @@ void move_back(list_t *list, node_t *node)
     list->back = node;
 }
 
+void move_front(list_t *list, node_t *node)
+{
+    M_REQUIRE_NON_NULL(list);
+    M_REQUIRE_NON_NULL(node);
+    if (node->previous == NULL)
+        return; //Node already at the front
+    node_t *previousNode = node->previous;
+    previousNode->next = node->next;
+
+    if (node->next != NULL)
+        (node->next)->previous = previousNode;
+    else
+        list->back = previousNode; //Node put at the front was last node
+
+    (list->front)->previous = node;
+    node->next = list->front;
+    node->previous = NULL;
+    list->front = node;
+}
+
+#endif
+
 int print_list(FILE *stream, const list_t *list)
 {
     M_REQUIRE_NON_NULL(stream);
@@ -128,7 +302,7 @@ int print_list(FILE *stream, const list_t *list)
     size_t total = 0;
     for_all_nodes(n, list)
     {
-        if (n->previous != NULL)
+        if (n != list_front(list))
             fputs(", ", stream);
         print_node(stream, n->value);
         total++;
@@ -145,7 +319,7 @@ int print_reverse_list(FILE *stream, const list_t *list)
     size_t total = 0;
     for_all_nodes_reverse(n, list)
     {
-        if (n->next != NULL)
+        if (n != list_back(list))
             fputs(", ", stream);
         print_node(stream, n->value);
         total++;
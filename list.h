@@ -26,19 +26,66 @@ typedef uint32_t list_content_t;
 /**
  * @brief Doubly linked list type
  *
+ * Two implementations share the same API:
+ *  - by default, every node is allocated on the heap and linked by pointers;
+ *  - when compiled with LIST_POOL, the nodes live in an array embedded in
+ *    the list itself and are linked by 16-bit indices; a list then never
+ *    allocates and holds at most LIST_POOL_CAPACITY values.
+ *
+ * Nodes shall only be traversed through the list_front(), list_back(),
+ * list_next() and list_previous() macros (or for_all_nodes()), which work
+ * with both implementations.
  */
 typedef struct node node_t;
+
+#ifdef LIST_POOL
+
+#ifndef LIST_POOL_CAPACITY
+#define LIST_POOL_CAPACITY 256
+#endif
+
+typedef uint16_t list_index_t;
+#define LIST_NIL ((list_index_t) UINT16_MAX)
+
+struct node {
+    list_content_t value;
+    list_index_t previous;
+    list_index_t next;
+};
+struct list {
+    list_index_t front;
+    list_index_t back;
+    list_index_t free; // head of the chain of unused nodes (linked by next)
+    node_t nodes[LIST_POOL_CAPACITY];
+};
+
+#define list_node_at(L, I)    ((I) == LIST_NIL ? NULL : (node_t*) &(L)->nodes[I])
+#define list_front(L)         list_node_at(L, (L)->front)
+#define list_back(L)          list_node_at(L, (L)->back)
+#define list_next(L, X)       list_node_at(L, (X)->next)
+#define list_previous(L, X)   list_node_at(L, (X)->previous)
+
+#else
+
 struct list {
     node_t* front;
     node_t* back;
 };
-typedef struct list list_t;
 struct node {
     list_content_t value;
     node_t* previous;
     node_t* next;
 };
 
+#define list_front(L)         ((L)->front)
+#define list_back(L)          ((L)->back)
+#define list_next(L, X)       ((X)->next)
+#define list_previous(L, X)   ((X)->previous)
+
+#endif
+
+typedef struct list list_t;
+
 /**
  * @brief check whether the list is empty or not
  * @param this list to check
@@ -63,6 +110,7 @@ void clear_list(list_t* this);
  * @param this list where to add to
  * @param value value to be added
  * @return a pointer to the newly inserted element or NULL in case of error
+ * (e.g. when a pool-backed list is full)
  */
 node_t* push_back(list_t* this, const list_content_t* value);
 
@@ -93,6 +141,13 @@ void pop_front(list_t* this);
  */
 void move_back(list_t* this, node_t* node);
 
+/**
+ * @brief move a node at the beginning of the list
+ * @param this list to modify
+ * @param node pointer to the node to be moved
+ */
+void move_front(list_t* this, node_t* node);
+
 /**
  * @brief print a list (on one single line, no newline)
  * @param stream where to print to
@@ -123,5 +178,5 @@ int print_reverse_list(FILE* stream, const list_t* this);
  *    for_all_nodes(node, list) { do_something_with(node); }
  *
  */
-#define for_all_nodes(X, L)         for (node_t* X = (L)->front; X != NULL; X = X->next    )
-#define for_all_nodes_reverse(X, L) for (node_t* X = (L)->back ; X != NULL; X = X->previous)
+#define for_all_nodes(X, L)         for (node_t* X = list_front(L); X != NULL; X = list_next(L, X)    )
+#define for_all_nodes_reverse(X, L) for (node_t* X = list_back(L) ; X != NULL; X = list_previous(L, X))
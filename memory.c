@@ -9,6 +9,8 @@
 #define __USE_MINGW_ANSI_STDIO 1
 #endif
 
+#define _POSIX_C_SOURCE 200809L // for mmap() and friends
+
 #include "memory.h"
 #include "page_walk.h"
 #include "addr_mng.h"
@@ -20,9 +22,14 @@
 #include <string.h>   // for memset()
 #include <inttypes.h> // for SCNx macros
 #include <assert.h>
+#include <fcntl.h>    // for open()
+#include <unistd.h>   // for read() and close()
+#include <sys/stat.h> // for fstat()
+#include <sys/mman.h> // for mmap()
 
 #define BYTE_SIZE 1
 #define FOURKI 4096
+#define FILENAME_SIZE 100
 
 // ======================================================================
 /**
@@ -125,17 +132,70 @@ int mem_init_from_dumpfile(const char *filename, void **memory, size_t *mem_capa
     return ERR_NONE;
 }
 
+// ==========================================================================
+/**
+ * @brief Tool function reading the remaining lines of a description file
+ * (data pages: virtual address and filename) into memory. All the virtual
+ * addresses are translated at once with page_walk_batch().
+ */
+static int data_pages_read(FILE *masterFile, void *memory)
+{
+    size_t allocated = 16;
+    size_t nb_pages = 0;
+    virt_addr_t *vaddrs = calloc(allocated, sizeof(virt_addr_t));
+    char(*filenames)[FILENAME_SIZE] = calloc(allocated, FILENAME_SIZE);
+    phy_addr_t *paddrs = NULL;
+    int error = (vaddrs == NULL || filenames == NULL) ? ERR_MEM : ERR_NONE;
+
+    uint64_t address = 0;
+    while (error == ERR_NONE && fscanf(masterFile, "%" SCNx64, &address) == 1 &&
+           fscanf(masterFile, "%99s", filenames[nb_pages]) == 1)
+    {
+        error = init_virt_addr64(&vaddrs[nb_pages], address);
+        if (error == ERR_NONE && ++nb_pages == allocated)
+        {
+            allocated *= 2;
+            virt_addr_t *new_vaddrs = realloc(vaddrs, allocated * sizeof(virt_addr_t));
+            if (new_vaddrs != NULL)
+                vaddrs = new_vaddrs;
+            char(*new_filenames)[FILENAME_SIZE] = realloc(filenames, allocated * FILENAME_SIZE);
+            if (new_filenames != NULL)
+                filenames = new_filenames;
+            if (new_vaddrs == NULL || new_filenames == NULL)
+                error = ERR_MEM;
+        }
+    }
+    if (error == ERR_NONE && ferror(masterFile))
+        error = ERR_IO;
+
+    if (error == ERR_NONE && nb_pages > 0)
+    {
+        paddrs = calloc(nb_pages, sizeof(phy_addr_t));
+        error = paddrs == NULL ? ERR_MEM : page_walk_batch(memory, PGD_DEFAULT_ROOT, vaddrs, paddrs, nb_pages);
+    }
+    for (size_t i = 0; error == ERR_NONE && i < nb_pages; ++i)
+    {
+        error = page_read(filenames[i], memory, ((size_t)paddrs[i].phy_page_num << PAGE_OFFSET) | paddrs[i].page_offset);
+    }
+
+    free(paddrs);
+    free(filenames);
+    free(vaddrs);
+    return error;
+}
+
 // ==========================================================================
 
 int mem_init_from_description(const char *master_filename, void **memory, size_t *mem_capacity_in_bytes)
 {
 #define CLOSE_AND_RETURN(ERR)   \
     {                           \
-        if (ERR != ERR_NONE)    \
+        int err_ = (ERR);       \
+        if (err_ != ERR_NONE)   \
         {                       \
             fclose(masterFile); \
             *memory = NULL;     \
-            return ERR;         \
+            return err_;        \
         }                       \
     }
 
@@ -150,7 +210,7 @@ int mem_init_from_description(const char *master_filename, void **memory, size_t
     {
         CLOSE_AND_RETURN(ERR_MEM);
     }
-    char subFileName[100];
+    char subFileName[FILENAME_SIZE];
 
     fscanf(masterFile, "%s", subFileName);
     CLOSE_AND_RETURN(page_read(subFileName, *memory, 0));
@@ -164,17 +224,7 @@ int mem_init_from_description(const char *master_filename, void **memory, size_t
         fscanf(masterFile, "%s", subFileName);
         CLOSE_AND_RETURN(page_read(subFileName, *memory, address));
     }
-    virt_addr_t a = {0, 0, 0, 0, 0, 0};
-    phy_addr_t b = {0, 0};
-    while (!feof(masterFile) && !ferror(masterFile))
-    {
-        fscanf(masterFile, "%lx" SCNx64, &address);
-        CLOSE_AND_RETURN(init_virt_addr64(&a, address));
-        CLOSE_AND_RETURN(page_walk(*memory, &a, &b));
-        fscanf(masterFile, "%s", subFileName);
-        if (!feof(masterFile))
-            CLOSE_AND_RETURN(page_read(subFileName, *memory, (b.phy_page_num << PAGE_OFFSET) | b.page_offset));
-    }
+    CLOSE_AND_RETURN(data_pages_read(masterFile, *memory));
     if (ferror(masterFile))
     {
         CLOSE_AND_RETURN(ERR_IO);
@@ -182,6 +232,126 @@ int mem_init_from_description(const char *master_filename, void **memory, size_t
     fclose(masterFile);
     return ERR_NONE;
 }
+// ==========================================================================
+static int is_zero_area(const uint8_t *from, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (from[i] != 0)
+            return 0;
+    }
+    return 1;
+}
+
+// See memory.h for description
+int mem_image_write(const char *filename, const void *memory, size_t mem_capacity_in_bytes)
+{
+    M_REQUIRE_NON_NULL(filename);
+    M_REQUIRE_NON_NULL(memory);
+    M_REQUIRE(mem_capacity_in_bytes > 0, ERR_SIZE, "empty memory", NULL);
+
+    const size_t nb_pages = (mem_capacity_in_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t *frames = calloc(nb_pages, sizeof(uint32_t));
+    M_EXIT_IF_NULL(frames, nb_pages * sizeof(uint32_t));
+    size_t nb_frames = 0;
+    for (size_t page = 0; page < nb_pages; ++page)
+    {
+        const size_t page_size = page + 1 == nb_pages ? mem_capacity_in_bytes - page * PAGE_SIZE : PAGE_SIZE;
+        if (!is_zero_area((const uint8_t *)memory + page * PAGE_SIZE, page_size))
+            frames[nb_frames++] = (uint32_t)page;
+    }
+
+    mem_image_header_t header;
+    zero_init_var(header);
+    memcpy(header.magic, MEM_IMAGE_MAGIC, sizeof(MEM_IMAGE_MAGIC));
+    header.version = MEM_IMAGE_VERSION;
+    header.page_size = PAGE_SIZE;
+    header.mem_size = mem_capacity_in_bytes;
+    header.nb_frames = nb_frames;
+    const size_t index_end = sizeof(header) + nb_frames * sizeof(uint32_t);
+    header.data_offset = (index_end + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+    FILE *image = fopen(filename, "wb");
+    if (image == NULL)
+    {
+        free(frames);
+        return ERR_IO;
+    }
+    int error = ERR_NONE;
+    if (fwrite(&header, sizeof(header), 1, image) != 1 ||
+        fwrite(frames, sizeof(uint32_t), nb_frames, image) != nb_frames)
+        error = ERR_IO;
+    for (size_t i = 0; error == ERR_NONE && i < nb_frames; ++i)
+    {
+        const size_t from = (size_t)frames[i] * PAGE_SIZE;
+        const size_t page_size = frames[i] + 1 == nb_pages ? mem_capacity_in_bytes - from : PAGE_SIZE;
+        if (fseek(image, (long)(header.data_offset + from), SEEK_SET) != 0 ||
+            fwrite((const uint8_t *)memory + from, 1, page_size, image) != page_size)
+            error = ERR_IO;
+    }
+    // the file has to cover the whole memory space, even if it ends with zero frames
+    if (error == ERR_NONE && (nb_frames == 0 || frames[nb_frames - 1] + 1 != nb_pages))
+    {
+        if (fseek(image, (long)(header.data_offset + mem_capacity_in_bytes - 1), SEEK_SET) != 0 ||
+            fputc(0, image) == EOF)
+            error = ERR_IO;
+    }
+    if (fclose(image) != 0 && error == ERR_NONE)
+        error = ERR_IO;
+    free(frames);
+    return error;
+}
+
+// See memory.h for description
+int mem_init_from_image(const char *filename, void **memory, size_t *mem_capacity_in_bytes)
+{
+    M_REQUIRE_NON_NULL(filename);
+    M_REQUIRE_NON_NULL(memory);
+    M_REQUIRE_NON_NULL(mem_capacity_in_bytes);
+    *memory = NULL;
+
+    const int fd = open(filename, O_RDONLY);
+    M_REQUIRE(fd >= 0, ERR_IO, "cannot open \"%s\"", filename);
+
+    int error = ERR_NONE;
+    mem_image_header_t header;
+    struct stat file_stat;
+    if (read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) || fstat(fd, &file_stat) != 0)
+    {
+        error = ERR_IO;
+    }
+    else if (memcmp(header.magic, MEM_IMAGE_MAGIC, sizeof(MEM_IMAGE_MAGIC)) != 0 ||
+             header.version != MEM_IMAGE_VERSION || header.page_size != PAGE_SIZE ||
+             header.data_offset % PAGE_SIZE != 0 || header.mem_size == 0 ||
+             (uint64_t)file_stat.st_size < header.data_offset + header.mem_size)
+    {
+        error = ERR_BAD_PARAMETER;
+    }
+    else
+    {
+        void *mapped = mmap(NULL, header.mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                            fd, (off_t)header.data_offset);
+        if (mapped == MAP_FAILED)
+        {
+            error = ERR_MEM;
+        }
+        else
+        {
+            *memory = mapped;
+            *mem_capacity_in_bytes = header.mem_size;
+        }
+    }
+    close(fd);
+    return error;
+}
+
+// See memory.h for description
+int mem_image_free(void *memory, size_t mem_capacity_in_bytes)
+{
+    M_REQUIRE_NON_NULL(memory);
+    return munmap(memory, mem_capacity_in_bytes) == 0 ? ERR_NONE : ERR_MEM;
+}
+
 // See memory.h for description
 int vmem_page_dump_with_options(const void *mem_space, const virt_addr_t *from,
                                 addr_fmt_t show_addr, size_t line_size, const char *sep)
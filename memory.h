@@ -9,6 +9,7 @@
 
 #include "addr.h"   // for virt_addr_t
 #include <stdlib.h> // for size_t and free()
+#include <stdint.h> // for uint32_t and uint64_t
 
 /**
  * @brief enum type to describe how to print address;
@@ -63,6 +64,63 @@ int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capa
 int mem_init_from_description(const char* master_filename, void** memory, size_t* mem_capacity_in_bytes);
 
 
+/**
+ * @brief Precompiled memory image file format: a header, an index of the
+ * (non-zero) frames present in the image, then the whole memory space
+ * starting at a page-aligned file offset, so that it can be directly mapped.
+ */
+#define MEM_IMAGE_MAGIC "PPSMEMI"
+#define MEM_IMAGE_VERSION 1
+
+typedef struct {
+    char magic[8];          // MEM_IMAGE_MAGIC
+    uint32_t version;       // MEM_IMAGE_VERSION
+    uint32_t page_size;     // PAGE_SIZE
+    uint64_t mem_size;      // total size of the memory space, in bytes
+    uint64_t nb_frames;     // number of entries (uint32_t frame numbers) in the frame index
+    uint64_t data_offset;   // file offset of the memory space, multiple of PAGE_SIZE
+} mem_image_header_t;
+
+/**
+ * @brief Write a whole memory space (typically created by
+ * mem_init_from_description()) to a precompiled memory image file.
+ * Zero frames are not written (the file may be sparse).
+ *
+ * @param filename the name of the image file to write to
+ * @param memory pointer to the begining of the memory
+ * @param mem_capacity_in_bytes total size of the memory
+ * @return error code
+ */
+
+int mem_image_write(const char* filename, const void* memory, size_t mem_capacity_in_bytes);
+
+
+/**
+ * @brief Create the whole memory space from a precompiled memory image file,
+ * by mapping it (privately: writes do not modify the file). The cost does not
+ * depend on the size of the memory space.
+ * The memory shall be released with mem_image_free() (and NOT free()).
+ *
+ * @param filename the name of the image file to read from
+ * @param memory (modified) pointer to the begining of the memory
+ * @param mem_capacity_in_bytes (modified) total size of the created memory
+ * @return error code, *p_memory shall be NULL in case of error
+ */
+
+int mem_init_from_image(const char* filename, void** memory, size_t* mem_capacity_in_bytes);
+
+
+/**
+ * @brief Release a memory space created by mem_init_from_image().
+ *
+ * @param memory pointer to the begining of the memory
+ * @param mem_capacity_in_bytes total size of the memory
+ * @return error code
+ */
+
+int mem_image_free(void* memory, size_t mem_capacity_in_bytes);
+
+
 /**
  * @brief Prints the content of one page from its virtual address.
  * It prints the content reading it as 32 bits integers.
@@ -0,0 +1,67 @@
+/**
+ * @file mkimage.c
+ * @brief tool creating a precompiled memory image (see mem_init_from_image())
+ * from a memory description (or dump) file.
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32 || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "error.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// ======================================================================
+static void error(const char *pgm, const char *msg)
+{
+    assert(msg != NULL);
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename image_filename\n", pgm);
+    fprintf(stderr, "examples: %s desc memory_description.txt memory.img\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin memory.img\n", pgm);
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        error(argv[0], "please provide memory format and filename, and image filename:");
+        return 1;
+    }
+    int dump = 1;
+    if (strcmp(argv[1], "dump"))
+    {
+        if (strcmp(argv[1], "desc"))
+        {
+            error(argv[0], "unknown command.");
+            return 1;
+        }
+        dump = 0;
+    }
+
+    void *mem_space = NULL;
+    size_t mem_size = 0;
+    int err = dump ? mem_init_from_dumpfile(argv[2], &mem_space, &mem_size)
+                   : mem_init_from_description(argv[2], &mem_space, &mem_size);
+    if (err != ERR_NONE)
+    {
+        error(argv[0], "problem initializing memory from provided file.");
+        return 3;
+    }
+
+    err = mem_image_write(argv[3], mem_space, mem_size);
+    if (err != ERR_NONE)
+        fprintf(stderr, "ERROR: cannot write image \"%s\": %s\n", argv[3], ERR_MESSAGES[err - ERR_NONE]);
+
+    free(mem_space);
+    return err == ERR_NONE ? 0 : 4;
+}
@@ -0,0 +1,346 @@
+/**
+ * @file multicore.c
+ * @brief simulation of several cores sharing the L2 cache
+ *
+ * @date 2019
+ */
+
+#include "multicore.h"
+#include "tlb_hrchy_mng.h"
+#include "addr_mng.h"
+#include "error.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+int multicore_init(multicore_t *mc, size_t nb_cores, const tlb_hrchy_config_t *tlb_config,
+                   cache_indexing_t indexing, coherence_protocol_t protocol,
+                   const l2_banks_config_t *banks_config)
+{
+    M_REQUIRE_NON_NULL(mc);
+    M_REQUIRE_NON_NULL(tlb_config);
+    M_REQUIRE_NON_NULL(banks_config);
+    M_REQUIRE(nb_cores >= 1 && nb_cores <= MULTICORE_MAX_CORES, ERR_BAD_PARAMETER,
+              "number of cores (%zu) out of bounds", nb_cores);
+    M_REQUIRE(indexing < NB_CACHE_INDEXINGS, ERR_BAD_PARAMETER, "unknown indexing %d", indexing);
+    M_REQUIRE(protocol < NB_COHERENCE_PROTOCOLS, ERR_BAD_PARAMETER, "unknown coherence protocol %d", protocol);
+    M_REQUIRE(indexing != CACHE_VIPT || (cache_vipt_check(L1_ICACHE) == ERR_NONE && cache_vipt_check(L1_DCACHE) == ERR_NONE),
+              ERR_SIZE, "%s", "the L1 caches cannot be virtually indexed");
+
+    memset(mc, 0, sizeof(multicore_t));
+    mc->indexing = indexing;
+    mc->protocol = protocol;
+    mc->latency = (cache_latency_t)CACHE_LATENCY_DEFAULT;
+    M_EXIT_IF_ERR(l2_banks_init(&mc->banks, banks_config), "initializing the L2 banks");
+    mc->cores = calloc(nb_cores, sizeof(core_t));
+    mc->l2_cache = calloc(L2_CACHE_LINES * L2_CACHE_WAYS, sizeof(l2_cache_entry_t));
+    if (mc->cores == NULL || mc->l2_cache == NULL)
+    {
+        multicore_free(mc);
+        return ERR_MEM;
+    }
+    for (; mc->nb_cores < nb_cores; mc->nb_cores++)
+    {
+        core_t *core = &mc->cores[mc->nb_cores];
+        const int err = tlb_hrchy_init(&core->tlb, tlb_config);
+        if (err != ERR_NONE)
+        {
+            multicore_free(mc);
+            return err;
+        }
+        (void)cache_flush(core->l1_icache, L1_ICACHE);
+        (void)cache_flush(core->l1_dcache, L1_DCACHE);
+    }
+    (void)cache_flush(mc->l2_cache, L2_CACHE);
+    return ERR_NONE;
+}
+
+int coherence_protocol_parse(const char *name, coherence_protocol_t *protocol)
+{
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(protocol);
+    static const char *const names[NB_COHERENCE_PROTOCOLS] = { "none", "mesi", "moesi" };
+    for (coherence_protocol_t p = COHERENCE_NONE; p < NB_COHERENCE_PROTOCOLS; p++)
+    {
+        if (!strcmp(name, names[p]))
+        {
+            *protocol = p;
+            return ERR_NONE;
+        }
+    }
+    M_EXIT(ERR_BAD_PARAMETER, "unknown coherence protocol \"%s\"", name);
+}
+
+void multicore_free(multicore_t *mc)
+{
+    if (mc == NULL)
+        return;
+    for (size_t c = 0; c < mc->nb_cores; ++c)
+        tlb_hrchy_free(&mc->cores[c].tlb);
+    free(mc->cores);
+    free(mc->l2_cache);
+    l2_banks_free(&mc->banks);
+    memset(mc, 0, sizeof(multicore_t));
+}
+
+// invalidates the translations of an address space in the TLBs of a core
+static int invalidate(tlb_hrchy_t *tlb, uint16_t asid, const command_t *command)
+{
+    switch (command->scope)
+    {
+    case INVAL_PAGE:
+        return tlb_invalidate_page(tlb, asid, &command->vaddr);
+    case INVAL_RANGE:
+        return tlb_invalidate_range(tlb, asid, virt_addr_t_to_uint64_t(&command->vaddr), command->vaddr_end);
+    case INVAL_ASID:
+        return tlb_invalidate_asid(tlb, asid);
+    default:
+        return tlb_invalidate_all(tlb);
+    }
+}
+
+// ======================================================================
+// coherence of the L1 data caches
+
+/*
+ * Snoops the L1 data caches of the other cores, before an access of core self
+ * to the line of paddr (own: its entry in the L1 data cache of self, if any).
+ * A write invalidates all other copies (and the L2 one, own being then stale);
+ * a read downgrades them. On a miss, a copy in a state allowed to supply the
+ * line (Exclusive, Modified, or Owned with MOESI) is copied to words, and
+ * *supplied set. *shared tells whether another core keeps a copy.
+ */
+static int coherence_snoop(multicore_t *mc, size_t self, phy_addr_t *paddr, int write,
+                           const l1_dcache_entry_t *own, word_t *words, int *supplied, int *shared)
+{
+    coherence_stats_t *stats = &mc->cores[self].coherence;
+    *supplied = 0;
+    *shared = 0;
+    for (size_t c = 0; c < mc->nb_cores; ++c)
+    {
+        if (c == self)
+            continue;
+        void *entry = NULL;
+        stats->snoops++;
+        M_EXIT_IF_ERR(cache_lookup(mc->cores[c].l1_dcache, paddr, L1_DCACHE, &entry), "snooping");
+        l1_dcache_entry_t *peer = entry;
+        if (peer == NULL)
+            continue;
+        if (own == NULL && !*supplied
+            && (peer->state == MESI_EXCLUSIVE || peer->state == MESI_MODIFIED || peer->state == MESI_OWNED))
+        {
+            memcpy(words, peer->line, sizeof(peer->line));
+            *supplied = 1;
+        }
+        if (write)
+        {
+            peer->v = 0;
+            peer->state = MESI_INVALID;
+            stats->invalidations++;
+        }
+        else
+        {
+            *shared = 1;
+            if (peer->state == MESI_MODIFIED)
+                peer->state = mc->protocol == COHERENCE_MOESI ? MESI_OWNED : MESI_SHARED;
+            else if (peer->state == MESI_EXCLUSIVE)
+                peer->state = MESI_SHARED;
+        }
+    }
+    if (write && own != NULL)
+    {
+        void *entry = NULL;
+        M_EXIT_IF_ERR(cache_lookup(mc->l2_cache, paddr, L2_CACHE, &entry), "looking L2 up");
+        if (entry != NULL)
+        {
+            ((l2_cache_entry_t *)entry)->v = 0;
+            stats->invalidations++;
+        }
+    }
+    return ERR_NONE;
+}
+
+// performs a read or a write, accounted in stats (if not NULL)
+static int access_line(multicore_t *mc, core_t *core, void *mem_space, phy_addr_t *paddr, mem_access_t access,
+                       const command_t *command, cache_stats_t *stats)
+{
+    void *l1_cache = access == INSTRUCTION ? (void *)core->l1_icache : (void *)core->l1_dcache;
+    uint32_t word = 0;
+    uint8_t byte = 0;
+    switch (command->order)
+    {
+    case READ:
+        if (command->data_size == sizeof(word_t))
+            return cache_read_with_stats(mem_space, paddr, access, l1_cache, mc->l2_cache, &word, LRU, stats);
+        return cache_read_byte_with_stats(mem_space, paddr, access, l1_cache, mc->l2_cache, &byte, LRU, stats);
+    case WRITE:
+        if (command->data_size == sizeof(word_t))
+            return cache_write_with_stats(mem_space, paddr, core->l1_dcache, mc->l2_cache, &command->write_data, LRU, stats);
+        return cache_write_byte_with_stats(mem_space, paddr, core->l1_dcache, mc->l2_cache, (uint8_t)command->write_data, LRU, stats);
+    default:
+        M_EXIT_ERR(ERR_BAD_PARAMETER, "unknown order %d", command->order);
+    }
+}
+
+// adds to cycles the wait of an access for its bank of L2, if it reaches L2
+static int l2_contention(multicore_t *mc, const core_t *core, const phy_addr_t *paddr, int served_by, uint32_t *cycles)
+{
+    if (served_by != L2_CACHE && served_by != NB_CACHE_TYPES)
+        return ERR_NONE;
+    // it reaches L2 once it missed in L1
+    const uint64_t arrival = core->cycles + cache_access_latency(&mc->latency, mc->indexing, L1_DCACHE);
+    uint32_t delay = 0;
+    M_EXIT_IF_ERR(l2_banks_access(&mc->banks, paddr, arrival, &delay), "waiting for an L2 bank");
+    *cycles += delay;
+    return ERR_NONE;
+}
+
+// performs a data access of core self following the coherence protocol; returns its latency through cycles
+static int coherent_access(multicore_t *mc, size_t self, void *mem_space, phy_addr_t *paddr,
+                           const command_t *command, uint32_t *cycles)
+{
+    core_t *core = &mc->cores[self];
+    const int write = command->order == WRITE;
+    void *entry = NULL;
+    M_EXIT_IF_ERR(cache_lookup(core->l1_dcache, paddr, L1_DCACHE, &entry), "looking L1 up");
+    l1_dcache_entry_t *own = entry;
+    const int upgrade = write && own != NULL && (own->state == MESI_SHARED || own->state == MESI_OWNED);
+
+    word_t words[L1_DCACHE_WORDS_PER_LINE];
+    int supplied = 0;
+    int shared = 0;
+    const uint64_t invalidations = core->coherence.invalidations;
+    if (own == NULL || upgrade)
+        M_EXIT_IF_ERR(coherence_snoop(mc, self, paddr, write, own, words, &supplied, &shared), "snooping");
+    if (supplied)
+    {
+        core->coherence.transfers++;
+        M_EXIT_IF_ERR(cache_fill(paddr, L1_DCACHE, core->l1_dcache, mc->l2_cache, words), "transferring a line");
+    }
+    core->coherence.upgrades += (uint64_t)upgrade;
+
+    const cache_stats_t before = core->stats;
+    M_EXIT_IF_ERR(access_line(mc, core, mem_space, paddr, DATA, command, supplied ? NULL : &core->stats), "accessing");
+    const int served_by = supplied ? L1_DCACHE : cache_served_by(&before, &core->stats);
+    *cycles = cache_access_latency(&mc->latency, mc->indexing, served_by);
+    M_EXIT_IF_ERR(l2_contention(mc, core, paddr, served_by, cycles), "accessing L2");
+    if (supplied || core->coherence.invalidations != invalidations)
+        *cycles += mc->latency.coherence;
+
+    M_EXIT_IF_ERR(cache_lookup(core->l1_dcache, paddr, L1_DCACHE, &entry), "looking L1 up");
+    M_REQUIRE(entry != NULL, ERR_BAD_PARAMETER, "%s", "line not in L1 after access");
+    own = entry;
+    if (write)
+        own->state = MESI_MODIFIED;
+    else if (own->state == MESI_INVALID) // just brought in
+        own->state = shared ? MESI_SHARED : MESI_EXCLUSIVE;
+    return ERR_NONE;
+}
+
+int multicore_execute(multicore_t *mc, void *mem_space, const command_t *command)
+{
+    M_REQUIRE_NON_NULL(mc);
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(command);
+    M_REQUIRE(command->core < mc->nb_cores, ERR_BAD_PARAMETER, "no core %" PRIu16, command->core);
+    core_t *core = &mc->cores[command->core];
+
+    if (command->order == SWITCH)
+    {
+        const addr_space_t space = { command->asid, command->pgd };
+        return tlb_hrchy_switch(&core->tlb, &space);
+    }
+    if (command->order == INVALIDATE)
+    {
+        const uint16_t asid = core->tlb.space.asid;
+        for (size_t c = 0; c < mc->nb_cores; ++c)
+            M_EXIT_IF_ERR(invalidate(&mc->cores[c].tlb, asid, command), "invalidating the TLBs");
+        mc->shootdowns++;
+        return ERR_NONE;
+    }
+
+    phy_addr_t paddr;
+    int hit = 0;
+    const mem_access_t access = command->type == INSTRUCTION && command->order == READ ? INSTRUCTION : DATA;
+    M_EXIT_IF_ERR(tlb_hrchy_search(mem_space, &command->vaddr, &paddr, access, &core->tlb, &hit), "translating");
+
+    uint32_t cycles = 0;
+    if (mc->protocol != COHERENCE_NONE && access == DATA)
+        M_EXIT_IF_ERR(coherent_access(mc, command->core, mem_space, &paddr, command, &cycles), "accessing coherently");
+    else
+    {
+        const cache_stats_t before = core->stats;
+        M_EXIT_IF_ERR(access_line(mc, core, mem_space, &paddr, access, command, &core->stats), "accessing");
+        const int served_by = cache_served_by(&before, &core->stats);
+        cycles = cache_access_latency(&mc->latency, mc->indexing, served_by);
+        M_EXIT_IF_ERR(l2_contention(mc, core, &paddr, served_by, &cycles), "accessing L2");
+    }
+    core->accesses++;
+    core->cycles += cycles;
+    return ERR_NONE;
+}
+
+int multicore_run(multicore_t *mc, void *mem_space, const program_t *program)
+{
+    M_REQUIRE_NON_NULL(program);
+    for_all_lines(line, program)
+    {
+        M_EXIT_IF_ERR(multicore_execute(mc, mem_space, line), "executing a command");
+    }
+    return ERR_NONE;
+}
+
+static void print_coherence(FILE *output, const coherence_stats_t *stats)
+{
+    fprintf(output, "COHERENCE: TRANSFERS: %" PRIu64 "; INVALIDATIONS: %" PRIu64 "; UPGRADES: %" PRIu64 "; SNOOPS: %" PRIu64 "\n",
+            stats->transfers, stats->invalidations, stats->upgrades, stats->snoops);
+}
+
+int multicore_print_stats(FILE *output, const multicore_t *mc)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(mc);
+    cache_stats_t total;
+    memset(&total, 0, sizeof(cache_stats_t));
+    coherence_stats_t coherence;
+    memset(&coherence, 0, sizeof(coherence_stats_t));
+    uint64_t accesses = 0;
+    uint64_t walks = 0;
+    uint64_t cycles = 0;
+    for (size_t c = 0; c < mc->nb_cores; ++c)
+    {
+        const core_t *core = &mc->cores[c];
+        fprintf(output, "CORE %zu: ACCESSES: %" PRIu64 "; L1I HITS: %" PRIu64 "; L1D HITS: %" PRIu64
+                "; L2 HITS: %" PRIu64 "; MISSES: %" PRIu64 "; TLB WALKS: %" PRIu64 "; CYCLES: %" PRIu64 "\n",
+                c, core->accesses, core->stats.hits[L1_ICACHE], core->stats.hits[L1_DCACHE],
+                core->stats.hits[L2_CACHE], core->stats.misses, core->tlb.stats.walks, core->cycles);
+        if (mc->protocol != COHERENCE_NONE)
+        {
+            fprintf(output, "CORE %zu ", c);
+            print_coherence(output, &core->coherence);
+        }
+        coherence.transfers += core->coherence.transfers;
+        coherence.invalidations += core->coherence.invalidations;
+        coherence.upgrades += core->coherence.upgrades;
+        coherence.snoops += core->coherence.snoops;
+        accesses += core->accesses;
+        for (int l = L1_ICACHE; l < NB_CACHE_TYPES; ++l)
+            total.hits[l] += core->stats.hits[l];
+        total.misses += core->stats.misses;
+        walks += core->tlb.stats.walks;
+        if (core->cycles > cycles)
+            cycles = core->cycles;
+    }
+    fprintf(output, "SHARED: ACCESSES: %" PRIu64 "; L1 HITS: %" PRIu64 "; L2 HITS: %" PRIu64 "; MISSES: %" PRIu64
+            "; TLB WALKS: %" PRIu64 "; SHOOTDOWNS: %" PRIu64 "; CYCLES: %" PRIu64 "\n",
+            accesses, total.hits[L1_ICACHE] + total.hits[L1_DCACHE], total.hits[L2_CACHE],
+            total.misses, walks, mc->shootdowns, cycles);
+    if (mc->protocol != COHERENCE_NONE)
+    {
+        fprintf(output, "SHARED ");
+        print_coherence(output, &coherence);
+    }
+    M_EXIT_IF_ERR(l2_banks_print_stats(output, &mc->banks, cycles), "printing the L2 banks");
+    return ferror(output) ? ERR_IO : ERR_NONE;
+}
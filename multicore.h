@@ -0,0 +1,157 @@
+#pragma once
+
+/**
+ * @file multicore.h
+ * @brief simulation of several cores, each with private L1 caches and TLBs,
+ * sharing the L2 cache and the memory
+ *
+ * @date 2019
+ */
+
+#include "addr.h"
+#include "cache.h"
+#include "cache_mng.h"
+#include "commands.h"
+#include "l2_banks.h"
+#include "tlb_hrchy.h"
+
+#include <stdio.h>  // for FILE
+#include <stddef.h> // for size_t
+
+#define MULTICORE_MAX_CORES 64
+
+/**
+ * @brief how the L1 data caches of the cores are kept coherent (by snooping
+ * the L1 data caches of the other cores on every miss and every write):
+ *  - NONE: not at all (their copies of a line may be stale);
+ *  - MESI: a read miss gets the line from a core holding it Exclusive or
+ *    Modified (which then become Shared), otherwise from L2 or memory;
+ *    a write invalidates all other copies;
+ *  - MOESI: same, but a Modified line read by another core becomes Owned,
+ *    and keeps supplying it to the next readers.
+ * The caches are write-through: memory and L2 are never stale, Modified
+ * only means that the core wrote the line since it got it.
+ */
+typedef enum
+{
+    COHERENCE_NONE,
+    COHERENCE_MESI,
+    COHERENCE_MOESI,
+    NB_COHERENCE_PROTOCOLS
+} coherence_protocol_t;
+
+/**
+ * @brief coherence traffic caused by the accesses of a core
+ */
+typedef struct
+{
+    uint64_t transfers;     // misses served by the L1 data cache of another core
+    uint64_t invalidations; // copies invalidated in other L1 data caches and in L2
+    uint64_t upgrades;      // writes to a Shared or Owned line
+    uint64_t snoops;        // lookups of the L1 data cache of another core
+} coherence_stats_t;
+
+/**
+ * @brief one core: its private caches and TLBs, and what its commands cost
+ */
+typedef struct
+{
+    l1_icache_entry_t l1_icache[L1_ICACHE_LINES * L1_ICACHE_WAYS];
+    l1_dcache_entry_t l1_dcache[L1_DCACHE_LINES * L1_DCACHE_WAYS];
+    tlb_hrchy_t tlb;
+    cache_stats_t stats; // accesses of the core, per level serving them (transfers excluded)
+    coherence_stats_t coherence;
+    uint64_t accesses;
+    uint64_t cycles;
+} core_t;
+
+/**
+ * @brief the cores and the (shared) L2 cache, optionally banked: the
+ * accesses of the cores then wait for their bank (see l2_banks.h), the
+ * wait being added to their cycles
+ */
+typedef struct
+{
+    size_t nb_cores;
+    core_t *cores;
+    l2_cache_entry_t *l2_cache;
+    cache_indexing_t indexing; // of the L1 caches
+    cache_latency_t latency;
+    coherence_protocol_t protocol;
+    l2_banks_t banks;
+    uint64_t shootdowns; // TLB invalidations, broadcast to all the cores
+} multicore_t;
+
+//=========================================================================
+/**
+ * @brief Allocate the cores and the L2 cache, all empty, every core being
+ * in the default address space.
+ *
+ * @param mc (modified) the system to initialize
+ * @param nb_cores the number of cores (at most MULTICORE_MAX_CORES)
+ * @param tlb_config the configuration of the TLBs of each core
+ * @param indexing how the L1 caches are indexed
+ * @param protocol how the L1 data caches are kept coherent
+ * @param banks_config the banks of L2 (see L2_BANKS_CONFIG_NONE)
+ * @return error code
+ */
+int multicore_init(multicore_t *mc, size_t nb_cores, const tlb_hrchy_config_t *tlb_config,
+                   cache_indexing_t indexing, coherence_protocol_t protocol,
+                   const l2_banks_config_t *banks_config);
+
+//=========================================================================
+/**
+ * @brief Parse the name of a coherence protocol: none, mesi or moesi.
+ *
+ * @param name the string to parse
+ * @param protocol (modified) the parsed protocol
+ * @return error code
+ */
+int coherence_protocol_parse(const char *name, coherence_protocol_t *protocol);
+
+//=========================================================================
+/**
+ * @brief Free the memory of a system.
+ *
+ * @param mc the system to free
+ */
+void multicore_free(multicore_t *mc);
+
+//=========================================================================
+/**
+ * @brief Execute a command on the core it is issued by: context switches
+ * only affect the TLBs of that core, invalidations (of the address space of
+ * that core) are broadcast to the TLBs of all the cores. Reads and writes
+ * are translated by the TLBs of the core, then go through its L1 caches and
+ * the shared L2 cache, data accesses following the coherence protocol.
+ *
+ * @param mc the system
+ * @param mem_space the (shared) memory
+ * @param command the command
+ * @return error code
+ */
+int multicore_execute(multicore_t *mc, void *mem_space, const command_t *command);
+
+//=========================================================================
+/**
+ * @brief Execute all the commands of a program, in order.
+ *
+ * @param mc the system
+ * @param mem_space the (shared) memory
+ * @param program the program
+ * @return error code
+ */
+int multicore_run(multicore_t *mc, void *mem_space, const program_t *program);
+
+//=========================================================================
+/**
+ * @brief Print the statistics of each core, then the shared ones: totals
+ * over all cores, and the cycles of the slowest core. The coherence traffic
+ * is only printed with a coherence protocol, the contention of the banks of
+ * L2 only with banks (over the cycles of the slowest core).
+ *
+ * @param output the stream to print to
+ * @param mc the system
+ * @return error code
+ */
+int multicore_print_stats(FILE *output, const multicore_t *mc);
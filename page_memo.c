@@ -0,0 +1,167 @@
+/**
+ * @file page_memo.c
+ * @brief Memoization of virtual to physical page translations
+ *
+ * @date 2019
+ */
+
+#include "page_memo.h"
+#include "page_walk.h"
+#include "addr_mng.h"
+#include "error.h"
+#include <stdlib.h>
+#include <string.h> // for memset()
+
+// Fibonacci hashing of a virtual page number
+static inline size_t memo_hash(uint64_t key, size_t capacity)
+{
+    return (size_t)((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (capacity - 1);
+}
+
+// slot holding key, or the empty slot where it would be inserted
+static page_memo_slot_t *memo_find(page_memo_slot_t *slots, size_t capacity, uint64_t key)
+{
+    size_t i = memo_hash(key, capacity);
+    while (slots[i].key != 0 && slots[i].key != key)
+        i = (i + 1) & (capacity - 1);
+    return &slots[i];
+}
+
+// doubles the capacity of a table
+static int memo_grow(page_memo_slot_t **slots, size_t *capacity)
+{
+    const size_t grown = *capacity * 2;
+    page_memo_slot_t *grown_slots = calloc(grown, sizeof(page_memo_slot_t));
+    M_EXIT_IF_NULL(grown_slots, grown * sizeof(page_memo_slot_t));
+    for (size_t i = 0; i < *capacity; ++i)
+    {
+        if ((*slots)[i].key != 0)
+            *memo_find(grown_slots, grown, (*slots)[i].key) = (*slots)[i];
+    }
+    free(*slots);
+    *slots = grown_slots;
+    *capacity = grown;
+    return ERR_NONE;
+}
+
+// remembers the physical page of a page table read by a walk
+static int memo_add_table(page_memo_t *memo, pte_t table)
+{
+    const uint64_t key = (uint64_t)(table >> PAGE_OFFSET) + 1;
+    page_memo_slot_t *slot = memo_find(memo->tables, memo->tables_capacity, key);
+    if (slot->key == key)
+        return ERR_NONE;
+    slot->key = key;
+    if (++memo->nb_tables * 4 > memo->tables_capacity * 3)
+    {
+        M_EXIT_IF_ERR(memo_grow(&memo->tables, &memo->tables_capacity), "growing the page-table set");
+    }
+    return ERR_NONE;
+}
+
+int page_memo_init(page_memo_t *memo, size_t capacity)
+{
+    M_REQUIRE_NON_NULL(memo);
+    size_t rounded = PAGE_MEMO_MIN_CAPACITY;
+    while (rounded < capacity)
+        rounded *= 2;
+    memo->slots = calloc(rounded, sizeof(page_memo_slot_t));
+    M_EXIT_IF_NULL(memo->slots, rounded * sizeof(page_memo_slot_t));
+    memo->capacity = rounded;
+    memo->size = 0;
+    memo->tables = calloc(PAGE_MEMO_MIN_CAPACITY, sizeof(page_memo_slot_t));
+    if (memo->tables == NULL)
+    {
+        free(memo->slots);
+        memo->slots = NULL;
+        M_EXIT_ERR(ERR_MEM, "allocating %zu page-table slots", (size_t)PAGE_MEMO_MIN_CAPACITY);
+    }
+    memo->tables_capacity = PAGE_MEMO_MIN_CAPACITY;
+    memo->nb_tables = 0;
+    memo->pgd = PGD_DEFAULT_ROOT;
+    memo->hits = 0;
+    memo->misses = 0;
+    return ERR_NONE;
+}
+
+int page_memo_free(page_memo_t *memo)
+{
+    M_REQUIRE_NON_NULL(memo);
+    free(memo->slots);
+    memo->slots = NULL;
+    memo->capacity = 0;
+    memo->size = 0;
+    free(memo->tables);
+    memo->tables = NULL;
+    memo->tables_capacity = 0;
+    memo->nb_tables = 0;
+    return ERR_NONE;
+}
+
+int page_memo_invalidate(page_memo_t *memo)
+{
+    M_REQUIRE_NON_NULL(memo);
+    M_REQUIRE_NON_NULL(memo->slots);
+    M_REQUIRE_NON_NULL(memo->tables);
+    memset(memo->slots, 0, memo->capacity * sizeof(page_memo_slot_t));
+    memo->size = 0;
+    memset(memo->tables, 0, memo->tables_capacity * sizeof(page_memo_slot_t));
+    memo->nb_tables = 0;
+    return ERR_NONE;
+}
+
+int page_memo_set_root(page_memo_t *memo, pte_t pgd)
+{
+    M_REQUIRE_NON_NULL(memo);
+    if (pgd == memo->pgd)
+        return ERR_NONE;
+    memo->pgd = pgd;
+    return page_memo_invalidate(memo);
+}
+
+int page_memo_translate(page_memo_t *memo, const void *mem_space,
+                        const virt_addr_t *vaddr, phy_addr_t *paddr)
+{
+    M_REQUIRE_NON_NULL(memo);
+    M_REQUIRE_NON_NULL(memo->slots);
+    M_REQUIRE_NON_NULL(vaddr);
+    M_REQUIRE_NON_NULL(paddr);
+
+    const uint64_t key = virt_addr_t_to_virtual_page_number(vaddr) + 1;
+    page_memo_slot_t *slot = memo_find(memo->slots, memo->capacity, key);
+    if (slot->key == key)
+    {
+        ++memo->hits;
+        paddr->phy_page_num = slot->phy_page_num;
+        paddr->page_offset = vaddr->page_offset;
+        return ERR_NONE;
+    }
+
+    ++memo->misses;
+    pte_t tables[PAGE_WALK_MAX_TABLES];
+    size_t nb_tables = 0;
+    M_EXIT_IF_ERR(page_walk_traced(mem_space, memo->pgd, vaddr, paddr, NULL, tables, &nb_tables),
+                  "calling page_walk_traced() from page_memo_translate()");
+    for (size_t i = 0; i < nb_tables; ++i)
+    {
+        M_EXIT_IF_ERR(memo_add_table(memo, tables[i]), "remembering a page table");
+    }
+    slot->key = key;
+    slot->phy_page_num = paddr->phy_page_num;
+    if (++memo->size * 4 > memo->capacity * 3)
+    {
+        M_EXIT_IF_ERR(memo_grow(&memo->slots, &memo->capacity), "growing the memo table");
+    }
+    return ERR_NONE;
+}
+
+int page_memo_write(page_memo_t *memo, const phy_addr_t *paddr)
+{
+    M_REQUIRE_NON_NULL(memo);
+    M_REQUIRE_NON_NULL(memo->tables);
+    M_REQUIRE_NON_NULL(paddr);
+    const uint64_t key = (uint64_t)paddr->phy_page_num + 1;
+    if (memo->nb_tables == 0 || memo_find(memo->tables, memo->tables_capacity, key)->key != key)
+        return ERR_NONE;
+    return page_memo_invalidate(memo);
+}
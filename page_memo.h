@@ -0,0 +1,104 @@
+#pragma once
+
+/**
+ * @file page_memo.h
+ * @brief Memoization of virtual to physical page translations, for
+ * functional simulation (when the TLBs do not need to be modelled).
+ *
+ * @date 2019
+ */
+
+#include "addr.h"
+#include <stddef.h> // for size_t
+#include <stdint.h>
+
+#define PAGE_MEMO_MIN_CAPACITY 64 // must be a power of 2
+
+/**
+ * @brief one slot of the table; key is the virtual page number + 1 (0 = empty)
+ */
+typedef struct
+{
+    uint64_t key;
+    uint32_t phy_page_num;
+} page_memo_slot_t;
+
+/**
+ * @brief open-addressing (linear probing) hash map from virtual page number
+ * to physical page number. It doubles its capacity when it is 3/4 full.
+ *
+ * The physical pages of the page tables read by its walks are kept in a
+ * second such table (keyed by physical page number + 1): a write into one of
+ * them (see page_memo_write()) may change a memoized translation, so it
+ * forgets them all.
+ */
+typedef struct
+{
+    page_memo_slot_t *slots;
+    size_t capacity; // always a power of 2
+    size_t size;
+    page_memo_slot_t *tables; // page-table frames read by the walks
+    size_t tables_capacity; // always a power of 2
+    size_t nb_tables;
+    pte_t pgd; // page-table root used for the walks
+    uint64_t hits;
+    uint64_t misses;
+} page_memo_t;
+
+/**
+ * @brief "Constructor" for page_memo_t: initialize an empty memo table.
+ * @param memo (modified) the table to be initialized
+ * @param capacity the initial capacity (rounded up to a power of 2, at least PAGE_MEMO_MIN_CAPACITY)
+ * @return error code
+ */
+int page_memo_init(page_memo_t *memo, size_t capacity);
+
+/**
+ * @brief "Destructor" for page_memo_t: free its content.
+ * @param memo the table to be freed
+ * @return error code
+ */
+int page_memo_free(page_memo_t *memo);
+
+/**
+ * @brief Forget all memoized translations. To be called whenever the page
+ * tables of the memory space are modified other than by the writes given to
+ * page_memo_write() (e.g. on an INVALIDATE command).
+ * @param memo the table to be invalidated
+ * @return error code
+ */
+int page_memo_invalidate(page_memo_t *memo);
+
+/**
+ * @brief Select the page-table root to be used for the next translations
+ * (PGD_DEFAULT_ROOT after page_memo_init()); forgets all memoized
+ * translations if it changes.
+ * @param memo the memo table
+ * @param pgd physical address of the PGD
+ * @return error code
+ */
+int page_memo_set_root(page_memo_t *memo, pte_t pgd);
+
+/**
+ * @brief Translate a virtual address, using the memoized translation of its
+ * page if any, or walking the page tables (and memoizing its result) otherwise.
+ *
+ * @param memo the memo table
+ * @param mem_space starting address of the memory space
+ * @param vaddr virtual address to be converted
+ * @param paddr (modified) physical address
+ * @return error code
+ */
+int page_memo_translate(page_memo_t *memo, const void *mem_space,
+                        const virt_addr_t *vaddr, phy_addr_t *paddr);
+
+/**
+ * @brief Notify the memo of a write into memory: if it lands in a page table
+ * read by one of the memoized walks, all memoized translations are forgotten.
+ * To be called for every write to the memory space while the memo is in use.
+ *
+ * @param memo the memo table
+ * @param paddr physical address written
+ * @return error code
+ */
+int page_memo_write(page_memo_t *memo, const phy_addr_t *paddr);
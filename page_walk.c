@@ -2,22 +2,189 @@
 #include "addr.h"
 #include "addr_mng.h"
 #include "error.h"
+#include <stdlib.h> // for qsort()
 
 static inline pte_t read_page_entry(const pte_t *start, pte_t page_start, uint16_t index)
 {
   return start[(page_start >> 2) + (index)];
 }
 
+// physical address of the 4 kiB frame inside a huge page (entry) of the given size
+static inline uint32_t huge_page_frame(pte_t entry, const virt_addr_t *vaddr, page_size_t size)
+{
+  uint32_t inside = ((uint32_t)vaddr->pte_entry) << PTE_PREV_SIZE;
+  if (size == PAGE_1G)
+    inside |= ((uint32_t)vaddr->pmd_entry) << PMD_PREV_SIZE;
+  uint32_t huge_offset = size == PAGE_1G ? HUGE_1G_OFFSET : HUGE_2M_OFFSET;
+  return ((entry >> huge_offset) << huge_offset) | inside;
+}
+
 int page_walk(const void *mem_space, const virt_addr_t *vaddr, phy_addr_t *paddr)
+{
+  return page_walk_sized(mem_space, vaddr, paddr, NULL);
+}
+
+int page_walk_sized(const void *mem_space, const virt_addr_t *vaddr, phy_addr_t *paddr, page_size_t *size)
+{
+  return page_walk_from(mem_space, PGD_DEFAULT_ROOT, vaddr, paddr, size);
+}
+
+int page_walk_from(const void *mem_space, pte_t pgd, const virt_addr_t *vaddr, phy_addr_t *paddr, page_size_t *size)
+{
+  return page_walk_traced(mem_space, pgd, vaddr, paddr, size, NULL, NULL);
+}
+
+int page_walk_traced(const void *mem_space, pte_t pgd, const virt_addr_t *vaddr, phy_addr_t *paddr, page_size_t *size,
+                     pte_t tables[PAGE_WALK_MAX_TABLES], size_t *nb_tables)
 {
   M_REQUIRE_NON_NULL(mem_space);
   M_REQUIRE_NON_NULL(vaddr);
   M_REQUIRE_NON_NULL(paddr);
-  pte_t pudAddress = read_page_entry(mem_space, 0, vaddr->pgd_entry);
+  M_REQUIRE(tables == NULL || nb_tables != NULL, ERR_BAD_PARAMETER, "nb_tables must be given with tables%s", "");
+  pte_t read[PAGE_WALK_MAX_TABLES];
+  size_t nb_read = 0;
+  page_size_t found = PAGE_4K;
+  pte_t physicalAddress = 0;
+  read[nb_read++] = pgd;
+  pte_t pudAddress = read_page_entry(mem_space, pgd, vaddr->pgd_entry);
 
   // correcteur check return values
+  read[nb_read++] = pudAddress;
   pte_t pmdAddress = read_page_entry(mem_space, pudAddress, vaddr->pud_entry);
-  pte_t pteAddress = read_page_entry(mem_space, pmdAddress, vaddr->pmd_entry);
-  pte_t physicalAddress = read_page_entry(mem_space, pteAddress, vaddr->pte_entry);
+  if (pmdAddress & PTE_PAGE_SIZE_BIT)
+  {
+    found = PAGE_1G;
+    physicalAddress = huge_page_frame(pmdAddress, vaddr, found);
+  }
+  else
+  {
+    read[nb_read++] = pmdAddress;
+    pte_t pteAddress = read_page_entry(mem_space, pmdAddress, vaddr->pmd_entry);
+    if (pteAddress & PTE_PAGE_SIZE_BIT)
+    {
+      found = PAGE_2M;
+      physicalAddress = huge_page_frame(pteAddress, vaddr, found);
+    }
+    else
+    {
+      read[nb_read++] = pteAddress;
+      physicalAddress = read_page_entry(mem_space, pteAddress, vaddr->pte_entry);
+    }
+  }
+  if (size != NULL)
+    *size = found;
+  if (tables != NULL)
+  {
+    for (size_t i = 0; i < nb_read; ++i)
+      tables[i] = read[i];
+    *nb_tables = nb_read;
+  }
   return init_phy_addr(paddr, physicalAddress, vaddr->page_offset);
 }
+
+// an address of the batch, sorted by virtual page number to gather common prefixes
+typedef struct
+{
+  uint64_t page_nbr;
+  size_t index;
+} batch_item_t;
+
+static int batch_item_cmp(const void *a, const void *b)
+{
+  const batch_item_t *x = a;
+  const batch_item_t *y = b;
+  if (x->page_nbr != y->page_nbr)
+    return x->page_nbr < y->page_nbr ? -1 : 1;
+  return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+int page_walk_batch(const void *mem_space, pte_t pgd, const virt_addr_t *vaddrs, phy_addr_t *out, size_t n)
+{
+  M_REQUIRE_NON_NULL(mem_space);
+  M_REQUIRE_NON_NULL(vaddrs);
+  M_REQUIRE_NON_NULL(out);
+  if (n == 0)
+    return ERR_NONE;
+
+  batch_item_t *items = calloc(n, sizeof(batch_item_t));
+  M_EXIT_IF_NULL(items, n * sizeof(batch_item_t));
+  for (size_t i = 0; i < n; ++i)
+  {
+    items[i].page_nbr = virt_addr_t_to_virtual_page_number(&vaddrs[i]);
+    items[i].index = i;
+  }
+  qsort(items, n, sizeof(batch_item_t), batch_item_cmp);
+
+  const pte_t *memory = mem_space;
+  uint64_t last_pgd = UINT64_MAX; // PGD prefix whose PUD table is in pudAddress
+  uint64_t last_pud = UINT64_MAX; // PGD+PUD prefix whose entry is in pmdAddress
+  pte_t pudAddress = 0;
+  pte_t pmdAddress = 0;
+  int err = ERR_NONE;
+  size_t start = 0;
+  while (start < n && err == ERR_NONE)
+  {
+    // the group shares the PGD, PUD and PMD entries of its first address
+    const uint64_t prefix = items[start].page_nbr >> PTE_ENTRY;
+    size_t end = start + 1;
+    while (end < n && (items[end].page_nbr >> PTE_ENTRY) == prefix)
+      ++end;
+
+    const virt_addr_t *first = &vaddrs[items[start].index];
+    if ((prefix >> (PMD_ENTRY + PUD_ENTRY)) != last_pgd)
+    {
+      last_pgd = prefix >> (PMD_ENTRY + PUD_ENTRY);
+      last_pud = UINT64_MAX;
+      pudAddress = read_page_entry(memory, pgd, first->pgd_entry);
+    }
+    if ((prefix >> PMD_ENTRY) != last_pud)
+    {
+      last_pud = prefix >> PMD_ENTRY;
+      pmdAddress = read_page_entry(memory, pudAddress, first->pud_entry);
+    }
+
+    page_size_t size = PAGE_4K;
+    pte_t huge_entry = pmdAddress;
+    pte_t pteAddress = 0;
+    if (pmdAddress & PTE_PAGE_SIZE_BIT)
+      size = PAGE_1G;
+    else
+    {
+      pteAddress = read_page_entry(memory, pmdAddress, first->pmd_entry);
+      if (pteAddress & PTE_PAGE_SIZE_BIT)
+      {
+        size = PAGE_2M;
+        huge_entry = pteAddress;
+      }
+    }
+
+    if (size == PAGE_4K)
+    {
+      // leaf reads of the whole group, all from the same page table
+      const pte_t *pte_table = memory + (pteAddress >> 2);
+      for (size_t k = start; k < end && err == ERR_NONE; ++k)
+      {
+        const virt_addr_t *vaddr = &vaddrs[items[k].index];
+        if (k > start && items[k].page_nbr == items[k - 1].page_nbr)
+        {
+          // same page as the previous address: reuse its translation
+          out[items[k].index].phy_page_num = out[items[k - 1].index].phy_page_num;
+          out[items[k].index].page_offset = vaddr->page_offset;
+        }
+        else
+          err = init_phy_addr(&out[items[k].index], pte_table[vaddr->pte_entry], vaddr->page_offset);
+      }
+    }
+    else
+    {
+      for (size_t k = start; k < end && err == ERR_NONE; ++k)
+      {
+        const virt_addr_t *vaddr = &vaddrs[items[k].index];
+        err = init_phy_addr(&out[items[k].index], huge_page_frame(huge_entry, vaddr, size), vaddr->page_offset);
+      }
+    }
+    start = end;
+  }
+  free(items);
+  return err;
+}
@@ -8,6 +8,7 @@
  */
 
 #include "addr.h"
+#include <stddef.h> // for size_t
 
 /**
  * @brief Page walker: virtual address to physical address conversion.
@@ -18,3 +19,64 @@
  * @return error code
  */
 int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr);
+
+/**
+ * @brief Page walker also reporting the size of the page that maps vaddr.
+ * The walk stops at the PUD (1 GiB) or PMD (2 MiB) level when the entry
+ * found there has PTE_PAGE_SIZE_BIT set.
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param size (SET) size of the mapping page, may be NULL
+ * @return error code
+ */
+int page_walk_sized(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* size);
+
+/**
+ * @brief Page walker starting from the PGD at the given physical address
+ * (e.g. the page-table root of an ASID), also reporting the page size.
+ * page_walk_sized() walks from PGD_DEFAULT_ROOT.
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param pgd physical address of the PGD to start from
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param size (SET) size of the mapping page, may be NULL
+ * @return error code
+ */
+int page_walk_from(const void* mem_space, pte_t pgd, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* size);
+
+#define PAGE_WALK_MAX_TABLES 4 // PGD, PUD, PMD and PTE
+
+/**
+ * @brief Same as page_walk_from(), also reporting the physical addresses of
+ * the page tables read by the walk (from the PGD down to the level where it
+ * stopped), e.g. to detect writes that may change the translation.
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param pgd physical address of the PGD to start from
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param size (SET) size of the mapping page, may be NULL
+ * @param tables (SET) physical addresses of the tables read, may be NULL
+ * @param nb_tables (SET) number of tables read (2 to PAGE_WALK_MAX_TABLES), required with tables
+ * @return error code
+ */
+int page_walk_traced(const void* mem_space, pte_t pgd, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* size,
+                     pte_t tables[PAGE_WALK_MAX_TABLES], size_t* nb_tables);
+
+/**
+ * @brief Translates n virtual addresses at once.
+ * Addresses are grouped by their PGD/PUD/PMD prefix so that each upper-level
+ * entry is read once per group; leaf (PTE) entries of a group are then read
+ * from the same page table in one tight loop. Huge pages are supported.
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param pgd physical address of the PGD to start from (e.g. PGD_DEFAULT_ROOT)
+ * @param vaddrs the n virtual addresses to be converted
+ * @param out (SET) the n corresponding physical addresses (out[i] for vaddrs[i])
+ * @param n number of addresses
+ * @return error code
+ */
+int page_walk_batch(const void* mem_space, pte_t pgd, const virt_addr_t* vaddrs, phy_addr_t* out, size_t n);
@@ -0,0 +1,188 @@
+/**
+ * @file pipeline.c
+ * @brief pipelined simulation of a trace
+ *
+ * @date 2019
+ */
+
+#include "pipeline.h"
+#include "spsc_ring.h"
+#include "error.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NO_ACCESS (-1) // served_by of a context switch or an invalidation
+
+typedef struct
+{
+    command_t commands[PIPELINE_BATCH_SIZE];
+    phy_addr_t paddrs[PIPELINE_BATCH_SIZE];
+    int served_by[PIPELINE_BATCH_SIZE];
+    size_t nb_commands;
+    int last; // no batch follows
+} batch_t;
+
+typedef enum
+{
+    STEP_DECODE,
+    STEP_TRANSLATE,
+    STEP_SIMULATE,
+    STEP_ACCOUNT,
+    NB_STEPS
+} step_t;
+
+typedef struct
+{
+    sim_ctx_t *ctx;
+    void *mem_space;
+    FILE *input;
+    spsc_ring_t rings[NB_STEPS]; // rings[s]: batches waiting for step s
+    atomic_int error;            // first error of any step
+} pipeline_t;
+
+static void fail(pipeline_t *p, int err)
+{
+    int none = ERR_NONE;
+    atomic_compare_exchange_strong(&p->error, &none, err);
+}
+
+// once a step failed, the next batches only flow through, up to the last one
+static int failed(pipeline_t *p)
+{
+    return atomic_load(&p->error) != ERR_NONE;
+}
+
+static void decode(pipeline_t *p, batch_t *batch)
+{
+    batch->nb_commands = 0;
+    batch->last = 0;
+    while (batch->nb_commands < PIPELINE_BATCH_SIZE && !failed(p))
+    {
+        const int err = command_read(p->input, &batch->commands[batch->nb_commands]);
+        if (err != ERR_NONE)
+        {
+            if (err != ERR_EOF)
+                fail(p, err);
+            break;
+        }
+        batch->nb_commands++;
+    }
+    batch->last = batch->nb_commands < PIPELINE_BATCH_SIZE;
+}
+
+static void translate(pipeline_t *p, batch_t *batch)
+{
+    for (size_t i = 0; i < batch->nb_commands && !failed(p); ++i)
+    {
+        const int err = sim_ctx_translate(p->ctx, p->mem_space, &batch->commands[i], &batch->paddrs[i]);
+        if (err != ERR_NONE)
+            fail(p, err);
+    }
+}
+
+static void simulate(pipeline_t *p, batch_t *batch)
+{
+    for (size_t i = 0; i < batch->nb_commands && !failed(p); ++i)
+    {
+        const command_t *command = &batch->commands[i];
+        batch->served_by[i] = NO_ACCESS;
+        if (command->order == READ || command->order == WRITE)
+        {
+            const int err = sim_ctx_access(p->ctx, p->mem_space, command, &batch->paddrs[i], &batch->served_by[i]);
+            if (err != ERR_NONE)
+                fail(p, err);
+        }
+    }
+}
+
+static void account(pipeline_t *p, batch_t *batch)
+{
+    for (size_t i = 0; i < batch->nb_commands && !failed(p); ++i)
+    {
+        if (batch->served_by[i] != NO_ACCESS)
+            sim_ctx_account(p->ctx, batch->served_by[i]);
+    }
+}
+
+static void (*const steps[NB_STEPS])(pipeline_t *, batch_t *) = { decode, translate, simulate, account };
+
+// runs the steps from first to the last one on each batch, until the last batch
+static void run_steps(pipeline_t *p, step_t first, step_t end)
+{
+    int last = 0;
+    while (!last)
+    {
+        batch_t *batch = spsc_ring_pop(&p->rings[first]);
+        for (step_t s = first; s < end; ++s)
+            steps[s](p, batch);
+        last = batch->last;
+        spsc_ring_push(&p->rings[end % NB_STEPS], batch);
+    }
+}
+
+typedef struct
+{
+    pipeline_t *p;
+    step_t step;
+} step_arg_t;
+
+static void *step_thread(void *arg)
+{
+    const step_arg_t *a = arg;
+    run_steps(a->p, a->step, a->step + 1);
+    return NULL;
+}
+
+int pipeline_run(sim_ctx_t *ctx, void *mem_space, const char *filename)
+{
+    M_REQUIRE_NON_NULL(ctx);
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(filename);
+
+    pipeline_t p;
+    p.ctx = ctx;
+    p.mem_space = mem_space;
+    atomic_init(&p.error, ERR_NONE);
+    p.input = fopen(filename, "r");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(p.input, ERR_IO);
+    batch_t *batches = calloc(PIPELINE_BATCHES, sizeof(batch_t));
+    int err = batches == NULL ? ERR_MEM : ERR_NONE;
+    step_t nb_rings = STEP_DECODE;
+    for (; nb_rings < NB_STEPS && err == ERR_NONE; ++nb_rings)
+        err = spsc_ring_init(&p.rings[nb_rings], PIPELINE_BATCHES);
+    if (err != ERR_NONE)
+    {
+        for (step_t s = STEP_DECODE; s < nb_rings; ++s)
+            spsc_ring_free(&p.rings[s]);
+        free(batches);
+        fclose(p.input);
+        return err;
+    }
+    for (size_t b = 0; b < PIPELINE_BATCHES; ++b)
+        spsc_ring_push(&p.rings[STEP_DECODE], &batches[b]);
+
+    // one thread per step but the last, up to the first which cannot be started
+    pthread_t threads[STEP_ACCOUNT];
+    step_arg_t args[STEP_ACCOUNT];
+    step_t started = STEP_DECODE;
+    for (; started < STEP_ACCOUNT; ++started)
+    {
+        args[started] = (step_arg_t){ &p, started };
+        if (pthread_create(&threads[started], NULL, step_thread, &args[started]) != 0)
+            break;
+    }
+    run_steps(&p, started, NB_STEPS);
+    for (step_t s = STEP_DECODE; s < started; ++s)
+        pthread_join(threads[s], NULL);
+
+    for (step_t s = STEP_DECODE; s < NB_STEPS; ++s)
+        spsc_ring_free(&p.rings[s]);
+    free(batches);
+    if (ferror(p.input))
+        fail(&p, ERR_IO);
+    fclose(p.input);
+    return atomic_load(&p.error);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+/**
+ * @file pipeline.h
+ * @brief pipelined simulation of a trace: each step of sim_ctx_execute()
+ * runs on its own thread, batches of commands flowing from one to the next
+ * through lock-free single-producer single-consumer rings:
+ *   decode (reading the trace) -> translate (TLBs) -> simulate (caches)
+ *   -> account (statistics, in the calling thread) -> back to decode.
+ * Each step only touches its own part of the simulator, and sees the
+ * commands in trace order: the results are those of sim_ctx_run(), as long
+ * as the trace does not write the page tables (which the translate step may
+ * then read before or after the write).
+ *
+ * @date 2019
+ */
+
+#include "sim.h"
+
+#define PIPELINE_BATCH_SIZE 256 // commands per batch
+#define PIPELINE_BATCHES 8      // batches in flight, a power of 2
+
+//=========================================================================
+/**
+ * @brief Simulate a trace file with a pipeline of threads. If a thread
+ * cannot be started, the calling thread runs its step (and the following
+ * ones) itself.
+ *
+ * @param ctx the simulator
+ * @param mem_space the memory
+ * @param filename the trace (see program_read())
+ * @return error code
+ */
+int pipeline_run(sim_ctx_t *ctx, void *mem_space, const char *filename);
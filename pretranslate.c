@@ -0,0 +1,97 @@
+/**
+ * @file pretranslate.c
+ * @brief tool translating a whole command file once, producing a physical
+ * trace which the cache simulator can replay without any page walk.
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32 || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "error.h"
+#include "memory.h"
+#include "commands.h"
+#include "translate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// ======================================================================
+static void error(const char *pgm, const char *msg)
+{
+    assert(msg != NULL);
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename output_filename [nb_threads]\n", pgm);
+    fprintf(stderr, "examples: %s dump memory_dump.bin commands01.txt commands01-phys.txt\n", pgm);
+    fprintf(stderr, "          %s desc memory_description.txt commands01.txt commands01-phys.txt 4\n", pgm);
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        error(argv[0], "please provide memory format and filename, command filename and output filename:");
+        return 1;
+    }
+    int dump = 1;
+    if (strcmp(argv[1], "dump"))
+    {
+        if (strcmp(argv[1], "desc"))
+        {
+            error(argv[0], "unknown command.");
+            return 1;
+        }
+        dump = 0;
+    }
+    size_t nb_threads = 1;
+    if (argc > 5 && sscanf(argv[5], "%zu", &nb_threads) != 1)
+    {
+        error(argv[0], "wrong number of threads.");
+        return 1;
+    }
+
+    void *mem_space = NULL;
+    size_t mem_size = 0;
+    int err = dump ? mem_init_from_dumpfile(argv[2], &mem_space, &mem_size)
+                   : mem_init_from_description(argv[2], &mem_space, &mem_size);
+    if (err != ERR_NONE)
+    {
+        error(argv[0], "problem initializing memory from provided file.");
+        return 3;
+    }
+
+    program_t pgm;
+    if (program_read(argv[3], &pgm) != ERR_NONE)
+    {
+        free(mem_space);
+        error(argv[0], "problem initializing program from provided file.");
+        return 3;
+    }
+
+    err = program_translate(mem_space, &pgm, nb_threads);
+    if (err == ERR_NONE)
+    {
+        FILE *output = fopen(argv[4], "w");
+        if (output == NULL)
+        {
+            err = ERR_IO;
+        }
+        else
+        {
+            err = program_print(output, &pgm);
+            fclose(output);
+        }
+    }
+    if (err != ERR_NONE)
+        fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+
+    (void)program_free(&pgm);
+    free(mem_space);
+    return err == ERR_NONE ? 0 : 4;
+}
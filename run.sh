@@ -2,6 +2,8 @@ chmod 777 tests/05.basic.sh
 chmod 777 tests/06.basic.sh
 chmod 777 tests/08.basic.sh
 chmod 777 tests/09.basic.sh
+chmod 777 tests/12.basic.sh
+chmod 777 tests/13.basic.sh
 
 #Lancement du premier test
 echo "Debut de 05 basic"
@@ -22,4 +24,10 @@ tests/09.basic.sh
 echo "Debut de 11 basic"
 tests/11.basic.sh
 
+echo "Debut de 12 basic"
+tests/12.basic.sh
+
+echo "Debut de 13 basic"
+tests/13.basic.sh
+
 echo "Done"
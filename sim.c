@@ -0,0 +1,506 @@
+/**
+ * @file sim.c
+ * @brief simulator context
+ *
+ * @date 2019
+ */
+
+#include "sim.h"
+#include "tlb_hrchy_mng.h"
+#include "addr_mng.h"
+#include "page_walk.h"
+#include "error.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_FIELD_MAX 64 // longest KEY=VALUE field
+#define SIM_Z 1.96        // of a confidence of 95%
+
+// parses "T:L1:L2:MEMORY[:COHERENCE]"
+static int latency_parse(const char *spec, cache_latency_t *latency)
+{
+    uint32_t values[5] = { 0, 0, 0, 0, latency->coherence };
+    size_t nb = 0;
+    const char *p = spec;
+    while (nb < 5)
+    {
+        char *end = NULL;
+        const unsigned long value = strtoul(p, &end, 10);
+        M_REQUIRE(end != p && value <= UINT32_MAX, ERR_BAD_PARAMETER, "bad latencies \"%s\"", spec);
+        values[nb++] = (uint32_t)value;
+        if (*end == '\0')
+            break;
+        M_REQUIRE(*end == ':', ERR_BAD_PARAMETER, "bad latencies \"%s\"", spec);
+        p = end + 1;
+    }
+    M_REQUIRE(nb >= 4, ERR_BAD_PARAMETER, "bad latencies \"%s\"", spec);
+    *latency = (cache_latency_t){ values[0], values[1], values[2], values[3], values[4] };
+    return ERR_NONE;
+}
+
+static int field_parse(const char *key, const char *value, sim_config_t *config)
+{
+    tlb_hrchy_config_t *tlb = &config->tlb;
+    if (!strcmp(key, "l1tlb"))
+    {
+        M_EXIT_IF_ERR(tlb_level_config_parse(value, &tlb->level[L1_ITLB]), "parsing the L1 TLBs");
+        tlb->level[L1_DTLB] = tlb->level[L1_ITLB];
+    }
+    else if (!strcmp(key, "itlb"))
+        return tlb_level_config_parse(value, &tlb->level[L1_ITLB]);
+    else if (!strcmp(key, "dtlb"))
+        return tlb_level_config_parse(value, &tlb->level[L1_DTLB]);
+    else if (!strcmp(key, "l2tlb"))
+        return tlb_level_config_parse(value, &tlb->level[L2_TLB]);
+    else if (!strcmp(key, "prefetch"))
+        return tlb_prefetch_config_parse(value, &tlb->prefetch);
+    else if (!strcmp(key, "latency"))
+        return latency_parse(value, &config->latency);
+    else if (!strcmp(key, "l2sample"))
+    {
+        char *end = NULL;
+        const unsigned long one_in = strtoul(value, &end, 10);
+        M_REQUIRE(end != value && *end == '\0' && one_in <= UINT16_MAX, ERR_BAD_PARAMETER, "bad L2 sampling \"%s\"", value);
+        config->l2_sampling.one_in = (uint16_t)one_in;
+    }
+    else if (!strcmp(key, "asid") && (!strcmp(value, "tagged") || !strcmp(value, "flush")))
+        tlb->asid_mode = !strcmp(value, "flush") ? TLB_ASID_FLUSH : TLB_ASID_TAGGED;
+    else if (!strcmp(key, "inclusion") && !strcmp(value, "incl"))
+        tlb->inclusion = TLB_INCLUSIVE;
+    else if (!strcmp(key, "inclusion") && !strcmp(value, "excl"))
+        tlb->inclusion = TLB_EXCLUSIVE;
+    else if (!strcmp(key, "inclusion") && !strcmp(value, "nine"))
+        tlb->inclusion = TLB_NINE;
+    else if (!strcmp(key, "indexing") && (!strcmp(value, "pipt") || !strcmp(value, "vipt")))
+        config->indexing = !strcmp(value, "vipt") ? CACHE_VIPT : CACHE_PIPT;
+    else
+        M_EXIT(ERR_BAD_PARAMETER, "bad configuration field \"%s=%s\"", key, value);
+    return ERR_NONE;
+}
+
+int sim_config_parse(const char *spec, sim_config_t *config)
+{
+    M_REQUIRE_NON_NULL(spec);
+    M_REQUIRE_NON_NULL(config);
+    static const char *const blanks = " \t\r\n";
+    const char *p = spec + strspn(spec, blanks);
+    while (*p != '\0')
+    {
+        const size_t length = strcspn(p, blanks);
+        M_REQUIRE(length < SIM_FIELD_MAX, ERR_BAD_PARAMETER, "configuration field too long in \"%s\"", spec);
+        char field[SIM_FIELD_MAX];
+        memcpy(field, p, length);
+        field[length] = '\0';
+        char *value = strchr(field, '=');
+        M_REQUIRE(value != NULL, ERR_BAD_PARAMETER, "no value for configuration field \"%s\"", field);
+        *value++ = '\0';
+        M_EXIT_IF_ERR(field_parse(field, value, config), "parsing a configuration");
+        p += length;
+        p += strspn(p, blanks);
+    }
+    return ERR_NONE;
+}
+
+int sim_ctx_init(sim_ctx_t *ctx, const sim_config_t *config)
+{
+    M_REQUIRE_NON_NULL(ctx);
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE(config->indexing < NB_CACHE_INDEXINGS, ERR_BAD_PARAMETER, "unknown indexing %d", config->indexing);
+    M_REQUIRE(config->indexing != CACHE_VIPT
+              || (cache_vipt_check(L1_ICACHE) == ERR_NONE && cache_vipt_check(L1_DCACHE) == ERR_NONE),
+              ERR_SIZE, "%s", "the L1 caches cannot be virtually indexed");
+    const uint16_t one_in = config->l2_sampling.one_in;
+    M_REQUIRE(one_in >= 1 && one_in <= L2_CACHE_LINES / 2 && (one_in & (one_in - 1)) == 0, ERR_BAD_PARAMETER,
+              "L2 sampling 1 in %u must be a power of 2 up to %d", one_in, L2_CACHE_LINES / 2);
+
+    memset(ctx, 0, sizeof(sim_ctx_t));
+    ctx->config = *config;
+    M_EXIT_IF_ERR(tlb_hrchy_init(&ctx->tlb, &config->tlb), "initializing the TLBs");
+    (void)cache_flush(ctx->l1_icache, L1_ICACHE);
+    (void)cache_flush(ctx->l1_dcache, L1_DCACHE);
+    (void)cache_flush(ctx->l2_cache, L2_CACHE);
+    return ERR_NONE;
+}
+
+void sim_ctx_free(sim_ctx_t *ctx)
+{
+    if (ctx != NULL)
+        tlb_hrchy_free(&ctx->tlb);
+}
+
+int sim_ctx_create(const sim_config_t *config, sim_ctx_t **ctx)
+{
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE_NON_NULL(ctx);
+    // aligned_alloc() wants a multiple of the alignment, which sizeof already is
+    *ctx = aligned_alloc(SIM_CACHE_LINE, sizeof(sim_ctx_t));
+    M_EXIT_IF_NULL(*ctx, sizeof(sim_ctx_t));
+    const int err = sim_ctx_init(*ctx, config);
+    if (err != ERR_NONE)
+    {
+        free(*ctx);
+        *ctx = NULL;
+    }
+    return err;
+}
+
+void sim_ctx_destroy(sim_ctx_t *ctx)
+{
+    sim_ctx_free(ctx);
+    free(ctx);
+}
+
+// invalidates the translations of the current address space
+static int invalidate(tlb_hrchy_t *tlb, const command_t *command)
+{
+    const uint16_t asid = tlb->space.asid;
+    switch (command->scope)
+    {
+    case INVAL_PAGE:
+        return tlb_invalidate_page(tlb, asid, &command->vaddr);
+    case INVAL_RANGE:
+        return tlb_invalidate_range(tlb, asid, virt_addr_t_to_uint64_t(&command->vaddr), command->vaddr_end);
+    case INVAL_ASID:
+        return tlb_invalidate_asid(tlb, asid);
+    default:
+        return tlb_invalidate_all(tlb);
+    }
+}
+
+int sim_ctx_translate(sim_ctx_t *ctx, const void *mem_space, const command_t *command, phy_addr_t *paddr)
+{
+    M_REQUIRE_NON_NULL(ctx);
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(command);
+    M_REQUIRE_NON_NULL(paddr);
+
+    if (command->order == SWITCH)
+    {
+        const addr_space_t space = { command->asid, command->pgd };
+        return tlb_hrchy_switch(&ctx->tlb, &space);
+    }
+    if (command->order == INVALIDATE)
+        return invalidate(&ctx->tlb, command);
+
+    int hit = 0;
+    const mem_access_t access = command->type == INSTRUCTION && command->order == READ ? INSTRUCTION : DATA;
+    return tlb_hrchy_search(mem_space, &command->vaddr, paddr, access, &ctx->tlb, &hit);
+}
+
+int sim_ctx_access(sim_ctx_t *ctx, void *mem_space, const command_t *command, phy_addr_t *paddr, int *served_by)
+{
+    M_REQUIRE_NON_NULL(ctx);
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(command);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(served_by);
+
+    cache_stats_t stats;
+    memset(&stats, 0, sizeof(cache_stats_t));
+    const mem_access_t access = command->type == INSTRUCTION && command->order == READ ? INSTRUCTION : DATA;
+    void *l1_cache = access == INSTRUCTION ? (void *)ctx->l1_icache : (void *)ctx->l1_dcache;
+    const cache_sampling_t *sampling = &ctx->config.l2_sampling;
+    uint32_t word = 0;
+    uint8_t byte = 0;
+    switch (command->order)
+    {
+    case READ:
+        if (command->data_size == sizeof(word_t))
+            M_EXIT_IF_ERR(cache_read_sampled(mem_space, paddr, access, l1_cache, ctx->l2_cache, &word, LRU, sampling, &stats), "reading");
+        else
+            M_EXIT_IF_ERR(cache_read_byte_sampled(mem_space, paddr, access, l1_cache, ctx->l2_cache, &byte, LRU, sampling, &stats), "reading");
+        break;
+    case WRITE:
+        if (command->data_size == sizeof(word_t))
+            M_EXIT_IF_ERR(cache_write_sampled(mem_space, paddr, ctx->l1_dcache, ctx->l2_cache, &command->write_data, LRU, sampling, &stats), "writing");
+        else
+            M_EXIT_IF_ERR(cache_write_byte_sampled(mem_space, paddr, ctx->l1_dcache, ctx->l2_cache, (uint8_t)command->write_data, LRU, sampling, &stats), "writing");
+        break;
+    default:
+        M_EXIT_ERR(ERR_BAD_PARAMETER, "unknown order %d", command->order);
+    }
+    const cache_stats_t none = { { 0 }, 0, 0 };
+    *served_by = cache_served_by(&none, &stats);
+    if (*served_by == L2_CACHE || *served_by == NB_CACHE_TYPES)
+    {
+        uint16_t set = 0;
+        M_EXIT_IF_ERR(cache_set_index(paddr, L2_CACHE, &set), "computing the L2 set");
+        ctx->l2_lookups[set]++;
+        ctx->l2_hits[set] += *served_by == L2_CACHE;
+    }
+    return ERR_NONE;
+}
+
+void sim_ctx_account(sim_ctx_t *ctx, int served_by)
+{
+    if (served_by >= L1_ICACHE && served_by < NB_CACHE_TYPES)
+        ctx->stats.hits[served_by]++;
+    else if (served_by == CACHE_UNSAMPLED)
+        ctx->stats.unsampled++;
+    else
+        ctx->stats.misses++;
+    ctx->accesses++;
+    ctx->cycles += cache_access_latency(&ctx->config.latency, ctx->config.indexing, served_by);
+}
+
+int sim_ctx_execute(sim_ctx_t *ctx, void *mem_space, const command_t *command)
+{
+    phy_addr_t paddr;
+    M_EXIT_IF_ERR(sim_ctx_translate(ctx, mem_space, command, &paddr), "translating");
+    if (command->order != READ && command->order != WRITE)
+        return ERR_NONE;
+    int served_by = NB_CACHE_TYPES;
+    M_EXIT_IF_ERR(sim_ctx_access(ctx, mem_space, command, &paddr, &served_by), "accessing");
+    sim_ctx_account(ctx, served_by);
+    return ERR_NONE;
+}
+
+int sim_ctx_run(sim_ctx_t *ctx, void *mem_space, const program_t *program)
+{
+    M_REQUIRE_NON_NULL(program);
+    for_all_lines(line, program)
+    {
+        M_EXIT_IF_ERR(sim_ctx_execute(ctx, mem_space, line), "executing a command");
+    }
+    return ERR_NONE;
+}
+
+int sim_replay(void *mem_space, const program_t *program, size_t begin, size_t end, addr_space_t *space)
+{
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE_NON_NULL(space);
+    M_REQUIRE(begin <= end && end <= program->nb_lines, ERR_BAD_PARAMETER, "%s", "commands out of the program");
+    for (size_t i = begin; i < end; ++i)
+    {
+        const command_t *line = &program->listing[i];
+        if (line->order == SWITCH)
+            *space = (addr_space_t){ line->asid, line->pgd };
+        else if (line->order == WRITE && mem_space != NULL)
+        {
+            phy_addr_t paddr;
+            M_EXIT_IF_ERR(page_walk_from(mem_space, space->pgd, &line->vaddr, &paddr, NULL), "walking the page tables");
+            const uint32_t addr = ((uint32_t)paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset;
+            word_t *word = (word_t *)mem_space + (addr >> 2);
+            if (line->data_size == sizeof(word_t))
+                *word = line->write_data;
+            else
+            {
+                const unsigned shift = 8 * (addr % sizeof(word_t));
+                *word = (*word & ~((word_t)0xFF << shift)) | ((word_t)(uint8_t)line->write_data << shift);
+            }
+        }
+    }
+    return ERR_NONE;
+}
+
+void sim_ctx_get_raw_stats(const sim_ctx_t *ctx, sim_stats_t *stats)
+{
+    stats->cache = ctx->stats;
+    stats->accesses = ctx->accesses;
+    stats->walks = ctx->tlb.stats.walks;
+    stats->cycles = ctx->cycles;
+}
+
+void sim_stats_extrapolate(sim_stats_t *stats, const sim_stats_t *from, uint32_t memory_latency)
+{
+    const uint64_t unsampled = stats->cache.unsampled;
+    const uint64_t sampled = from->cache.hits[L2_CACHE] + from->cache.misses;
+    if (unsampled == 0)
+        return;
+    // only the L2 latency of the L1 misses to unsampled sets was accounted
+    const uint64_t hits = sampled == 0 ? 0 : (uint64_t)llround((double)unsampled * (double)from->cache.hits[L2_CACHE] / (double)sampled);
+    stats->cache.hits[L2_CACHE] += hits;
+    stats->cache.misses += unsampled - hits;
+    stats->cache.unsampled = 0;
+    stats->cycles += (unsampled - hits) * memory_latency;
+}
+
+void sim_ctx_get_stats(const sim_ctx_t *ctx, sim_stats_t *stats)
+{
+    sim_ctx_get_raw_stats(ctx, stats);
+    sim_stats_extrapolate(stats, stats, ctx->config.latency.memory);
+}
+
+void sim_ctx_l2_hit_rate(const sim_ctx_t *ctx, double *rate, double *error)
+{
+    // ratio estimator over the sets sampled, with finite population correction
+    double n = 0, lookups = 0, hits = 0;
+    for (uint16_t set = 0; set < L2_CACHE_LINES; ++set)
+    {
+        if (cache_l2_set_sampled(&ctx->config.l2_sampling, set))
+        {
+            n += 1;
+            lookups += (double)ctx->l2_lookups[set];
+            hits += (double)ctx->l2_hits[set];
+        }
+    }
+    *rate = lookups > 0 ? hits / lookups : 0.0;
+    *error = 0.0;
+    if (lookups <= 0 || n >= L2_CACHE_LINES)
+        return;
+    double residuals = 0;
+    for (uint16_t set = 0; set < L2_CACHE_LINES; ++set)
+    {
+        if (cache_l2_set_sampled(&ctx->config.l2_sampling, set))
+        {
+            const double r = (double)ctx->l2_hits[set] - *rate * (double)ctx->l2_lookups[set];
+            residuals += r * r;
+        }
+    }
+    const double variance = (1 - n / L2_CACHE_LINES) * residuals / (n - 1) / n;
+    *error = SIM_Z * sqrt(variance) / (lookups / n);
+}
+
+void sim_ctx_reset_stats(sim_ctx_t *ctx)
+{
+    memset(&ctx->stats, 0, sizeof(cache_stats_t));
+    memset(ctx->l2_lookups, 0, sizeof(ctx->l2_lookups));
+    memset(ctx->l2_hits, 0, sizeof(ctx->l2_hits));
+    memset(&ctx->tlb.stats, 0, sizeof(tlb_hrchy_stats_t));
+    ctx->accesses = 0;
+    ctx->cycles = 0;
+}
+
+void sim_stats_add(sim_stats_t *total, const sim_stats_t *stats)
+{
+    for (int c = L1_ICACHE; c < NB_CACHE_TYPES; ++c)
+        total->cache.hits[c] += stats->cache.hits[c];
+    total->cache.misses += stats->cache.misses;
+    total->cache.unsampled += stats->cache.unsampled;
+    total->accesses += stats->accesses;
+    total->walks += stats->walks;
+    total->cycles += stats->cycles;
+}
+
+int sim_stats_print(FILE *output, const sim_stats_t *stats)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(stats);
+    fprintf(output, "ACCESSES: %" PRIu64 "; L1I HITS: %" PRIu64 "; L1D HITS: %" PRIu64 "; L2 HITS: %" PRIu64
+            "; MISSES: %" PRIu64 "; TLB WALKS: %" PRIu64 "; CYCLES: %" PRIu64 "\n",
+            stats->accesses, stats->cache.hits[L1_ICACHE], stats->cache.hits[L1_DCACHE], stats->cache.hits[L2_CACHE],
+            stats->cache.misses, stats->walks, stats->cycles);
+    return ferror(output) ? ERR_IO : ERR_NONE;
+}
+
+int sim_ctx_print_stats(FILE *output, const sim_ctx_t *ctx)
+{
+    M_REQUIRE_NON_NULL(ctx);
+    sim_stats_t stats;
+    sim_ctx_get_stats(ctx, &stats);
+    M_EXIT_IF_ERR(sim_stats_print(output, &stats), "printing the statistics");
+    if (ctx->config.l2_sampling.one_in <= 1)
+        return ERR_NONE;
+    double rate = 0, error = 0;
+    sim_ctx_l2_hit_rate(ctx, &rate, &error);
+    const uint64_t l1_misses = stats.cache.hits[L2_CACHE] + stats.cache.misses;
+    fprintf(output, "L2 SAMPLING: %d OF %d SETS; L1 MISSES: %" PRIu64 " (%" PRIu64 " SIMULATED); L2 HIT RATE: %.2f%% +- %.2f%%\n",
+            L2_CACHE_LINES / ctx->config.l2_sampling.one_in, L2_CACHE_LINES, l1_misses,
+            l1_misses - ctx->stats.unsampled, 100 * rate, 100 * error);
+    return ferror(output) ? ERR_IO : ERR_NONE;
+}
+
+int sim_ctx_print_l2_sets(FILE *output, const sim_ctx_t *ctx)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(ctx);
+    for (uint16_t set = 0; set < L2_CACHE_LINES; ++set)
+    {
+        if (cache_l2_set_sampled(&ctx->config.l2_sampling, set))
+            fprintf(output, "L2 SET %d: LOOKUPS: %" PRIu64 "; HITS: %" PRIu64 "\n",
+                    set, ctx->l2_lookups[set], ctx->l2_hits[set]);
+    }
+    return ferror(output) ? ERR_IO : ERR_NONE;
+}
+
+// ======================================================================
+// parameter sweep
+
+// work shared by the threads of a sweep
+typedef struct
+{
+    const void *mem_space;
+    size_t mem_size;
+    int private_memory; // the program writes: each thread needs its own copy
+    const program_t *program;
+    const sim_config_t *configs;
+    sim_ctx_t **ctxs;
+    size_t nb_configs;
+    atomic_size_t next; // next configuration to run
+    atomic_int error;
+} sweep_t;
+
+static void *sweep_worker(void *arg)
+{
+    sweep_t *sweep = arg;
+    void *memory = NULL;
+    if (sweep->private_memory && (memory = malloc(sweep->mem_size)) == NULL)
+    {
+        atomic_store(&sweep->error, ERR_MEM);
+        return NULL;
+    }
+    for (size_t k = atomic_fetch_add(&sweep->next, 1); k < sweep->nb_configs && atomic_load(&sweep->error) == ERR_NONE;
+         k = atomic_fetch_add(&sweep->next, 1))
+    {
+        if (memory != NULL)
+            memcpy(memory, sweep->mem_space, sweep->mem_size);
+        // read-only without writes
+        void *mem_space = memory != NULL ? memory : (void *)(uintptr_t)sweep->mem_space;
+        int err = sim_ctx_create(&sweep->configs[k], &sweep->ctxs[k]);
+        if (err == ERR_NONE)
+            err = sim_ctx_run(sweep->ctxs[k], mem_space, sweep->program);
+        if (err != ERR_NONE)
+        {
+            int none = ERR_NONE;
+            atomic_compare_exchange_strong(&sweep->error, &none, err);
+        }
+    }
+    free(memory);
+    return NULL;
+}
+
+int sim_sweep(const void *mem_space, size_t mem_size, const program_t *program,
+              const sim_config_t *configs, sim_ctx_t **ctxs, size_t nb_configs, size_t nb_threads)
+{
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE(nb_configs == 0 || (configs != NULL && ctxs != NULL), ERR_BAD_PARAMETER, "%s", "no configurations");
+    M_REQUIRE(nb_threads > 0 && nb_threads <= SIM_SWEEP_MAX_THREADS, ERR_BAD_PARAMETER,
+              "number of threads (%zu) is not in [1, %d]", nb_threads, SIM_SWEEP_MAX_THREADS);
+    if (nb_configs == 0)
+        return ERR_NONE;
+    // ctxs must be freeable whatever happens
+    for (size_t k = 0; k < nb_configs; ++k)
+        ctxs[k] = NULL;
+
+    sweep_t sweep = { mem_space, mem_size, 0, program, configs, ctxs, nb_configs, 0, ERR_NONE };
+    for_all_lines(line, program)
+    {
+        if (line->order == WRITE)
+            sweep.private_memory = 1;
+    }
+    if (nb_threads > nb_configs)
+        nb_threads = nb_configs;
+
+    pthread_t threads[SIM_SWEEP_MAX_THREADS];
+    for (size_t t = 0; t < nb_threads; ++t)
+    {
+        if (pthread_create(&threads[t], NULL, sweep_worker, &sweep) != 0)
+        {
+            // run it in this thread instead
+            sweep_worker(&sweep);
+            threads[t] = pthread_self();
+        }
+    }
+    for (size_t t = 0; t < nb_threads; ++t)
+    {
+        if (!pthread_equal(threads[t], pthread_self()))
+            pthread_join(threads[t], NULL);
+    }
+    return atomic_load(&sweep.error);
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+/**
+ * @file sim.h
+ * @brief simulator context: a whole single-core hierarchy (TLBs and caches),
+ * its configuration and statistics, so that several simulations can run
+ * side by side (e.g. one per thread) on the same program and memory
+ *
+ * @date 2019
+ */
+
+#include "addr.h"
+#include "cache.h"
+#include "cache_mng.h"
+#include "commands.h"
+#include "tlb_hrchy.h"
+
+#include <stdio.h>  // for FILE
+#include <stdint.h>
+
+/**
+ * @brief what can be changed from one simulation to the other (the geometry
+ * of the caches is fixed, see cache.h)
+ */
+typedef struct
+{
+    tlb_hrchy_config_t tlb;
+    cache_indexing_t indexing; // of the L1 caches
+    cache_latency_t latency;
+    cache_sampling_t l2_sampling; // sets of L2 simulated (see sim_ctx_get_stats())
+} sim_config_t;
+
+#define SIM_CONFIG_DEFAULT \
+    { TLB_HRCHY_CONFIG_DEFAULT, CACHE_PIPT, CACHE_LATENCY_DEFAULT, CACHE_SAMPLING_NONE }
+
+/**
+ * @brief what a simulation costs (see sim_ctx_get_stats())
+ */
+typedef struct
+{
+    cache_stats_t cache;
+    uint64_t accesses; // reads and writes
+    uint64_t walks;    // of the TLBs
+    uint64_t cycles;
+} sim_stats_t;
+
+#define SIM_CACHE_LINE 64 // alignment of a simulator and of the parts of it each step uses
+
+/**
+ * @brief a simulator: its state is all there (nothing is shared with
+ * another context but the memory and the program it is given, and no
+ * function of the simulator keeps a state of its own), so that any number
+ * of them can run in one process. The parts used by each step of
+ * sim_ctx_execute() (see pipeline.h) start on their own cache lines.
+ */
+typedef struct
+{
+    _Alignas(SIM_CACHE_LINE) sim_config_t config;
+    // sim_ctx_translate()
+    _Alignas(SIM_CACHE_LINE) tlb_hrchy_t tlb;
+    // sim_ctx_access()
+    _Alignas(SIM_CACHE_LINE) l1_icache_entry_t l1_icache[L1_ICACHE_LINES * L1_ICACHE_WAYS];
+    _Alignas(SIM_CACHE_LINE) l1_dcache_entry_t l1_dcache[L1_DCACHE_LINES * L1_DCACHE_WAYS];
+    _Alignas(SIM_CACHE_LINE) l2_cache_entry_t l2_cache[L2_CACHE_LINES * L2_CACHE_WAYS];
+    uint64_t l2_lookups[L2_CACHE_LINES]; // L1 misses looked up in each set of L2
+    uint64_t l2_hits[L2_CACHE_LINES];
+    // sim_ctx_account()
+    _Alignas(SIM_CACHE_LINE) cache_stats_t stats;
+    uint64_t accesses; // reads and writes
+    uint64_t cycles;
+} sim_ctx_t;
+
+//=========================================================================
+/**
+ * @brief Parse a configuration: space-separated KEY=VALUE fields, each
+ * optional (the others keep their value in config):
+ *   l1tlb=SPEC, itlb=SPEC, dtlb=SPEC, l2tlb=SPEC (see tlb_level_config_parse();
+ *   l1tlb sets both L1 TLBs), asid=tagged|flush, prefetch=SPEC (see
+ *   tlb_prefetch_config_parse()), inclusion=incl|excl|nine,
+ *   indexing=pipt|vipt, latency=TRANSLATION:L1:L2:MEMORY[:COHERENCE],
+ *   l2sample=N (1 L2 set out of N simulated, see cache_sampling_t).
+ *
+ * @param spec the string to parse
+ * @param config (modified) the configuration
+ * @return error code
+ */
+int sim_config_parse(const char *spec, sim_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Allocate and initialize a simulator (see sim_ctx_init()), aligned
+ * on a cache line.
+ *
+ * @param config its configuration
+ * @param ctx (modified) the new simulator, to be freed with sim_ctx_destroy()
+ * @return error code
+ */
+int sim_ctx_create(const sim_config_t *config, sim_ctx_t **ctx);
+
+//=========================================================================
+/**
+ * @brief Free a simulator allocated by sim_ctx_create().
+ *
+ * @param ctx the simulator (may be NULL)
+ */
+void sim_ctx_destroy(sim_ctx_t *ctx);
+
+//=========================================================================
+/**
+ * @brief Initialize a simulator: empty caches and TLBs, in the default
+ * address space. A simulator is better allocated by sim_ctx_create(): a
+ * heap-allocated one must be aligned on SIM_CACHE_LINE. L2 set sampling
+ * (see cache_sampling_t) takes a power of 2 from 1 to L2_CACHE_LINES / 2,
+ * so that at least 2 sets give an error bound.
+ *
+ * @param ctx (modified) the simulator
+ * @param config its configuration
+ * @return error code
+ */
+int sim_ctx_init(sim_ctx_t *ctx, const sim_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Free the memory of a simulator.
+ *
+ * @param ctx the simulator
+ */
+void sim_ctx_free(sim_ctx_t *ctx);
+
+//=========================================================================
+/**
+ * @brief Execute a command: context switches and invalidations affect the
+ * TLBs, reads and writes are translated by the TLBs, then go through the
+ * caches (writing through to memory).
+ *
+ * @param ctx the simulator
+ * @param mem_space the memory
+ * @param command the command
+ * @return error code
+ */
+int sim_ctx_execute(sim_ctx_t *ctx, void *mem_space, const command_t *command);
+
+//=========================================================================
+/**
+ * @brief First step of sim_ctx_execute(): context switches and invalidations
+ * are done, reads and writes are translated by the TLBs.
+ *
+ * @param ctx the simulator (only its TLBs are used)
+ * @param mem_space the memory
+ * @param command the command
+ * @param paddr (modified) the translation, for reads and writes
+ * @return error code
+ */
+int sim_ctx_translate(sim_ctx_t *ctx, const void *mem_space, const command_t *command, phy_addr_t *paddr);
+
+//=========================================================================
+/**
+ * @brief Second step of sim_ctx_execute(): a read or a write goes through
+ * the caches. Nothing is accounted yet (see sim_ctx_account()).
+ *
+ * @param ctx the simulator (only its caches are used)
+ * @param mem_space the memory
+ * @param command the command (a read or a write)
+ * @param paddr its translation
+ * @param served_by (modified) the cache which hit, or NB_CACHE_TYPES for memory
+ * @return error code
+ */
+int sim_ctx_access(sim_ctx_t *ctx, void *mem_space, const command_t *command, phy_addr_t *paddr, int *served_by);
+
+//=========================================================================
+/**
+ * @brief Last step of sim_ctx_execute(): account an access in the statistics
+ * and cycles of the simulator.
+ *
+ * @param ctx the simulator
+ * @param served_by the cache which served the access, or NB_CACHE_TYPES for memory
+ */
+void sim_ctx_account(sim_ctx_t *ctx, int served_by);
+
+//=========================================================================
+/**
+ * @brief Execute all the commands of a program, in order.
+ *
+ * @param ctx the simulator
+ * @param mem_space the memory
+ * @param program the program
+ * @return error code
+ */
+int sim_ctx_run(sim_ctx_t *ctx, void *mem_space, const program_t *program);
+
+//=========================================================================
+/**
+ * @brief Replay functionally (without any simulator) some commands of a
+ * program: the address space follows the context switches and, if
+ * mem_space is not NULL, the writes are done directly in memory (through
+ * page walks). This is what the commands do to the state of the program,
+ * at a fraction of the cost of simulating them.
+ *
+ * @param mem_space the memory, or NULL to only follow the address space
+ * @param program the program
+ * @param begin the first command to replay
+ * @param end past the last command to replay
+ * @param space (modified) the address space
+ * @return error code
+ */
+int sim_replay(void *mem_space, const program_t *program, size_t begin, size_t end, addr_space_t *space);
+
+//=========================================================================
+/**
+ * @brief Get the statistics of a simulator. If only some L2 sets are
+ * simulated, those of L2 are extrapolated: the L1 misses to the other sets
+ * are shared between L2 hits and misses (costing the memory latency) as
+ * in the sets simulated.
+ *
+ * @param ctx the simulator
+ * @param stats (modified) its statistics
+ */
+void sim_ctx_get_stats(const sim_ctx_t *ctx, sim_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Get the statistics of a simulator as accounted: the L1 misses to
+ * the L2 sets not simulated are neither L2 hits nor misses, but in
+ * cache.unsampled (see sim_stats_extrapolate()).
+ *
+ * @param ctx the simulator
+ * @param stats (modified) its statistics
+ */
+void sim_ctx_get_raw_stats(const sim_ctx_t *ctx, sim_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Extrapolate the L2 statistics of raw statistics: their L1 misses
+ * to the L2 sets not simulated are shared between L2 hits and misses (which
+ * add the memory latency) as the L1 misses simulated are in from.
+ *
+ * @param stats (modified) the statistics, from sim_ctx_get_raw_stats()
+ * @param from the raw statistics giving the share (stats themselves, or
+ * those of a longer run including them)
+ * @param memory_latency the latency of a miss
+ */
+void sim_stats_extrapolate(sim_stats_t *stats, const sim_stats_t *from, uint32_t memory_latency);
+
+//=========================================================================
+/**
+ * @brief Estimate the L2 hit rate (L2 hits per L1 miss) from the sets
+ * simulated, each one a sample: the ratio of their hits to their lookups,
+ * with the half-width of its 95% confidence interval (0 if all the sets
+ * are simulated).
+ *
+ * @param ctx the simulator
+ * @param rate (modified) the L2 hit rate
+ * @param error (modified) the half-width of its confidence interval
+ */
+void sim_ctx_l2_hit_rate(const sim_ctx_t *ctx, double *rate, double *error);
+
+//=========================================================================
+/**
+ * @brief Forget what a simulator did so far (e.g. to warm it up), keeping
+ * the content of its caches and TLBs.
+ *
+ * @param ctx the simulator
+ */
+void sim_ctx_reset_stats(sim_ctx_t *ctx);
+
+//=========================================================================
+/**
+ * @brief Add statistics to others (e.g. those of several parts of a trace).
+ *
+ * @param total (modified) the sum
+ * @param stats the statistics to add
+ */
+void sim_stats_add(sim_stats_t *total, const sim_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Print statistics on a single line.
+ *
+ * @param output the stream to print to
+ * @param stats the statistics
+ * @return error code
+ */
+int sim_stats_print(FILE *output, const sim_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Print the statistics of a simulator on a single line, followed,
+ * if only some L2 sets are simulated, by a line on their sampling: the
+ * L1 misses simulated in L2 and the L2 hit rate, with its error bound.
+ *
+ * @param output the stream to print to
+ * @param ctx the simulator
+ * @return error code
+ */
+int sim_ctx_print_stats(FILE *output, const sim_ctx_t *ctx);
+
+//=========================================================================
+/**
+ * @brief Print, one line per simulated L2 set, the L1 misses looked up in
+ * that set and the L2 hits among them. A set simulated with sampling must
+ * show the same counts as without: the estimate of the L2 hit rate is then
+ * exact on the sets it is computed from.
+ *
+ * @param output the stream to print to
+ * @param ctx the simulator
+ * @return error code
+ */
+int sim_ctx_print_l2_sets(FILE *output, const sim_ctx_t *ctx);
+
+//=========================================================================
+#define SIM_SWEEP_MAX_THREADS 64
+
+/**
+ * @brief Run a program once per configuration, on several threads, each
+ * run having its own simulator. Program and memory are loaded once and
+ * shared, read-only: if the program writes, each thread works on a private
+ * copy of the memory, restored before each of its runs, so that every run
+ * starts from the same memory and does not see the writes of the others.
+ *
+ * @param mem_space the memory
+ * @param mem_size its size, in bytes
+ * @param program the program
+ * @param configs the configurations
+ * @param ctxs (modified) one simulator per configuration, each created by
+ * the thread running it, to be freed with sim_ctx_destroy() (even on error,
+ * some of them being then NULL)
+ * @param nb_configs the number of configurations
+ * @param nb_threads the number of threads, from 1 to SIM_SWEEP_MAX_THREADS
+ * @return error code
+ */
+int sim_sweep(const void *mem_space, size_t mem_size, const program_t *program,
+              const sim_config_t *configs, sim_ctx_t **ctxs, size_t nb_configs, size_t nb_threads);
@@ -0,0 +1,315 @@
+/**
+ * @file sim_batch.c
+ * @brief batch of simulations on a work-stealing pool of threads
+ *
+ * @date 2019
+ */
+
+#include "sim_batch.h"
+#include "ws_pool.h"
+#include "memory.h"
+#include "tlb_hrchy_mng.h"
+#include "error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const blanks = " \t";
+
+// copies the next blank-separated word of *p to word (of SIM_BATCH_LINE_MAX chars)
+static int next_word(const char **p, char *word)
+{
+    *p += strspn(*p, blanks);
+    const size_t length = strcspn(*p, blanks);
+    M_REQUIRE(length > 0, ERR_BAD_PARAMETER, "%s", "missing field in the manifest");
+    memcpy(word, *p, length);
+    word[length] = '\0';
+    *p += length;
+    return ERR_NONE;
+}
+
+static int job_parse(const char *line, sim_job_t *job)
+{
+    static const char *const formats[NB_SIM_MEMORY_FORMATS] = { "dump", "desc", "image" };
+    memset(job, 0, sizeof(sim_job_t));
+    strcpy(job->spec, line);
+    const char *p = line;
+    char format[SIM_BATCH_LINE_MAX];
+    M_EXIT_IF_ERR(next_word(&p, format), "reading the memory format");
+    job->format = NB_SIM_MEMORY_FORMATS;
+    for (sim_memory_format_t f = SIM_MEMORY_DUMP; f < NB_SIM_MEMORY_FORMATS; f++)
+    {
+        if (!strcmp(format, formats[f]))
+            job->format = f;
+    }
+    M_REQUIRE(job->format < NB_SIM_MEMORY_FORMATS, ERR_BAD_PARAMETER, "unknown memory format \"%s\"", format);
+    M_EXIT_IF_ERR(next_word(&p, job->memory), "reading the memory filename");
+    M_EXIT_IF_ERR(next_word(&p, job->trace), "reading the trace filename");
+    job->config = (sim_config_t)SIM_CONFIG_DEFAULT;
+    return sim_config_parse(p, &job->config);
+}
+
+int sim_batch_read(const char *filename, sim_job_t **jobs, size_t *nb_jobs)
+{
+    M_REQUIRE_NON_NULL(filename);
+    M_REQUIRE_NON_NULL(jobs);
+    M_REQUIRE_NON_NULL(nb_jobs);
+    FILE *input = fopen(filename, "r");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(input, ERR_IO);
+    *jobs = NULL;
+    *nb_jobs = 0;
+    size_t allocated = 0;
+    char line[SIM_BATCH_LINE_MAX];
+    int err = ERR_NONE;
+    while (err == ERR_NONE && fgets(line, sizeof(line), input) != NULL)
+    {
+        const size_t length = strcspn(line, "\r\n");
+        if (line[length] == '\0' && !feof(input))
+        {
+            err = ERR_BAD_PARAMETER; // line too long
+            break;
+        }
+        line[length] = '\0';
+        const char *spec = line + strspn(line, blanks);
+        if (*spec == '\0' || *spec == '#')
+            continue;
+        if (*nb_jobs == allocated)
+        {
+            allocated = allocated == 0 ? START_SIZE : 2 * allocated;
+            sim_job_t *more = realloc(*jobs, allocated * sizeof(sim_job_t));
+            if (more == NULL)
+            {
+                err = ERR_MEM;
+                break;
+            }
+            *jobs = more;
+        }
+        err = job_parse(spec, &(*jobs)[*nb_jobs]);
+        ++*nb_jobs;
+    }
+    if (err == ERR_NONE && ferror(input))
+        err = ERR_IO;
+    fclose(input);
+    if (err != ERR_NONE)
+    {
+        sim_batch_free(*jobs, *nb_jobs);
+        *jobs = NULL;
+        *nb_jobs = 0;
+    }
+    return err;
+}
+
+void sim_batch_free(sim_job_t *jobs, size_t nb_jobs)
+{
+    for (size_t k = 0; jobs != NULL && k < nb_jobs; ++k)
+    {
+        if (jobs[k].loaded)
+        {
+            (void)program_free(&jobs[k].program);
+            if (jobs[k].format == SIM_MEMORY_IMAGE)
+                (void)mem_image_free(jobs[k].mem_space, jobs[k].mem_size);
+            else
+                free(jobs[k].mem_space);
+        }
+    }
+    free(jobs);
+}
+
+// ======================================================================
+// loading of the jobs
+
+static int load(sim_job_t *job)
+{
+    int err = ERR_NONE;
+    switch (job->format)
+    {
+    case SIM_MEMORY_DUMP:
+        err = mem_init_from_dumpfile(job->memory, &job->mem_space, &job->mem_size);
+        break;
+    case SIM_MEMORY_DESCRIPTION:
+        err = mem_init_from_description(job->memory, &job->mem_space, &job->mem_size);
+        break;
+    default:
+        err = mem_init_from_image(job->memory, &job->mem_space, &job->mem_size);
+        break;
+    }
+    M_EXIT_IF_ERR(err, "loading the memory");
+    err = program_read(job->trace, &job->program);
+    if (err != ERR_NONE)
+    {
+        if (job->format == SIM_MEMORY_IMAGE)
+            (void)mem_image_free(job->mem_space, job->mem_size);
+        else
+            free(job->mem_space);
+        job->mem_space = NULL;
+        return err;
+    }
+    for_all_lines(line, &job->program)
+    {
+        if (line->order == WRITE)
+            job->writes = 1;
+    }
+    job->loaded = 1;
+    return ERR_NONE;
+}
+
+// a task of the pool: the failure of a job does not stop the others
+static int load_task(void *arg, size_t task, size_t worker)
+{
+    (void)worker;
+    sim_job_t *job = &((sim_job_t *)arg)[task];
+    job->error = load(job);
+    return ERR_NONE;
+}
+
+// ======================================================================
+// simulation of the segments
+
+typedef struct
+{
+    size_t job;
+    size_t begin; // first command
+    size_t end;   // past the last command
+    sim_stats_t stats;
+    int error;
+} segment_t;
+
+// the segments are run from the longest to the shortest
+typedef struct
+{
+    size_t length;
+    size_t segment;
+} order_t;
+
+typedef struct
+{
+    sim_job_t *jobs;
+    segment_t *segments;
+    order_t *order;
+    size_t warmup_lines;
+} batch_t;
+
+static int simulate(const sim_job_t *job, segment_t *segment, size_t warmup_lines)
+{
+    const size_t warmup_begin = segment->begin > warmup_lines ? segment->begin - warmup_lines : 0;
+    // a segment of a writing trace needs its own copy of the memory, unless it is alone
+    void *copy = NULL;
+    if (job->writes && job->nb_segments > 1)
+    {
+        copy = malloc(job->mem_size);
+        M_EXIT_IF_NULL(copy, job->mem_size);
+        memcpy(copy, job->mem_space, job->mem_size);
+    }
+    void *mem_space = copy != NULL ? copy : job->mem_space;
+
+    // checkpoint at the start of the warm-up
+    addr_space_t space = ADDR_SPACE_DEFAULT;
+    sim_ctx_t *ctx = NULL;
+    int err = sim_replay(copy, &job->program, 0, warmup_begin, &space);
+    if (err == ERR_NONE)
+        err = sim_ctx_create(&job->config, &ctx);
+    if (err == ERR_NONE)
+        err = tlb_hrchy_switch(&ctx->tlb, &space);
+
+    for (size_t i = warmup_begin; i < segment->begin && err == ERR_NONE; ++i)
+        err = sim_ctx_execute(ctx, mem_space, &job->program.listing[i]);
+    if (err == ERR_NONE)
+        sim_ctx_reset_stats(ctx);
+    for (size_t i = segment->begin; i < segment->end && err == ERR_NONE; ++i)
+        err = sim_ctx_execute(ctx, mem_space, &job->program.listing[i]);
+    if (err == ERR_NONE)
+        sim_ctx_get_stats(ctx, &segment->stats);
+
+    sim_ctx_destroy(ctx);
+    free(copy);
+    return err;
+}
+
+static int segment_task(void *arg, size_t task, size_t worker)
+{
+    (void)worker;
+    batch_t *batch = arg;
+    segment_t *segment = &batch->segments[batch->order[task].segment];
+    segment->error = simulate(&batch->jobs[segment->job], segment, batch->warmup_lines);
+    return ERR_NONE;
+}
+
+static int by_length(const void *a, const void *b)
+{
+    const order_t *i = a;
+    const order_t *j = b;
+    if (i->length != j->length)
+        return i->length > j->length ? -1 : 1;
+    return i->segment < j->segment ? -1 : i->segment > j->segment;
+}
+
+int sim_batch_run(sim_job_t *jobs, size_t nb_jobs, size_t nb_threads, size_t segment_lines, size_t warmup_lines)
+{
+    M_REQUIRE(nb_jobs == 0 || jobs != NULL, ERR_BAD_PARAMETER, "%s", "no jobs");
+    M_EXIT_IF_ERR(ws_pool_run(load_task, jobs, nb_jobs, nb_threads), "loading the jobs");
+
+    size_t nb_segments = 0;
+    for (size_t k = 0; k < nb_jobs; ++k)
+    {
+        const size_t nb_lines = jobs[k].program.nb_lines;
+        jobs[k].nb_segments = !jobs[k].loaded ? 0
+                              : segment_lines == 0 || nb_lines <= segment_lines ? 1
+                              : (nb_lines + segment_lines - 1) / segment_lines;
+        memset(&jobs[k].stats, 0, sizeof(sim_stats_t));
+        nb_segments += jobs[k].nb_segments;
+    }
+    batch_t batch = { jobs, calloc(nb_segments, sizeof(segment_t)), calloc(nb_segments, sizeof(order_t)), warmup_lines };
+    if (nb_segments > 0 && (batch.segments == NULL || batch.order == NULL))
+    {
+        free(batch.segments);
+        free(batch.order);
+        return ERR_MEM;
+    }
+    size_t s = 0;
+    for (size_t k = 0; k < nb_jobs; ++k)
+    {
+        for (size_t n = 0; n < jobs[k].nb_segments; ++n, ++s)
+        {
+            batch.segments[s].job = k;
+            batch.segments[s].begin = n * segment_lines;
+            batch.segments[s].end = n + 1 == jobs[k].nb_segments ? jobs[k].program.nb_lines : (n + 1) * segment_lines;
+            batch.order[s] = (order_t){ batch.segments[s].end - batch.segments[s].begin, s };
+        }
+    }
+    qsort(batch.order, nb_segments, sizeof(order_t), by_length);
+
+    const int err = ws_pool_run(segment_task, &batch, nb_segments, nb_threads);
+    for (s = 0; s < nb_segments && err == ERR_NONE; ++s)
+    {
+        sim_job_t *job = &jobs[batch.segments[s].job];
+        if (batch.segments[s].error != ERR_NONE && job->error == ERR_NONE)
+            job->error = batch.segments[s].error;
+        sim_stats_add(&job->stats, &batch.segments[s].stats);
+    }
+    free(batch.segments);
+    free(batch.order);
+    return err;
+}
+
+int sim_batch_print(FILE *output, const sim_job_t *jobs, size_t nb_jobs)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE(nb_jobs == 0 || jobs != NULL, ERR_BAD_PARAMETER, "%s", "no jobs");
+    sim_stats_t total;
+    memset(&total, 0, sizeof(sim_stats_t));
+    size_t failed = 0;
+    for (size_t k = 0; k < nb_jobs; ++k)
+    {
+        fprintf(output, "JOB %zu (%s), %zu SEGMENTS: ", k, jobs[k].spec, jobs[k].nb_segments);
+        if (jobs[k].error != ERR_NONE)
+        {
+            fprintf(output, "ERROR: %s\n", ERR_MESSAGES[jobs[k].error - ERR_NONE]);
+            ++failed;
+            continue;
+        }
+        M_EXIT_IF_ERR(sim_stats_print(output, &jobs[k].stats), "printing a job");
+        sim_stats_add(&total, &jobs[k].stats);
+    }
+    fprintf(output, "TOTAL (%zu JOBS, %zu FAILED): ", nb_jobs, failed);
+    return sim_stats_print(output, &total);
+}
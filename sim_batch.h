@@ -0,0 +1,109 @@
+#pragma once
+
+/**
+ * @file sim_batch.h
+ * @brief batch of simulations, each one of a trace on a memory image with a
+ * configuration of the simulator, run on a work-stealing pool of threads
+ * (see ws_pool.h). A long trace can be split into segments of consecutive
+ * commands, simulated independently, each one from a checkpoint:
+ *  - the memory and the address space at the start of the segment are those
+ *    of the whole trace, rebuilt by replaying (functionally: page walks and
+ *    stores only) the writes and context switches before it;
+ *  - the caches and TLBs are warmed up by simulating (without accounting)
+ *    a given number of commands before it.
+ * The statistics of a trace are the sums of those of its segments: they are
+ * those of the whole trace when the warm-up covers everything before each
+ * segment, and an approximation otherwise (caches and TLBs start colder).
+ *
+ * @date 2019
+ */
+
+#include "sim.h"
+
+#include <stdio.h>  // for FILE
+#include <stddef.h> // for size_t
+
+#define SIM_BATCH_LINE_MAX 1024 // longest line of a manifest
+
+/**
+ * @brief how the memory of a job is given (see memory.h)
+ */
+typedef enum
+{
+    SIM_MEMORY_DUMP,
+    SIM_MEMORY_DESCRIPTION,
+    SIM_MEMORY_IMAGE,
+    NB_SIM_MEMORY_FORMATS
+} sim_memory_format_t;
+
+/**
+ * @brief a job of a batch: what to simulate (from the manifest), and then
+ * the simulation
+ */
+typedef struct
+{
+    char spec[SIM_BATCH_LINE_MAX]; // its line of the manifest
+    sim_memory_format_t format;
+    char memory[SIM_BATCH_LINE_MAX];
+    char trace[SIM_BATCH_LINE_MAX];
+    sim_config_t config;
+
+    void *mem_space;
+    size_t mem_size;
+    program_t program;
+    int loaded; // mem_space and program are there
+    int writes; // the trace writes: its segments need their own memory
+    size_t nb_segments;
+    sim_stats_t stats;
+    int error; // of its loading or of one of its segments
+} sim_job_t;
+
+//=========================================================================
+/**
+ * @brief Read a manifest: one job per line, empty lines and lines starting
+ * with # being ignored, each one "(dump|desc|image) MEMORY TRACE [CONFIG]" where
+ * CONFIG (the rest of the line) changes SIM_CONFIG_DEFAULT (see
+ * sim_config_parse()).
+ *
+ * @param filename the manifest
+ * @param jobs (modified) the jobs, to be freed with sim_batch_free()
+ * @param nb_jobs (modified) their number
+ * @return error code
+ */
+int sim_batch_read(const char *filename, sim_job_t **jobs, size_t *nb_jobs);
+
+//=========================================================================
+/**
+ * @brief Run the jobs: load their memory and trace, then simulate them,
+ * traces of more than segment_lines commands being split. The failure of a
+ * job (see its error) does not stop the others.
+ *
+ * @param jobs (modified) the jobs, getting their statistics
+ * @param nb_jobs their number
+ * @param nb_threads the number of threads, from 1 to WS_POOL_MAX_WORKERS
+ * @param segment_lines the length of the segments, 0 not to split
+ * @param warmup_lines the commands simulated before a segment to warm it up
+ * @return error code (of the batch itself, not of the jobs)
+ */
+int sim_batch_run(sim_job_t *jobs, size_t nb_jobs, size_t nb_threads, size_t segment_lines, size_t warmup_lines);
+
+//=========================================================================
+/**
+ * @brief Print the results of the jobs, in order, then their total (over
+ * the jobs which did not fail).
+ *
+ * @param output the stream to print to
+ * @param jobs the jobs
+ * @param nb_jobs their number
+ * @return error code
+ */
+int sim_batch_print(FILE *output, const sim_job_t *jobs, size_t nb_jobs);
+
+//=========================================================================
+/**
+ * @brief Free the jobs.
+ *
+ * @param jobs the jobs
+ * @param nb_jobs their number
+ */
+void sim_batch_free(sim_job_t *jobs, size_t nb_jobs);
@@ -0,0 +1,240 @@
+/**
+ * @file sim_sample.c
+ * @brief sampled simulation of a long trace
+ *
+ * @date 2019
+ */
+
+#include "sim_sample.h"
+#include "tlb_hrchy_mng.h"
+#include "error.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_FIELD_MAX 64 // longest KEY=VALUE field
+#define SAMPLE_Z 1.96       // of a confidence of 95%
+
+static int size_parse(const char *value, size_t *size)
+{
+    char *end = NULL;
+    const unsigned long long v = strtoull(value, &end, 10);
+    M_REQUIRE(end != value && *end == '\0' && v <= SIZE_MAX, ERR_BAD_PARAMETER, "bad number \"%s\"", value);
+    *size = (size_t)v;
+    return ERR_NONE;
+}
+
+static int field_parse(const char *key, const char *value, sim_sample_config_t *config)
+{
+    if (!strcmp(key, "period"))
+        return size_parse(value, &config->period);
+    if (!strcmp(key, "window"))
+        return size_parse(value, &config->window);
+    if (!strcmp(key, "warmup"))
+        return size_parse(value, &config->warmup);
+    if (!strcmp(key, "min"))
+        return size_parse(value, &config->min_windows);
+    if (!strcmp(key, "ff") && (!strcmp(value, "warm") || !strcmp(value, "skip")))
+        config->ff = !strcmp(value, "warm") ? SIM_FF_WARM : SIM_FF_SKIP;
+    else if (!strcmp(key, "target"))
+    {
+        char *end = NULL;
+        config->target = strtod(value, &end);
+        M_REQUIRE(end != value && *end == '\0' && config->target >= 0, ERR_BAD_PARAMETER, "bad target \"%s\"", value);
+    }
+    else
+        M_EXIT(ERR_BAD_PARAMETER, "bad sampling field \"%s=%s\"", key, value);
+    return ERR_NONE;
+}
+
+int sim_sample_config_parse(const char *spec, sim_sample_config_t *config)
+{
+    M_REQUIRE_NON_NULL(spec);
+    M_REQUIRE_NON_NULL(config);
+    static const char *const blanks = " \t\r\n";
+    const char *p = spec + strspn(spec, blanks);
+    while (*p != '\0')
+    {
+        const size_t length = strcspn(p, blanks);
+        M_REQUIRE(length < SAMPLE_FIELD_MAX, ERR_BAD_PARAMETER, "sampling field too long in \"%s\"", spec);
+        char field[SAMPLE_FIELD_MAX];
+        memcpy(field, p, length);
+        field[length] = '\0';
+        char *value = strchr(field, '=');
+        M_REQUIRE(value != NULL, ERR_BAD_PARAMETER, "no value for sampling field \"%s\"", field);
+        *value++ = '\0';
+        M_EXIT_IF_ERR(field_parse(field, value, config), "parsing a sampling configuration");
+        p += length;
+        p += strspn(p, blanks);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+// estimates
+
+/*
+ * Sums over the windows for the ratio estimate of a quantity x per access:
+ * the estimate is sum(x) / sum(a), its variance is computed from the
+ * residuals x - R * a of the windows.
+ */
+typedef struct
+{
+    double x;
+    double xx;
+    double xa;
+} ratio_sums_t;
+
+typedef struct
+{
+    size_t n;
+    double a;
+    double aa;
+    ratio_sums_t sums[3]; // L1 misses, misses, cycles
+} samples_t;
+
+static void add_sample(samples_t *s, uint64_t accesses, const uint64_t x[3])
+{
+    const double a = (double)accesses;
+    s->n++;
+    s->a += a;
+    s->aa += a * a;
+    for (int k = 0; k < 3; ++k)
+    {
+        s->sums[k].x += (double)x[k];
+        s->sums[k].xx += (double)x[k] * (double)x[k];
+        s->sums[k].xa += (double)x[k] * a;
+    }
+}
+
+static sim_estimate_t estimate(const samples_t *s, const ratio_sums_t *sums)
+{
+    sim_estimate_t e = { 0.0, HUGE_VAL };
+    if (s->a <= 0)
+        return e;
+    e.value = sums->x / s->a;
+    if (s->n < 2)
+        return e;
+    const double n = (double)s->n;
+    double residuals = sums->xx - 2 * e.value * sums->xa + e.value * e.value * s->aa;
+    if (residuals < 0) // rounding
+        residuals = 0;
+    e.error = SAMPLE_Z * sqrt(residuals / (n - 1) / n) / (s->a / n);
+    return e;
+}
+
+static int converged(const sim_estimate_t *e, double target)
+{
+    return e->error <= target / 100 * e->value;
+}
+
+// ======================================================================
+// sampling
+
+// raw statistics (see sim_ctx_get_raw_stats()) of what ctx did since before
+static void stats_since(const sim_ctx_t *ctx, const sim_stats_t *before, sim_stats_t *since)
+{
+    sim_ctx_get_raw_stats(ctx, since);
+    for (int c = L1_ICACHE; c < NB_CACHE_TYPES; ++c)
+        since->cache.hits[c] -= before->cache.hits[c];
+    since->cache.misses -= before->cache.misses;
+    since->cache.unsampled -= before->cache.unsampled;
+    since->accesses -= before->accesses;
+    since->walks -= before->walks;
+    since->cycles -= before->cycles;
+}
+
+static int execute(sim_ctx_t *ctx, void *mem_space, const program_t *program, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+        M_EXIT_IF_ERR(sim_ctx_execute(ctx, mem_space, &program->listing[i]), "executing a command");
+    return ERR_NONE;
+}
+
+int sim_sample_run(sim_ctx_t *ctx, void *mem_space, const program_t *program,
+                   const sim_sample_config_t *config, sim_sample_result_t *result)
+{
+    M_REQUIRE_NON_NULL(ctx);
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE_NON_NULL(result);
+    M_REQUIRE(config->window >= 1 && config->window <= config->period, ERR_BAD_PARAMETER,
+              "window (%zu) must be in [1, period (%zu)]", config->window, config->period);
+    M_REQUIRE(config->ff < NB_SIM_FF_MODES, ERR_BAD_PARAMETER, "unknown fast-forward %d", config->ff);
+    M_REQUIRE(config->min_windows >= 2, ERR_BAD_PARAMETER, "%s", "at least 2 windows are needed for an interval");
+
+    memset(result, 0, sizeof(sim_sample_result_t));
+    samples_t samples;
+    memset(&samples, 0, sizeof(samples_t));
+    sim_stats_t raw; // of the windows
+    memset(&raw, 0, sizeof(sim_stats_t));
+    const size_t nb_lines = program->nb_lines;
+    size_t next = 0; // first command not handled yet
+    for (size_t start = 0; start + config->period - config->window < nb_lines; start += config->period)
+    {
+        const size_t window_begin = start + config->period - config->window;
+        const size_t window_end = window_begin + config->window < nb_lines ? window_begin + config->window : nb_lines;
+
+        size_t detailed_begin = next;
+        if (config->ff == SIM_FF_SKIP)
+        {
+            detailed_begin = window_begin - next > config->warmup ? window_begin - config->warmup : next;
+            addr_space_t space = ctx->tlb.space;
+            M_EXIT_IF_ERR(sim_replay(mem_space, program, next, detailed_begin, &space), "fast-forwarding");
+            if (space.asid != ctx->tlb.space.asid || space.pgd != ctx->tlb.space.pgd)
+                M_EXIT_IF_ERR(tlb_hrchy_switch(&ctx->tlb, &space), "switching to the address space");
+        }
+        M_EXIT_IF_ERR(execute(ctx, mem_space, program, detailed_begin, window_begin), "warming up");
+
+        sim_stats_t before;
+        sim_ctx_get_raw_stats(ctx, &before);
+        M_EXIT_IF_ERR(execute(ctx, mem_space, program, window_begin, window_end), "simulating a window");
+        sim_stats_t window;
+        stats_since(ctx, &before, &window);
+        // if L2 is sampled, a window shares its L1 misses to the other sets as
+        // those it simulated, or, if it simulated none, as all the windows so far
+        sim_stats_add(&raw, &window);
+        const int simulated = window.cache.hits[L2_CACHE] + window.cache.misses > 0;
+        sim_stats_extrapolate(&window, simulated ? &window : &raw, ctx->config.latency.memory);
+        sim_stats_add(&result->stats, &window);
+
+        const uint64_t x[3] = { window.accesses - window.cache.hits[L1_ICACHE] - window.cache.hits[L1_DCACHE],
+                                window.cache.misses, window.cycles };
+        add_sample(&samples, window.accesses, x);
+        result->windows++;
+        result->detailed += window_end - detailed_begin;
+        next = window_end;
+
+        if (config->target > 0 && samples.n >= config->min_windows)
+        {
+            const sim_estimate_t l1 = estimate(&samples, &samples.sums[0]);
+            const sim_estimate_t memory = estimate(&samples, &samples.sums[1]);
+            if (converged(&l1, config->target) && converged(&memory, config->target))
+            {
+                result->stopped_early = 1;
+                break;
+            }
+        }
+    }
+    result->commands = result->stopped_early ? next : nb_lines;
+    result->l1_miss_rate = estimate(&samples, &samples.sums[0]);
+    result->miss_rate = estimate(&samples, &samples.sums[1]);
+    result->cycles = estimate(&samples, &samples.sums[2]);
+    return ERR_NONE;
+}
+
+int sim_sample_print(FILE *output, const sim_sample_result_t *result)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(result);
+    fprintf(output, "SAMPLED: WINDOWS: %zu; COMMANDS: %zu; DETAILED: %zu; EARLY STOP: %s\n",
+            result->windows, result->commands, result->detailed, result->stopped_early ? "yes" : "no");
+    fprintf(output, "WINDOWS: ");
+    M_EXIT_IF_ERR(sim_stats_print(output, &result->stats), "printing the windows");
+    fprintf(output, "L1 MISS RATE: %.2f%% +- %.2f%%\n", 100 * result->l1_miss_rate.value, 100 * result->l1_miss_rate.error);
+    fprintf(output, "MISS RATE: %.2f%% +- %.2f%%\n", 100 * result->miss_rate.value, 100 * result->miss_rate.error);
+    fprintf(output, "CYCLES PER ACCESS: %.2f +- %.2f\n", result->cycles.value, result->cycles.error);
+    return ferror(output) ? ERR_IO : ERR_NONE;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+/**
+ * @file sim_sample.h
+ * @brief sampled simulation of a long trace: the trace is cut into periods
+ * of PERIOD commands, the last WINDOW commands of each one being simulated
+ * in detail (and measured), the others fast-forwarded, either:
+ *  - warm: simulated without being measured, so that the caches and TLBs
+ *    are exactly those of a full simulation at each window;
+ *  - skip: only replayed functionally (see sim_replay()), the caches and
+ *    TLBs being warmed up by simulating (without measuring) the WARMUP
+ *    commands before each window: much faster, but slightly biased.
+ * Each window is a sample of the miss rates and of the cycles per access:
+ * their estimates come with a confidence interval (at 95%), and sampling
+ * stops as soon as, after MIN windows at least, the miss rates are known
+ * within TARGET percent of their value.
+ *
+ * @date 2019
+ */
+
+#include "sim.h"
+
+#include <stdio.h>  // for FILE
+#include <stddef.h> // for size_t
+
+/**
+ * @brief how the commands between windows are fast-forwarded
+ */
+typedef enum
+{
+    SIM_FF_WARM,
+    SIM_FF_SKIP,
+    NB_SIM_FF_MODES
+} sim_ff_mode_t;
+
+typedef struct
+{
+    size_t period;  // commands from the start of a period to the next one
+    size_t window;  // measured commands, at the end of each period
+    size_t warmup;  // simulated commands before a window (skip only)
+    sim_ff_mode_t ff;
+    double target;  // relative half-width of the confidence intervals, in percent, 0 not to stop early
+    size_t min_windows; // before stopping early
+} sim_sample_config_t;
+
+#define SIM_SAMPLE_CONFIG_DEFAULT { 10000, 1000, 1000, SIM_FF_WARM, 0.0, 30 }
+
+/**
+ * @brief an estimate and the half-width of its confidence interval
+ */
+typedef struct
+{
+    double value;
+    double error;
+} sim_estimate_t;
+
+typedef struct
+{
+    size_t windows;
+    size_t commands;  // before sampling stopped
+    size_t detailed;  // commands simulated (measured or not)
+    int stopped_early;
+    sim_stats_t stats; // of the windows
+    sim_estimate_t l1_miss_rate; // accesses not served by L1
+    sim_estimate_t miss_rate;    // accesses served by memory
+    sim_estimate_t cycles;       // per access
+} sim_sample_result_t;
+
+//=========================================================================
+/**
+ * @brief Parse a sampling configuration: space-separated KEY=VALUE fields,
+ * each optional: period=N, window=N, warmup=N, ff=warm|skip, target=PERCENT,
+ * min=N (the minimal number of windows).
+ *
+ * @param spec the string to parse
+ * @param config (modified) the configuration
+ * @return error code
+ */
+int sim_sample_config_parse(const char *spec, sim_sample_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Simulate a program by sampling.
+ *
+ * @param ctx the simulator, freshly initialized
+ * @param mem_space the memory
+ * @param program the program
+ * @param config how to sample it
+ * @param result (modified) the estimates
+ * @return error code
+ */
+int sim_sample_run(sim_ctx_t *ctx, void *mem_space, const program_t *program,
+                   const sim_sample_config_t *config, sim_sample_result_t *result);
+
+//=========================================================================
+/**
+ * @brief Print the result of a sampled simulation: how much was simulated,
+ * then each estimate with its confidence interval, one per line.
+ *
+ * @param output the stream to print to
+ * @param result the result
+ * @return error code
+ */
+int sim_sample_print(FILE *output, const sim_sample_result_t *result);
@@ -0,0 +1,69 @@
+/**
+ * @file spsc_ring.c
+ * @brief lock-free single-producer single-consumer ring buffer
+ *
+ * @date 2019
+ */
+
+#include "spsc_ring.h"
+#include "error.h"
+
+#include <sched.h> // for sched_yield()
+#include <stdlib.h>
+
+int spsc_ring_init(spsc_ring_t *ring, size_t capacity)
+{
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE(capacity != 0 && (capacity & (capacity - 1)) == 0, ERR_BAD_PARAMETER,
+              "capacity (%zu) must be a power of 2", capacity);
+    ring->slots = calloc(capacity, sizeof(void *));
+    M_EXIT_IF_NULL(ring->slots, capacity * sizeof(void *));
+    ring->capacity = capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ERR_NONE;
+}
+
+void spsc_ring_free(spsc_ring_t *ring)
+{
+    if (ring != NULL)
+    {
+        free(ring->slots);
+        ring->slots = NULL;
+        ring->capacity = 0;
+    }
+}
+
+int spsc_ring_try_push(spsc_ring_t *ring, void *item)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == ring->capacity)
+        return 0;
+    ring->slots[tail & (ring->capacity - 1)] = item;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+int spsc_ring_try_pop(spsc_ring_t *ring, void **item)
+{
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+        return 0;
+    *item = ring->slots[head & (ring->capacity - 1)];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+void spsc_ring_push(spsc_ring_t *ring, void *item)
+{
+    while (!spsc_ring_try_push(ring, item))
+        sched_yield();
+}
+
+void *spsc_ring_pop(spsc_ring_t *ring)
+{
+    void *item = NULL;
+    while (!spsc_ring_try_pop(ring, &item))
+        sched_yield();
+    return item;
+}
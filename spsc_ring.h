@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+ * @file spsc_ring.h
+ * @brief lock-free ring buffer of pointers between exactly one producer
+ * thread and one consumer thread
+ *
+ * @date 2019
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define SPSC_CACHE_LINE 64 // to keep the indices of both sides on separate lines
+
+/**
+ * @brief the producer only writes tail, the consumer only writes head; a
+ * slot is published by the release store of tail (resp. freed by that of
+ * head), which the other side reads with acquire semantics
+ */
+typedef struct
+{
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head; // next slot to pop
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail; // next slot to push
+    _Alignas(SPSC_CACHE_LINE) size_t capacity;    // a power of 2
+    void **slots;
+} spsc_ring_t;
+
+//=========================================================================
+/**
+ * @brief Allocate an empty ring.
+ *
+ * @param ring (modified) the ring to initialize
+ * @param capacity its number of slots, a power of 2
+ * @return error code
+ */
+int spsc_ring_init(spsc_ring_t *ring, size_t capacity);
+
+//=========================================================================
+/**
+ * @brief Free the memory of a ring.
+ *
+ * @param ring the ring to free
+ */
+void spsc_ring_free(spsc_ring_t *ring);
+
+//=========================================================================
+/**
+ * @brief Push an item, if there is room (producer side).
+ *
+ * @param ring the ring
+ * @param item the item
+ * @return 1 if pushed, 0 if the ring is full
+ */
+int spsc_ring_try_push(spsc_ring_t *ring, void *item);
+
+//=========================================================================
+/**
+ * @brief Pop the oldest item, if any (consumer side).
+ *
+ * @param ring the ring
+ * @param item (modified) the item
+ * @return 1 if popped, 0 if the ring is empty
+ */
+int spsc_ring_try_pop(spsc_ring_t *ring, void **item);
+
+//=========================================================================
+/**
+ * @brief Same as spsc_ring_try_push(), yielding the processor until there
+ * is room.
+ */
+void spsc_ring_push(spsc_ring_t *ring, void *item);
+
+//=========================================================================
+/**
+ * @brief Same as spsc_ring_try_pop(), yielding the processor until there
+ * is an item.
+ */
+void *spsc_ring_pop(spsc_ring_t *ring);
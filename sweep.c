@@ -0,0 +1,160 @@
+/**
+ * @file sweep.c
+ * @brief tool running a same program on many configurations of the
+ * simulator, in parallel, printing the statistics of each.
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32 || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "error.h"
+#include "memory.h"
+#include "commands.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define SWEEP_LINE_MAX 1024
+
+// ======================================================================
+static void error(const char *pgm, const char *msg)
+{
+    assert(msg != NULL);
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename config_filename [nb_threads]\n", pgm);
+    fprintf(stderr, "examples: %s dump memory_dump.bin commands01.txt configs.txt\n", pgm);
+    fprintf(stderr, "          %s desc memory_description.txt commands01.txt configs.txt 8\n", pgm);
+    fprintf(stderr, "(one configuration per line of config_filename, see sim_config_parse(),\n"
+                    " empty lines and lines starting with # being ignored)\n");
+}
+
+// ======================================================================
+// reads the configurations, each one a change of SIM_CONFIG_DEFAULT
+static int configs_read(const char *filename, sim_config_t **configs, char (**specs)[SWEEP_LINE_MAX], size_t *nb)
+{
+    FILE *input = fopen(filename, "r");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(input, ERR_IO);
+    *configs = NULL;
+    *specs = NULL;
+    *nb = 0;
+    size_t allocated = 0;
+    char line[SWEEP_LINE_MAX];
+    int err = ERR_NONE;
+    while (err == ERR_NONE && fgets(line, sizeof(line), input) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        const char *spec = line + strspn(line, " \t");
+        if (*spec == '\0' || *spec == '#')
+            continue;
+        if (*nb == allocated)
+        {
+            allocated = allocated == 0 ? START_SIZE : 2 * allocated;
+            sim_config_t *more_configs = realloc(*configs, allocated * sizeof(sim_config_t));
+            if (more_configs != NULL)
+                *configs = more_configs;
+            char(*more_specs)[SWEEP_LINE_MAX] = realloc(*specs, allocated * sizeof(**specs));
+            if (more_specs != NULL)
+                *specs = more_specs;
+            if (more_configs == NULL || more_specs == NULL)
+            {
+                err = ERR_MEM;
+                break;
+            }
+        }
+        (*configs)[*nb] = (sim_config_t)SIM_CONFIG_DEFAULT;
+        strcpy((*specs)[*nb], spec);
+        err = sim_config_parse(spec, &(*configs)[*nb]);
+        ++*nb;
+    }
+    fclose(input);
+    if (err != ERR_NONE)
+    {
+        free(*configs);
+        free(*specs);
+    }
+    return err;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        error(argv[0], "please provide memory format and filename, command filename and configuration filename:");
+        return 1;
+    }
+    int dump = 1;
+    if (strcmp(argv[1], "dump"))
+    {
+        if (strcmp(argv[1], "desc"))
+        {
+            error(argv[0], "unknown command.");
+            return 1;
+        }
+        dump = 0;
+    }
+    size_t nb_threads = 1;
+    if (argc > 5 && sscanf(argv[5], "%zu", &nb_threads) != 1)
+    {
+        error(argv[0], "wrong number of threads.");
+        return 1;
+    }
+
+    sim_config_t *configs = NULL;
+    char(*specs)[SWEEP_LINE_MAX] = NULL;
+    size_t nb_configs = 0;
+    if (configs_read(argv[4], &configs, &specs, &nb_configs) != ERR_NONE)
+    {
+        error(argv[0], "problem reading the configurations from provided file.");
+        return 3;
+    }
+
+    void *mem_space = NULL;
+    size_t mem_size = 0;
+    int err = dump ? mem_init_from_dumpfile(argv[2], &mem_space, &mem_size)
+                   : mem_init_from_description(argv[2], &mem_space, &mem_size);
+    if (err != ERR_NONE)
+    {
+        free(specs);
+        free(configs);
+        error(argv[0], "problem initializing memory from provided file.");
+        return 3;
+    }
+
+    program_t pgm;
+    if (program_read(argv[3], &pgm) != ERR_NONE)
+    {
+        free(mem_space);
+        free(specs);
+        free(configs);
+        error(argv[0], "problem initializing program from provided file.");
+        return 3;
+    }
+
+    sim_ctx_t **ctxs = calloc(nb_configs, sizeof(sim_ctx_t *));
+    err = nb_configs > 0 && ctxs == NULL ? ERR_MEM
+                                         : sim_sweep(mem_space, mem_size, &pgm, configs, ctxs, nb_configs, nb_threads);
+    for (size_t k = 0; k < nb_configs && err == ERR_NONE; ++k)
+    {
+        printf("CONFIG %zu (%s): ", k, specs[k]);
+        err = sim_ctx_print_stats(stdout, ctxs[k]);
+    }
+    for (size_t k = 0; ctxs != NULL && k < nb_configs; ++k)
+        sim_ctx_destroy(ctxs[k]);
+    if (err != ERR_NONE)
+        fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+
+    free(ctxs);
+    (void)program_free(&pgm);
+    free(mem_space);
+    free(specs);
+    free(configs);
+    return err == ERR_NONE ? 0 : 4;
+}
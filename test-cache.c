@@ -19,12 +19,15 @@
 #include "commands.h"
 #include "memory.h"
 #include "page_walk.h"
+#include "page_memo.h"
+#include "cache_parallel.h"
 
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>    // for isspace()
 #include <inttypes.h> // for SCNx macro
+#include <stdlib.h>   // for strtoul()
 
 // ======================================================================
 static void error(const char *pgm, const char *msg)
@@ -32,9 +35,13 @@ static void error(const char *pgm, const char *msg)
     assert(msg != NULL);
     fputs("ERROR: ", stderr);
     fputs(msg, stderr);
-    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename\n", pgm);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename [pipt|vipt [workers]]\n", pgm);
     fprintf(stderr, "examples: %s dump memory_dump.bin commands01.txt\n", pgm);
-    fprintf(stderr, "          %s desc memory_description.txt commands01.txt\n", pgm);
+    fprintf(stderr, "          %s desc memory_description.txt commands01.txt vipt\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin commands01.txt pipt 8\n", pgm);
+    fprintf(stderr, "(with an L1 indexing, access statistics and latencies are printed at the end;\n"
+                    " with a number of workers, the accesses are simulated in parallel, sets being\n"
+                    " partitioned among the workers, and the caches are only dumped at the end)\n");
 }
 
 // ======================================================================
@@ -42,36 +49,80 @@ void execute_command(void *mem_space,
                      const command_t *command,
                      l1_icache_entry_t *l1_icache,
                      l1_icache_entry_t *l1_dcache,
-                     l2_cache_entry_t *l2_cache)
+                     l2_cache_entry_t *l2_cache,
+                     page_memo_t *memo,
+                     cache_indexing_t indexing,
+                     cache_stats_t *stats,
+                     uint64_t *cycles)
 {
+    if (command->order == SWITCH) // caches are physically tagged: only translations change
+    {
+        assert(page_memo_set_root(memo, command->pgd) == ERR_NONE);
+        return;
+    }
+    if (command->order == INVALIDATE) // the memoized translations may be stale
+    {
+        assert(page_memo_invalidate(memo) == ERR_NONE);
+        return;
+    }
+    const cache_t l1_type = command->type == INSTRUCTION && command->order == READ ? L1_ICACHE : L1_DCACHE;
+    uint16_t vipt_index = 0;
+    if (indexing == CACHE_VIPT) // the set is selected before (while) translating
+        assert(cache_vipt_index(&command->vaddr, l1_type, &vipt_index) == ERR_NONE);
+
     phy_addr_t paddr;
-    assert(page_walk(mem_space, &command->vaddr, &paddr) == ERR_NONE);
+    if (command->translated) // pre-translated trace: no page walk needed
+        paddr = command->paddr;
+    else
+        assert(page_memo_translate(memo, mem_space, &command->vaddr, &paddr) == ERR_NONE);
+    // physically tagged: the set selected from the virtual address must hold the line
+    assert(indexing != CACHE_VIPT
+           || vipt_index == ((((uint32_t)paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset) / L1_ICACHE_LINE) % L1_ICACHE_LINES);
     uint8_t byte;
     uint32_t word;
     void *l1_cache;
+    const cache_stats_t before = *stats;
 
     switch (command->order)
     {
     case READ:
         l1_cache = (command->type == INSTRUCTION) ? l1_icache : l1_dcache;
         if (command->data_size == 4)
-            cache_read(mem_space, &paddr, command->type, l1_cache,
-                       l2_cache, &word, LRU);
+            cache_read_with_stats(mem_space, &paddr, command->type, l1_cache,
+                                  l2_cache, &word, LRU, stats);
         else
-            cache_read_byte(mem_space, &paddr, command->type, l1_cache,
-                            l2_cache, &byte, LRU);
+            cache_read_byte_with_stats(mem_space, &paddr, command->type, l1_cache,
+                                       l2_cache, &byte, LRU, stats);
         break;
     case WRITE:
         if (command->data_size == 4)
-            cache_write(mem_space, &paddr, l1_dcache,
-                        l2_cache, &command->write_data, LRU);
+            cache_write_with_stats(mem_space, &paddr, l1_dcache,
+                                   l2_cache, &command->write_data, LRU, stats);
         else
-            cache_write_byte(mem_space, &paddr, l1_dcache,
-                             l2_cache, (uint8_t)command->write_data, LRU);
+            cache_write_byte_with_stats(mem_space, &paddr, l1_dcache,
+                                        l2_cache, (uint8_t)command->write_data, LRU, stats);
+        // write-through: a write into a page table may change memoized translations
+        assert(page_memo_write(memo, &paddr) == ERR_NONE);
         break;
     default:
         assert(0);
     }
+    const cache_latency_t latency = CACHE_LATENCY_DEFAULT;
+    *cycles += cache_access_latency(&latency, indexing, cache_served_by(&before, stats));
+}
+
+// ======================================================================
+static void dump_caches(const l1_icache_entry_t *l1_icache,
+                        const l1_icache_entry_t *l1_dcache,
+                        const l2_cache_entry_t *l2_cache)
+{
+    printf("L1_ICACHE: \n\n");
+    cache_dump(stdout, l1_icache, L1_ICACHE);
+    printf("L1_DCACHE: \n\n");
+    cache_dump(stdout, l1_dcache, L1_DCACHE);
+    printf("L2_CACHE: \n\n");
+    cache_dump(stdout, l2_cache, L2_CACHE);
+    printf("\n=======================================\n\n");
 }
 
 // ======================================================================
@@ -92,6 +143,34 @@ int main(int argc, char *argv[])
         }
         dump = 0;
     }
+    cache_indexing_t indexing = CACHE_PIPT;
+    if (argc > 4)
+    {
+        if (!strcmp(argv[4], "vipt"))
+            indexing = CACHE_VIPT;
+        else if (strcmp(argv[4], "pipt"))
+        {
+            error(argv[0], "unknown L1 indexing.");
+            return 1;
+        }
+        if (indexing == CACHE_VIPT
+            && (cache_vipt_check(L1_ICACHE) != ERR_NONE || cache_vipt_check(L1_DCACHE) != ERR_NONE))
+        {
+            error(argv[0], "the L1 geometry does not allow virtual indexing (aliasing).");
+            return 1;
+        }
+    }
+    size_t nb_workers = 0; // serial simulation
+    if (argc > 5)
+    {
+        char *end = NULL;
+        nb_workers = strtoul(argv[5], &end, 10);
+        if (*end != '\0' || nb_workers < 1 || nb_workers > CACHE_PARALLEL_MAX_WORKERS)
+        {
+            error(argv[0], "bad number of workers.");
+            return 1;
+        }
+    }
 
     void *mem_space = NULL;
     size_t mem_size = 0;
@@ -113,23 +192,40 @@ int main(int argc, char *argv[])
             memset(l1_dcache, 0, sizeof(l1_dcache));
             memset(l2_cache, 0, sizeof(l2_cache));
 
+            /* No TLB modelled here: translations are memoized */
+            page_memo_t memo;
+            assert(page_memo_init(&memo, PAGE_MEMO_MIN_CAPACITY) == ERR_NONE);
+
             /* Flush caches before use */
             assert(cache_flush(l1_icache, L1_ICACHE) == ERR_NONE);
             assert(cache_flush(l1_dcache, L1_DCACHE) == ERR_NONE);
             assert(cache_flush(l2_cache, L2_CACHE) == ERR_NONE);
 
-            for_all_lines(line, &pgm)
+            cache_stats_t stats;
+            zero_init_var(stats);
+            uint64_t cycles = 0;
+            if (nb_workers > 0) // same final state as the serial simulation
+            {
+                const cache_latency_t latency = CACHE_LATENCY_DEFAULT;
+                err = cache_parallel_run(mem_space, &pgm, l1_icache, (l1_dcache_entry_t *)l1_dcache, l2_cache,
+                                         &latency, indexing, nb_workers, &stats, &cycles);
+                assert(err == ERR_NONE);
+                dump_caches(l1_icache, l1_dcache, l2_cache);
+            }
+            else
             {
-                execute_command(mem_space, line, l1_icache, l1_dcache, l2_cache);
-
-                printf("L1_ICACHE: \n\n");
-                cache_dump(stdout, l1_icache, L1_ICACHE);
-                printf("L1_DCACHE: \n\n");
-                cache_dump(stdout, l1_dcache, L1_DCACHE);
-                printf("L2_CACHE: \n\n");
-                cache_dump(stdout, l2_cache, L2_CACHE);
-                printf("\n=======================================\n\n");
+                for_all_lines(line, &pgm)
+                {
+                    execute_command(mem_space, line, l1_icache, l1_dcache, l2_cache, &memo, indexing, &stats, &cycles);
+                    dump_caches(l1_icache, l1_dcache, l2_cache);
+                }
             }
+            if (argc > 4)
+                printf("INDEXING: %s; L1I HITS: %" PRIu64 "; L1D HITS: %" PRIu64 "; L2 HITS: %" PRIu64
+                       "; MISSES: %" PRIu64 "; CYCLES: %" PRIu64 "\n",
+                       argv[4], stats.hits[L1_ICACHE], stats.hits[L1_DCACHE], stats.hits[L2_CACHE],
+                       stats.misses, cycles);
+            (void)page_memo_free(&memo);
         }
         else
         {
@@ -26,10 +26,11 @@ static void error(const char* pgm, const char* msg)
     assert(msg != NULL);
     fputs("ERROR: ", stderr);
     fputs(msg, stderr);
-    fprintf(stderr, "\nusage:    %s (dump|desc) filename (p|o|u|n) spacer "\
+    fprintf(stderr, "\nusage:    %s (dump|desc|img) filename (p|o|u|n) spacer "\
             "[list of VA to print]\n", pgm);
     fprintf(stderr, "examples: %s dump memory_dump.bin o , 0xff000\n", pgm);
     fprintf(stderr, "          %s desc memory_description.txt o , 0xff000 0xfe000\n", pgm);
+    fprintf(stderr, "          %s img memory_image.img o , 0xff000 0xfe000\n", pgm);
 }
 
 // ======================================================================
@@ -40,8 +41,11 @@ int main(int argc, char *argv[])
         return 1;
     }
     int dump = 1;
+    int image = 0;
     if (strcmp(argv[1], "dump")) {
-        if (strcmp(argv[1], "desc")) {
+        if (!strcmp(argv[1], "img")) {
+            image = 1;
+        } else if (strcmp(argv[1], "desc")) {
             error(argv[0], "unknown command.");
             return 1;
         }
@@ -54,6 +58,9 @@ int main(int argc, char *argv[])
     if (dump) {
       err = mem_init_from_dumpfile(argv[2], &mem_space, &mem_size);
       fprintf(stderr, "dumpfile");
+    } else if (image) {
+      err = mem_init_from_image(argv[2], &mem_space, &mem_size);
+      fprintf(stderr, "image");
     } else {
       err = mem_init_from_description(argv[2], &mem_space, &mem_size);
       fprintf(stderr, "description");
@@ -93,7 +100,8 @@ int main(int argc, char *argv[])
             const int error = init_virt_addr64(&vaddr, vaddr64);
             if (error != ERR_NONE) {
                 puts("Mauvaise adresse ==> Abandon");
-                free(mem_space);
+                if (image) mem_image_free(mem_space, mem_size);
+                else free(mem_space);
                 return 2;
             }
 
@@ -106,6 +114,7 @@ int main(int argc, char *argv[])
         return 3;
     }
 
-    free(mem_space);
+    if (image) mem_image_free(mem_space, mem_size);
+    else free(mem_space);
     return 0;
 }
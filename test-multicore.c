@@ -0,0 +1,139 @@
+/**
+ * @file test-multicore.c
+ * @brief black-box testing of the multi-core simulation
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32 || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "error.h"
+#include "memory.h"
+#include "commands.h"
+#include "multicore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ======================================================================
+static void error(const char *pgm, const char *msg)
+{
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename (rr|ts) [none|mesi|moesi] [banks=SPEC] command_filename...\n", pgm);
+    fprintf(stderr, "examples: %s dump memory_dump.bin rr core0.txt core1.txt\n", pgm);
+    fprintf(stderr, "          %s desc memory_description.txt ts mesi all_cores.txt\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin rr banks=4x1:2:8 core0.txt core1.txt\n", pgm);
+    fprintf(stderr, "(with several command files, the commands of the k-th one are issued by core k,\n"
+                    " interleaved round robin (rr) or by timestamp (ts); with a single one, each\n"
+                    " command is issued by the core it is prefixed with, in order;\n"
+                    " the L1 data caches are kept coherent by the given protocol, none by default;\n"
+                    " L2 is banked as given, see l2_banks_config_parse(), not by default)\n");
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        error(argv[0], "please provide memory format and file, interleaving, and command file(s).");
+        return 1;
+    }
+    if (strcmp(argv[1], "dump") && strcmp(argv[1], "desc"))
+    {
+        error(argv[0], "unknown memory format.");
+        return 1;
+    }
+    if (strcmp(argv[3], "rr") && strcmp(argv[3], "ts"))
+    {
+        error(argv[0], "unknown interleaving.");
+        return 1;
+    }
+    const interleave_t mode = !strcmp(argv[3], "ts") ? INTERLEAVE_TIMESTAMP : INTERLEAVE_ROUND_ROBIN;
+    coherence_protocol_t protocol = COHERENCE_NONE;
+    int first_trace = 4;
+    if (!strcmp(argv[4], "none") || !strcmp(argv[4], "mesi") || !strcmp(argv[4], "moesi"))
+    {
+        (void)coherence_protocol_parse(argv[4], &protocol);
+        ++first_trace;
+    }
+    l2_banks_config_t banks_config = L2_BANKS_CONFIG_NONE;
+    if (first_trace < argc && !strncmp(argv[first_trace], "banks=", 6))
+    {
+        if (l2_banks_config_parse(argv[first_trace] + 6, &banks_config) != ERR_NONE)
+        {
+            error(argv[0], "bad L2 banks.");
+            return 1;
+        }
+        ++first_trace;
+    }
+    if (argc <= first_trace)
+    {
+        error(argv[0], "please provide command file(s).");
+        return 1;
+    }
+    const size_t nb_traces = (size_t)(argc - first_trace);
+    if (nb_traces > MULTICORE_MAX_CORES)
+    {
+        error(argv[0], "too many command files.");
+        return 1;
+    }
+
+    void *mem_space = NULL;
+    size_t mem_size = 0;
+    int err = !strcmp(argv[1], "dump") ? mem_init_from_dumpfile(argv[2], &mem_space, &mem_size)
+                                       : mem_init_from_description(argv[2], &mem_space, &mem_size);
+    if (err != ERR_NONE)
+    {
+        error(argv[0], "problem initializing memory from provided file.");
+        return 3;
+    }
+
+    program_t traces[MULTICORE_MAX_CORES];
+    size_t nb_read = 0;
+    for (; nb_read < nb_traces && err == ERR_NONE; ++nb_read)
+        err = program_read(argv[first_trace + nb_read], &traces[nb_read]);
+    program_t pgm;
+    size_t nb_cores = nb_traces;
+    if (err == ERR_NONE && nb_traces > 1)
+        err = program_interleave(traces, nb_traces, mode, &pgm);
+    else if (err == ERR_NONE)
+    {
+        pgm = traces[0];
+        nb_read = 0; // pgm now owns its listing
+        nb_cores = 1;
+        for_all_lines(line, &pgm)
+        {
+            if (line->core >= nb_cores)
+                nb_cores = (size_t)line->core + 1;
+        }
+    }
+    for (size_t k = 0; k < nb_read; ++k)
+        (void)program_free(&traces[k]);
+    if (err != ERR_NONE)
+    {
+        free(mem_space);
+        error(argv[0], "problem initializing program from provided file(s).");
+        return 3;
+    }
+
+    multicore_t mc;
+    const tlb_hrchy_config_t tlb_config = TLB_HRCHY_CONFIG_DEFAULT;
+    err = multicore_init(&mc, nb_cores, &tlb_config, CACHE_PIPT, protocol, &banks_config);
+    if (err == ERR_NONE)
+    {
+        err = multicore_run(&mc, mem_space, &pgm);
+        if (err == ERR_NONE)
+            err = multicore_print_stats(stdout, &mc);
+        multicore_free(&mc);
+    }
+    if (err != ERR_NONE)
+        fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+
+    (void)program_free(&pgm);
+    free(mem_space);
+    return err == ERR_NONE ? 0 : 4;
+}
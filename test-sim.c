@@ -0,0 +1,141 @@
+/**
+ * @file test-sim.c
+ * @brief black-box testing of the simulator context, run serially,
+ * pipelined, interleaved with a second context in the same thread, or
+ * sampled
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32 || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "error.h"
+#include "memory.h"
+#include "commands.h"
+#include "sim.h"
+#include "pipeline.h"
+#include "sim_sample.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ======================================================================
+static void error(const char *pgm, const char *msg)
+{
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename (serial|pipelined|interleaved|sampled) [config [sampling [sets]]]\n", pgm);
+    fprintf(stderr, "examples: %s dump memory_dump.bin commands01.txt serial\n", pgm);
+    fprintf(stderr, "          %s desc memory_description.txt commands01.txt pipelined \"l1tlb=4x4 indexing=vipt\"\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin commands01.txt sampled \"\" \"period=1000 window=100 target=5\"\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin commands01.txt serial \"l2sample=8\" \"\" sets\n", pgm);
+    fprintf(stderr, "(see sim_config_parse() for the configuration, sim_sample_config_parse() for the sampling;\n"
+                    " with sets, the L1 misses and L2 hits of each simulated L2 set are printed last)\n");
+}
+
+// ======================================================================
+// runs the program on ctx and on a second simulator of the same
+// configuration, one command on each in turn: both must end up with the
+// statistics of a serial run (the second must write what the first just
+// wrote), which they print
+static int run_interleaved(sim_ctx_t *ctx, void *mem_space, const program_t *pgm)
+{
+    sim_ctx_t *other = NULL;
+    M_EXIT_IF_ERR(sim_ctx_create(&ctx->config, &other), "creating a second simulator");
+    int err = ERR_NONE;
+    for_all_lines(line, pgm)
+    {
+        err = sim_ctx_execute(ctx, mem_space, line);
+        if (err == ERR_NONE)
+            err = sim_ctx_execute(other, mem_space, line);
+        if (err != ERR_NONE)
+            break;
+    }
+    if (err == ERR_NONE)
+        err = sim_ctx_print_stats(stdout, other);
+    sim_ctx_destroy(other);
+    return err;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        error(argv[0], "please provide memory format and file, command file and mode.");
+        return 1;
+    }
+    if (strcmp(argv[1], "dump") && strcmp(argv[1], "desc"))
+    {
+        error(argv[0], "unknown memory format.");
+        return 1;
+    }
+    if (strcmp(argv[4], "serial") && strcmp(argv[4], "pipelined") && strcmp(argv[4], "interleaved")
+        && strcmp(argv[4], "sampled"))
+    {
+        error(argv[0], "unknown mode.");
+        return 1;
+    }
+    sim_config_t config = SIM_CONFIG_DEFAULT;
+    if (argc > 5 && sim_config_parse(argv[5], &config) != ERR_NONE)
+    {
+        error(argv[0], "bad configuration.");
+        return 1;
+    }
+    sim_sample_config_t sampling = SIM_SAMPLE_CONFIG_DEFAULT;
+    if (argc > 6 && sim_sample_config_parse(argv[6], &sampling) != ERR_NONE)
+    {
+        error(argv[0], "bad sampling.");
+        return 1;
+    }
+
+    void *mem_space = NULL;
+    size_t mem_size = 0;
+    int err = !strcmp(argv[1], "dump") ? mem_init_from_dumpfile(argv[2], &mem_space, &mem_size)
+                                       : mem_init_from_description(argv[2], &mem_space, &mem_size);
+    if (err != ERR_NONE)
+    {
+        error(argv[0], "problem initializing memory from provided file.");
+        return 3;
+    }
+
+    sim_ctx_t *ctx = NULL;
+    err = sim_ctx_create(&config, &ctx);
+    if (err == ERR_NONE)
+    {
+        if (!strcmp(argv[4], "pipelined"))
+            err = pipeline_run(ctx, mem_space, argv[3]);
+        else
+        {
+            program_t pgm;
+            err = program_read(argv[3], &pgm);
+            if (err == ERR_NONE)
+            {
+                if (!strcmp(argv[4], "sampled"))
+                {
+                    sim_sample_result_t result;
+                    err = sim_sample_run(ctx, mem_space, &pgm, &sampling, &result);
+                    if (err == ERR_NONE)
+                        err = sim_sample_print(stdout, &result);
+                }
+                else
+                    err = !strcmp(argv[4], "serial") ? sim_ctx_run(ctx, mem_space, &pgm)
+                                                     : run_interleaved(ctx, mem_space, &pgm);
+                (void)program_free(&pgm);
+            }
+        }
+        if (err == ERR_NONE && strcmp(argv[4], "sampled"))
+            err = sim_ctx_print_stats(stdout, ctx);
+        if (err == ERR_NONE && argc > 7 && !strcmp(argv[7], "sets"))
+            err = sim_ctx_print_l2_sets(stdout, ctx);
+        sim_ctx_destroy(ctx);
+    }
+    if (err != ERR_NONE)
+        fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+
+    free(mem_space);
+    return err == ERR_NONE ? 0 : 4;
+}
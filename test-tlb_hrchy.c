@@ -17,26 +17,62 @@
 #include "memory.h"
 #include "tlb_hrchy.h"
 #include "tlb_hrchy_mng.h"
+#include "tlb_profile.h"
 
 #include <inttypes.h> // for PRIx macros
 
 // --------------------------------------------------
-#define print_all_tlb_entries(tlb, TYPE, N)                                      \
+#define print_all_tlb_entries(level)                                             \
     do {                                                                         \
+        const int tag_width = ((level)->tag_bits + 3) / 4;                       \
         fputc('\n', f_out); fputc('\n', f_out);                                  \
-        for (int tlb_line_index = 0; tlb_line_index < (N); tlb_line_index++) {   \
-            if(((TYPE *) (tlb) + tlb_line_index)->v)                             \
-                fprintf(f_out, "%d; %08X; %05X;\n" ,                             \
-                        ((TYPE *) (tlb) + tlb_line_index)->v,                    \
-                        ((TYPE *) (tlb) + tlb_line_index)->tag,                  \
-                        ((TYPE *) (tlb) + tlb_line_index)->phy_page_num          \
-                );                                                               \
+        for (size_t tlb_line_index = 0;                                          \
+             tlb_line_index < (size_t) (level)->sets * (level)->ways;            \
+             tlb_line_index++) {                                                 \
+            const tlb_line_t* line = &(level)->lines[tlb_line_index];            \
+            if (tlb_line_live(level, line))                                      \
+                fprintf(f_out, "%d; %0*" PRIX64 "; %05X;\n" ,                    \
+                        1, tag_width, line->tag, line->phy_page_num);            \
             else                                                                 \
-                fprintf(f_out, "%d; --------; -----;\n" ,                        \
-                        ((TYPE *) (tlb) + tlb_line_index)->v                     \
-                );                                                               \
+                fprintf(f_out, "%d; --------; -----;\n" , 0);                    \
         }} while(0)
 
+// ======================================================================
+static void print_invalidation(FILE* f_out, const command_t* command, uint16_t asid)
+{
+    switch (command->scope) {
+    case INVAL_PAGE:
+        fprintf(f_out, "PAGE @0x%016" PRIX64 " (ASID 0x%04" PRIX16 ")\n", virt_addr_t_to_uint64_t(&command->vaddr), asid);
+        break;
+    case INVAL_RANGE:
+        fprintf(f_out, "RANGE [0x%016" PRIX64 ", 0x%016" PRIX64 ") (ASID 0x%04" PRIX16 ")\n",
+                virt_addr_t_to_uint64_t(&command->vaddr), command->vaddr_end, asid);
+        break;
+    case INVAL_ASID:
+        fprintf(f_out, "ASID 0x%04" PRIX16 "\n", asid);
+        break;
+    default:
+        fprintf(f_out, "ALL\n");
+        break;
+    }
+}
+
+// ======================================================================
+static int invalidate(tlb_hrchy_t* hrchy, const command_t* command)
+{
+    const uint16_t asid = hrchy->space.asid;
+    switch (command->scope) {
+    case INVAL_PAGE:
+        return tlb_invalidate_page(hrchy, asid, &command->vaddr);
+    case INVAL_RANGE:
+        return tlb_invalidate_range(hrchy, asid, virt_addr_t_to_uint64_t(&command->vaddr), command->vaddr_end);
+    case INVAL_ASID:
+        return tlb_invalidate_asid(hrchy, asid);
+    default:
+        return tlb_invalidate_all(hrchy);
+    }
+}
+
 // ======================================================================
 static void usage()
 {
@@ -44,6 +80,12 @@ static void usage()
     fputs("\t- one (txt) to read commands from;\n", stderr);
     fputs("\t- one (bin) to memory content from;\n", stderr);
     fputs("\t- one to write output to.\n", stderr);
+    fputs("and optionally the L1 (both I and D) and L2 TLB geometries,\n", stderr);
+    fputs("as SETSxWAYS[:lru|:plru] (default: 16x1 and 64x1),\n", stderr);
+    fputs("what context switches do: tagged (default) or flush,\n", stderr);
+    fputs("the TLB prefetcher, as KIND[:DEGREE][:bufN] with KIND in none (default), seq, stride, dist,\n", stderr);
+    fputs("the L2 inclusion policy: incl (default), excl or nine,\n", stderr);
+    fputs("and the number N of pages and regions with the most L1 misses to report, after the hits per TLB and page size (none by default).\n", stderr);
 }
 
 // ======================================================================
@@ -76,29 +118,89 @@ int main(int argc, char* argv[])
     }
 
     /**
-     * Statically allocate space for the L1-ITLB, L1-DTLB, and L2-TLB
+     * Allocate the L1-ITLB, L1-DTLB, and L2-TLB
      *
-     * Specs:
+     * Specs (default):
      *  -- Direct mapped
      *  -- 16 lines for L1, 64 lines for L2
      */
+    tlb_hrchy_config_t config = TLB_HRCHY_CONFIG_DEFAULT;
+    if ((argc > 4 && (tlb_level_config_parse(argv[4], &config.level[L1_ITLB]) != ERR_NONE
+                      || tlb_level_config_parse(argv[4], &config.level[L1_DTLB]) != ERR_NONE))
+        || (argc > 5 && tlb_level_config_parse(argv[5], &config.level[L2_TLB]) != ERR_NONE)
+        || (argc > 6 && strcmp(argv[6], "tagged") && strcmp(argv[6], "flush"))
+        || (argc > 7 && tlb_prefetch_config_parse(argv[7], &config.prefetch) != ERR_NONE)
+        || (argc > 8 && strcmp(argv[8], "incl") && strcmp(argv[8], "excl") && strcmp(argv[8], "nine"))) {
+        fclose(f_out);
+        free(mem_space);
+        usage();
+        return 1;
+    }
 
-    l1_itlb_entry_t l1_itlb[L1_ITLB_LINES];
-    l1_dtlb_entry_t l1_dtlb[L1_DTLB_LINES];
-    l2_tlb_entry_t l2_tlb[L2_TLB_LINES];
+    if (argc > 6 && !strcmp(argv[6], "flush"))
+        config.asid_mode = TLB_ASID_FLUSH;
+    if (argc > 8)
+        config.inclusion = !strcmp(argv[8], "excl") ? TLB_EXCLUSIVE : !strcmp(argv[8], "nine") ? TLB_NINE : TLB_INCLUSIVE;
 
-    tlb_flush((void *)l1_itlb, L1_ITLB);
-    tlb_flush((void *)l1_dtlb, L1_DTLB);
-    tlb_flush((void *)l2_tlb, L2_TLB);
+    tlb_hrchy_t hrchy;
+    if (tlb_hrchy_init(&hrchy, &config) != ERR_NONE) {
+        fclose(f_out);
+        free(mem_space);
+        fputs("Cannot allocate the TLB hierarchy.\n", stderr);
+        return 5;
+    }
+
+    // attribution of the L1 misses and of the walks to pages, if a report is asked for
+    tlb_profile_t profile;
+    if (argc > 9) {
+        if (tlb_profile_init(&profile) != ERR_NONE) {
+            fclose(f_out);
+            free(mem_space);
+            tlb_hrchy_free(&hrchy);
+            fputs("Cannot allocate the TLB profile.\n", stderr);
+            return 5;
+        }
+        hrchy.profile = &profile;
+    }
 
     phy_addr_t paddr;
     zero_init_var(paddr);
 
     for (size_t prog_line_index = 0; prog_line_index < pgm.nb_lines; prog_line_index++) {
 
+        const command_t* command = &pgm.listing[prog_line_index];
+        if (command->order == SWITCH) {
+            const addr_space_t space = { command->asid, command->pgd };
+            tlb_hrchy_switch(&hrchy, &space);
+            fprintf(f_out, "\n" SIZE_T_FMT ": CONTEXT SWITCH to ASID 0x%04" PRIX16 " (PGD @0x%08" PRIX32 ")\n",
+                    prog_line_index, command->asid, command->pgd);
+            fprintf(f_out, "%s\n", hrchy.config.asid_mode == TLB_ASID_FLUSH ? "FLUSH..." : "TAGGED...");
+            continue;
+        }
+        if (command->order == INVALIDATE) {
+            fprintf(f_out, "\n" SIZE_T_FMT ": INVALIDATE ", prog_line_index);
+            print_invalidation(f_out, command, hrchy.space.asid);
+            const int err = invalidate(&hrchy, command);
+            if (err != ERR_NONE) {
+                fprintf(f_out, "error with tlb_invalidate(): %s\n", ERR_MESSAGES[err - ERR_NONE]);
+                continue;
+            }
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+            fprintf(f_out, "\n\nL1_ITLB:");
+            print_all_tlb_entries(&hrchy.level[L1_ITLB]);
+            fprintf(f_out, "\n\nL1_DTLB:");
+            print_all_tlb_entries(&hrchy.level[L1_DTLB]);
+            fprintf(f_out, "\n\nL2_TLB:");
+            print_all_tlb_entries(&hrchy.level[L2_TLB]);
+#pragma GCC diagnostic pop
+            fprintf(f_out, "-------------------------------------------------------------------\n");
+            continue;
+        }
+
         int hit = 0;
         fprintf(f_out, "\n" SIZE_T_FMT ": DATA/INSTRUCTION = %d\n", prog_line_index, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION);
-        tlb_search(mem_space, &(pgm.listing[prog_line_index].vaddr), &paddr, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION, l1_itlb, l1_dtlb, l2_tlb, &hit);
+        tlb_hrchy_search(mem_space, &(pgm.listing[prog_line_index].vaddr), &paddr, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION, &hrchy, &hit);
 
         fprintf(f_out, "-------------------------------------------------------------------\n");
         fprintf(f_out, "After program line " SIZE_T_FMT "...\n\n", prog_line_index);
@@ -113,21 +215,43 @@ int main(int argc, char* argv[])
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wconversion"
         fprintf(f_out, "\n\nL1_ITLB:");
-        print_all_tlb_entries(l1_itlb, l1_itlb_entry_t, L1_ITLB_LINES);
+        print_all_tlb_entries(&hrchy.level[L1_ITLB]);
         fprintf(f_out, "\n\nL1_DTLB:");
-        print_all_tlb_entries(l1_dtlb, l1_dtlb_entry_t, L1_DTLB_LINES);
+        print_all_tlb_entries(&hrchy.level[L1_DTLB]);
         fprintf(f_out, "\n\nL2_TLB:");
-        print_all_tlb_entries(l2_tlb, l2_tlb_entry_t, L2_TLB_LINES);
+        print_all_tlb_entries(&hrchy.level[L2_TLB]);
 #pragma GCC diagnostic pop
 
         fprintf(f_out, "-------------------------------------------------------------------\n");
     }
 
+    if (config.prefetch.kind != TLB_PREFETCH_NONE) {
+        fprintf(f_out, "\nPREFETCHES: %" PRIu64 "; BUFFER HITS: %" PRIu64 "; USEFUL: %" PRIu64 "; USELESS: %" PRIu64 "; WALKS: %" PRIu64 "\n",
+                hrchy.stats.prefetches, hrchy.stats.prefetch_hits, hrchy.stats.prefetch_useful,
+                hrchy.stats.prefetch_useless, hrchy.stats.walks);
+    }
+
+    if (argc > 8) {
+        fprintf(f_out, "\nINCLUSION: %s; BACK-INVALIDATIONS: %" PRIu64 "; VICTIM FILLS: %" PRIu64 "; WALKS: %" PRIu64 "\n",
+                argv[8], hrchy.stats.back_invalidations, hrchy.stats.victim_fills, hrchy.stats.walks);
+    }
+
+    if (hrchy.profile != NULL) {
+        fputc('\n', f_out);
+        for (tlb_t t = L1_ITLB; t < NB_TLB_TYPES; ++t)
+            fprintf(f_out, "%s HITS: 4 kiB %" PRIu64 "; 2 MiB %" PRIu64 "; 1 GiB %" PRIu64 "\n",
+                    t == L1_ITLB ? "L1_ITLB" : t == L1_DTLB ? "L1_DTLB" : "L2_TLB",
+                    hrchy.stats.hits[t][PAGE_4K], hrchy.stats.hits[t][PAGE_2M], hrchy.stats.hits[t][PAGE_1G]);
+        tlb_profile_print(f_out, hrchy.profile, (size_t)strtoul(argv[9], NULL, 10));
+        tlb_profile_free(hrchy.profile);
+    }
+
     /**
      * Garbage collecting
      */
     fclose(f_out);
     free(mem_space);
+    tlb_hrchy_free(&hrchy);
 
     return EXIT_SUCCESS;
 }
@@ -18,9 +18,61 @@
 #include "list.h"
 #include "tlb.h"
 #include "tlb_mng.h"
+#include "tlb_profile.h"
 
 #include <inttypes.h> // for PRIx macros
 
+// ======================================================================
+static void print_tlb(FILE* f_out, const tlb_entry_t* tlb, const replacement_policy_t* replacement_policy)
+{
+    for (size_t tlb_line_index = 0; tlb_line_index < TLB_LINES; tlb_line_index++) {
+        fprintf(f_out, "%d; %"PRIx64"; %05X;\n",
+                tlb_entry_live(tlb[tlb_line_index], replacement_policy),
+                (uint64_t) tlb[tlb_line_index].tag,
+                tlb[tlb_line_index].phy_page_num
+               );
+    }
+    print_list(f_out, replacement_policy->ll);
+}
+
+// ======================================================================
+static void print_invalidation(FILE* f_out, const command_t* command, uint16_t asid)
+{
+    switch (command->scope) {
+    case INVAL_PAGE:
+        fprintf(f_out, "PAGE @0x%016" PRIX64 " (ASID 0x%04" PRIX16 ")\n", virt_addr_t_to_uint64_t(&command->vaddr), asid);
+        break;
+    case INVAL_RANGE:
+        fprintf(f_out, "RANGE [0x%016" PRIX64 ", 0x%016" PRIX64 ") (ASID 0x%04" PRIX16 ")\n",
+                virt_addr_t_to_uint64_t(&command->vaddr), command->vaddr_end, asid);
+        break;
+    case INVAL_ASID:
+        fprintf(f_out, "ASID 0x%04" PRIX16 "\n", asid);
+        break;
+    default:
+        fprintf(f_out, "ALL\n");
+        break;
+    }
+}
+
+// ======================================================================
+static int invalidate(tlb_entry_t* tlb, replacement_policy_t* replacement_policy,
+                      uint16_t asid, const command_t* command)
+{
+    switch (command->scope) {
+    case INVAL_PAGE:
+        return tlb_invalidate_page(tlb, replacement_policy, asid, &command->vaddr);
+    case INVAL_RANGE:
+        return tlb_invalidate_range(tlb, replacement_policy, asid,
+                                    virt_addr_t_to_uint64_t(&command->vaddr), command->vaddr_end);
+    case INVAL_ASID:
+        return tlb_invalidate_asid(tlb, replacement_policy, asid);
+    default:
+        return tlb_invalidate_all(tlb, replacement_policy);
+    }
+}
+
+// ======================================================================
 int main(int argc, char* argv[])
 {
     if (argc < 4) {
@@ -28,8 +80,18 @@ int main(int argc, char* argv[])
         fprintf(stderr, "\t- one (txt) to read commands from;\n");
         fprintf(stderr, "\t- one (bin) to memory content from;\n");
         fprintf(stderr, "\t- one to write output to.\n");
+        fprintf(stderr, "and optionally what context switches do: tagged (default) or flush,\n");
+        fprintf(stderr, "and the replacement policy: lru (default), fifo, random, clock or plru,\n");
+        fprintf(stderr, "and the number N of pages and regions with the most misses to report, after the hits per page size (none by default).\n");
+        return 1;
+    }
+    const int flush_on_switch = argc > 4 && !strcmp(argv[4], "flush");
+    replacement_kind_t kind = REPL_LRU;
+    if (argc > 5 && replacement_kind_parse(argv[5], &kind) != ERR_NONE) {
+        fprintf(stderr, "Unknown replacement policy \"%s\".\n", argv[5]);
         return 1;
     }
+    const size_t top = argc > 6 ? (size_t)strtoul(argv[6], NULL, 10) : 0;
 
     program_t pgm;
     if (program_read(argv[1], &pgm) != ERR_NONE) {
@@ -63,6 +125,13 @@ int main(int argc, char* argv[])
         (void)push_back(&ll, &line_index);
     }
 
+    // hash index of the TLB entries, for O(1) lookups
+    tlb_index_t index;
+    if (tlb_index_init(&index, tlb, &ll) != ERR_NONE) {
+        fprintf(stderr, "Cannot build the TLB index.");
+        return 5;
+    }
+
     /*
     * Create the object replacement policy.
     *
@@ -70,16 +139,62 @@ int main(int argc, char* argv[])
     replacement_policy_t replacement_policy = {
         .ll             = &ll,
         .move_back      = move_back,
-        .push_back      = push_back
+        .push_back      = push_back,
+        .index          = &index
     };
+    replacement_policy_init(&replacement_policy, kind);
+
+    // attribution of the misses to pages, if a report is asked for
+    tlb_profile_t profile;
+    tlb_stats_t stats;
+    zero_init_var(stats);
+    if (argc > 6) {
+        if (tlb_profile_init(&profile) != ERR_NONE) {
+            fprintf(stderr, "Cannot allocate the TLB profile.");
+            return 5;
+        }
+        stats.profile = &profile;
+    }
 
     phy_addr_t paddr;
     zero_init_var(paddr);
+    addr_space_t space = ADDR_SPACE_DEFAULT;
 
     for (size_t prog_line_index = 0; prog_line_index < pgm.nb_lines; prog_line_index++) {
 
+        const command_t* command = &pgm.listing[prog_line_index];
+        if (command->order == SWITCH) {
+            // untagged TLB (always ASID 0) flushed on every switch, or tagged TLB
+            space.asid = flush_on_switch ? 0 : command->asid;
+            space.pgd = command->pgd;
+            if (flush_on_switch) {
+                tlb_flush(tlb);
+                tlb_invalidate_all(tlb, &replacement_policy); // the policy refills every line first
+                tlb_index_init(&index, tlb, &ll);
+            }
+            fprintf(f_out, "-------------------------------------------------------------------\n");
+            fprintf(f_out, "Program line " SIZE_T_FMT ": CONTEXT SWITCH to ASID 0x%04" PRIX16 " (PGD @0x%08" PRIX32 ")\n",
+                    prog_line_index, command->asid, command->pgd);
+            fprintf(f_out, "%s\n", flush_on_switch ? "FLUSH..." : "TAGGED...");
+            continue;
+        }
+        if (command->order == INVALIDATE) {
+            fprintf(f_out, "-------------------------------------------------------------------\n");
+            fprintf(f_out, "Program line " SIZE_T_FMT ": INVALIDATE ", prog_line_index);
+            print_invalidation(f_out, command, space.asid);
+            int err = invalidate(tlb, &replacement_policy, space.asid, command);
+            if (err == ERR_NONE) {
+                fputc('\n', f_out);
+                print_tlb(f_out, tlb, &replacement_policy);
+            } else {
+                fprintf(f_out, "error with tlb_invalidate(): %s\n", ERR_MESSAGES[err - ERR_NONE]);
+            }
+            fprintf(f_out, "-------------------------------------------------------------------\n");
+            continue;
+        }
+
         int hit = 0;
-        int err = tlb_search(mem_space, &(pgm.listing[prog_line_index].vaddr), &paddr, tlb, &replacement_policy, &hit);
+        int err = tlb_search_in(mem_space, &space, &(command->vaddr), &paddr, tlb, &replacement_policy, &hit, &stats);
         fprintf(f_out, "-------------------------------------------------------------------\n");
         fprintf(f_out, "After program line " SIZE_T_FMT "...\n\n", prog_line_index);
         fprintf(f_out, "VA = ");
@@ -91,20 +206,20 @@ int main(int argc, char* argv[])
             if (hit) fprintf(f_out, "HIT...\n\n");
             else fprintf(f_out, "MISS...\n\n");
 
-            for (size_t tlb_line_index = 0; tlb_line_index < TLB_LINES; tlb_line_index++) {
-                fprintf(f_out, "%d; %"PRIx64"; %05X;\n",
-                        tlb[tlb_line_index].v,
-                        (uint64_t) tlb[tlb_line_index].tag,
-                        tlb[tlb_line_index].phy_page_num
-                       );
-            }
-            print_list(f_out, &ll);
+            print_tlb(f_out, tlb, &replacement_policy);
         } else {
             fprintf(f_out, "error with tlb_search(): %s\n", ERR_MESSAGES[err - ERR_NONE]);
         }
         fprintf(f_out, "-------------------------------------------------------------------\n");
     }
 
+    if (stats.profile != NULL) {
+        fprintf(f_out, "\nTLB HITS: 4 kiB %" PRIu64 "; 2 MiB %" PRIu64 "; 1 GiB %" PRIu64 "; MISSES: %" PRIu64 "\n",
+                stats.hits[PAGE_4K], stats.hits[PAGE_2M], stats.hits[PAGE_1G], stats.misses);
+        tlb_profile_print(f_out, stats.profile, top);
+        tlb_profile_free(stats.profile);
+    }
+
     /**
      * Garbage collecting
      */
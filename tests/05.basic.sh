@@ -58,5 +58,57 @@ R I @0x000000000000001C
 R DW @0x0000000040000004 
 R I @0x0000000000000020"
 
+printf "Test %1d (test-command 3): " $((++test))
+check_output test-commands commands03.txt \
+"R I @0x0000000000000000 
+R DW @0x0000000000200000 
+C 0x0001 @0x00000000
+R I @0x0000000000000000 
+R DW @0x0000000000200000 
+C 0x0000 @0x00000000
+R I @0x0000000000000004 
+R DW @0x0000000000200004"
+
+printf "Test %1d (test-command 4): " $((++test))
+check_output test-commands commands06.txt \
+"R DW @0x0000000000001000 
+R DW @0x0000000000002000 
+R I @0x0000000000000000 
+R DW @0x0000000000003000 
+F @0x0000000000002010
+R DW @0x0000000000002000 
+F @0x0000000000001000 @0x0000000000003000
+R DW @0x0000000000003000 
+R DW @0x0000000000001000 
+C 0x0001 @0x00000000
+R DW @0x0000000000004000 
+F ASID
+C 0x0000 @0x00000000
+R DW @0x0000000000003000 
+R DW @0x0000000000004000 
+F ALL
+R DW @0x0000000000003000 
+R I @0x0000000000000000"
+
+printf "Test %1d (test-command 5): " $((++test))
+check_output test-commands commands11.txt \
+"T5 1: R DW @0x0000000000002000
+T10 R DW @0x0000000000000000
+T20 R DW @0x0000000000000400
+T30 R DW @0x0000000000000800
+T40 R DW @0x0000000000000C00
+T50 R DW @0x0000000000001000
+T55 1: R DW @0x0000000000002400
+T56 1: R DW @0x0000000000000000
+T57 1: R DW @0x0000000000002800
+T58 1: R DW @0x0000000000002C00
+T59 1: R DW @0x0000000000003000
+T60 R DW @0x0000000000000000
+T70 W DW 0x0000BEEF @0x0000000000000004
+T75 1: R DW @0x0000000000000004
+T80 R DW @0x0000000000000004
+T90 1: F ALL
+T95 1: R DW @0x0000000000002000"
+
 # ======================================================================
 echo "SUCCESS"
@@ -24,7 +24,7 @@ check_output_with_file() {
     
     mytmp1="$(new_tmp_file)"
     mytmp2="$(new_tmp_file)"
-    "$1" "$cmdfile" "$memfile" "$mytmp1" 2>"$mytmp2"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" 2>"$mytmp2"
     # we don't do anything with stderr yet, but may be useful sometime
 
     diff -w "$mytmp1" "$refoutput" \
@@ -33,10 +33,98 @@ check_output_with_file() {
             exit 1)
 }
 
+# same, only comparing the sequence of hits and misses (TLB contents omitted)
+check_hits_with_file() {
+
+    checkX "Test TLB full associative" "$1"
+
+    ref='tests/files'
+    cmdfile="${ref}/$2"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    refoutput="${ref}/$4"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    mytmp1="$(new_tmp_file)"
+    mytmp2="$(new_tmp_file)"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" 2>"$mytmp2"
+
+    diff -w <(grep -E '^(HIT|MISS)' "$mytmp1") "$refoutput" \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# same, only comparing the miss profile printed at the end of the output
+check_profile_with_file() {
+
+    checkX "Test TLB full associative" "$1"
+
+    ref='tests/files'
+    cmdfile="${ref}/$2"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    refoutput="${ref}/$4"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    mytmp1="$(new_tmp_file)"
+    mytmp2="$(new_tmp_file)"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" 2>"$mytmp2"
+
+    diff -w <(sed -n '/^TLB PROFILE/,$p' "$mytmp1") "$refoutput" \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
 # ======================================================================
 # test test-tlb_simple on a few provided files
 printf "Test %1d (test-tlb_simple 1): " $((++test))
 check_output_with_file test-tlb_simple commands02.txt memory-dump-01.mem output/tlb-simple-01-out.txt
 
+printf "Test %1d (test-tlb_simple 2): " $((++test))
+check_output_with_file test-tlb_simple commands03.txt memory-dump-01.mem output/tlb-simple-02-out.txt tagged
+
+printf "Test %1d (test-tlb_simple 3): " $((++test))
+check_output_with_file test-tlb_simple commands03.txt memory-dump-01.mem output/tlb-simple-03-out.txt flush
+
+printf "Test %1d (test-tlb_simple 4): " $((++test))
+check_output_with_file test-tlb_simple commands06.txt memory-dump-02.mem output/tlb-simple-04-out.txt
+
+printf "Test %1d (test-tlb_simple 5): " $((++test))
+check_hits_with_file test-tlb_simple commands07.txt memory-dump-03.mem output/tlb-simple-05-hits.txt tagged lru
+
+printf "Test %1d (test-tlb_simple 6): " $((++test))
+check_hits_with_file test-tlb_simple commands07.txt memory-dump-03.mem output/tlb-simple-06-hits.txt tagged fifo
+
+printf "Test %1d (test-tlb_simple 7): " $((++test))
+check_hits_with_file test-tlb_simple commands07.txt memory-dump-03.mem output/tlb-simple-07-hits.txt tagged random
+
+printf "Test %1d (test-tlb_simple 8): " $((++test))
+check_hits_with_file test-tlb_simple commands07.txt memory-dump-03.mem output/tlb-simple-08-hits.txt tagged clock
+
+printf "Test %1d (test-tlb_simple 9): " $((++test))
+check_hits_with_file test-tlb_simple commands07.txt memory-dump-03.mem output/tlb-simple-09-hits.txt tagged plru
+
+printf "Test %1d (test-tlb_simple 10): " $((++test))
+check_profile_with_file test-tlb_simple commands08.txt memory-dump-03.mem output/tlb-simple-10-profile.txt tagged lru 2
+
+# 2 MiB and 1 GiB pages: walks stopping at the PMD/PUD, tags matched on the page size, hits per size
+printf "Test %1d (test-tlb_simple 11): " $((++test))
+check_output_with_file test-tlb_simple commands17.txt memory-dump-04.mem output/tlb-simple-11-out.txt tagged lru 0
+
+# the line freed by an invalidation is refilled before any live one is evicted
+printf "Test %1d (test-tlb_simple 12): " $((++test))
+check_hits_with_file test-tlb_simple commands18.txt memory-dump-03.mem output/tlb-simple-12-hits.txt tagged lru
+
+printf "Test %1d (test-tlb_simple 13): " $((++test))
+check_hits_with_file test-tlb_simple commands18.txt memory-dump-03.mem output/tlb-simple-12-hits.txt tagged fifo
+
 # ======================================================================
 echo "SUCCESS"
@@ -24,7 +24,7 @@ check_output_with_file() {
     
     mytmp1="$(new_tmp_file)"
     mytmp2="$(new_tmp_file)"
-    "$1" "$cmdfile" "$memfile" "$mytmp1" 2>"$mytmp2"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" 2>"$mytmp2"
     # we don't do anything with stderr yet, but may be useful sometime
 
     diff -w "$mytmp1" "$refoutput" \
@@ -33,10 +33,69 @@ check_output_with_file() {
             exit 1)
 }
 
+# same, only comparing the miss profile printed at the end of the output
+check_profile_with_file() {
+
+    checkX "Test TLB hierarchy" "$1"
+
+    ref='tests/files'
+    cmdfile="${ref}/$2"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    refoutput="${ref}/$4"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    mytmp1="$(new_tmp_file)"
+    mytmp2="$(new_tmp_file)"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" 2>"$mytmp2"
+
+    diff -w <(sed -n '/^TLB PROFILE/,$p' "$mytmp1") "$refoutput" \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
 # ======================================================================
 # test test-tlb_simple on a few provided files
 printf "Test %1d (test-tlb_hrchy 1): " $((++test))
 check_output_with_file test-tlb_hrchy commands02.txt memory-dump-01.mem output/tlb-hrchy-01-out.txt
 
+printf "Test %1d (test-tlb_hrchy 2): " $((++test))
+check_output_with_file test-tlb_hrchy commands02.txt memory-dump-01.mem output/tlb-hrchy-02-out.txt 4x4:plru 16x4
+
+printf "Test %1d (test-tlb_hrchy 3): " $((++test))
+check_output_with_file test-tlb_hrchy commands03.txt memory-dump-01.mem output/tlb-hrchy-03-out.txt 4x4 16x4 tagged
+
+printf "Test %1d (test-tlb_hrchy 4): " $((++test))
+check_output_with_file test-tlb_hrchy commands03.txt memory-dump-01.mem output/tlb-hrchy-04-out.txt 4x4 16x4 flush
+
+printf "Test %1d (test-tlb_hrchy 5): " $((++test))
+check_output_with_file test-tlb_hrchy commands04.txt memory-dump-02.mem output/tlb-hrchy-05-out.txt 4x4 16x4 tagged stride:2
+
+printf "Test %1d (test-tlb_hrchy 6): " $((++test))
+check_output_with_file test-tlb_hrchy commands04.txt memory-dump-02.mem output/tlb-hrchy-06-out.txt 4x4 16x4 tagged seq:2:buf4
+
+printf "Test %1d (test-tlb_hrchy 7): " $((++test))
+check_output_with_file test-tlb_hrchy commands05.txt memory-dump-02.mem output/tlb-hrchy-07-out.txt 1x2 1x4 tagged none incl
+
+printf "Test %1d (test-tlb_hrchy 8): " $((++test))
+check_output_with_file test-tlb_hrchy commands05.txt memory-dump-02.mem output/tlb-hrchy-08-out.txt 1x2 1x4 tagged none excl
+
+printf "Test %1d (test-tlb_hrchy 9): " $((++test))
+check_output_with_file test-tlb_hrchy commands05.txt memory-dump-02.mem output/tlb-hrchy-09-out.txt 1x2 1x4 tagged none nine
+
+printf "Test %1d (test-tlb_hrchy 10): " $((++test))
+check_output_with_file test-tlb_hrchy commands06.txt memory-dump-02.mem output/tlb-hrchy-10-out.txt 4x4 16x4 tagged
+
+printf "Test %1d (test-tlb_hrchy 11): " $((++test))
+check_profile_with_file test-tlb_hrchy commands08.txt memory-dump-03.mem output/tlb-hrchy-11-profile.txt 1x1 16x4 tagged none incl 2
+
+# 2 MiB and 1 GiB pages: walks stopping at the PMD/PUD, tags matched on the page size, hits per size
+printf "Test %1d (test-tlb_hrchy 12): " $((++test))
+check_output_with_file test-tlb_hrchy commands17.txt memory-dump-04.mem output/tlb-hrchy-12-out.txt 4x4 16x4 tagged none incl 0
+
 # ======================================================================
 echo "SUCCESS"
@@ -32,10 +32,83 @@ check_output_with_file() {
             exit 1)
 }
 
+# same, only comparing the last line (statistics) to the expected one
+check_summary() {
+
+    checkX "Test Cache hierarchy" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    EXPECTED_OUTPUT="${6}"
+
+    mytmp="$(new_tmp_file)"
+    ACTUAL_OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" "$5" 2>"$mytmp" | tail -n 1 || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(echo -e "$EXPECTED_OUTPUT") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            echo -e "Expected:\n$EXPECTED_OUTPUT"; \
+            echo -e "Actual:\n$ACTUAL_OUTPUT"; \
+            exit 1)
+}
+
+# parallel simulation: same final caches and statistics as the serial one
+check_parallel() {
+
+    checkX "Test Cache hierarchy" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    mytmp="$(new_tmp_file)"
+    ACTUAL_OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" "$5" "$6" 2>"$mytmp" || cat "$mytmp")"
+    EXPECTED_OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" "$5" 2>"$mytmp" \
+                       | tail -n "$(echo "$ACTUAL_OUTPUT" | wc -l)" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(echo "$EXPECTED_OUTPUT") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
 # ======================================================================
 # test test-tlb_simple on a few provided files
 printf "Test %1d (test-cache 1): " $((++test))
 check_output_with_file test-cache dump memory-dump-01.mem commands01.txt output/cache-01-out.txt
 
+printf "Test %1d (test-cache 2): " $((++test))
+check_summary test-cache dump memory-dump-01.mem commands02.txt pipt \
+"INDEXING: pipt; L1I HITS: 6; L1D HITS: 4; L2 HITS: 0; MISSES: 6; CYCLES: 708"
+
+printf "Test %1d (test-cache 3): " $((++test))
+check_summary test-cache dump memory-dump-01.mem commands02.txt vipt \
+"INDEXING: vipt; L1I HITS: 6; L1D HITS: 4; L2 HITS: 0; MISSES: 6; CYCLES: 692"
+
+printf "Test %1d (test-cache 4): " $((++test))
+check_parallel test-cache dump memory-dump-01.mem commands02.txt vipt 3
+
+# a write into the PTE table remaps the page: the next read must not hit the old frame
+printf "Test %1d (test-cache 5): " $((++test))
+check_summary test-cache dump memory-dump-01.mem commands16.txt pipt \
+"INDEXING: pipt; L1I HITS: 0; L1D HITS: 0; L2 HITS: 0; MISSES: 3; CYCLES: 339"
+
+printf "Test %1d (test-cache 6): " $((++test))
+check_parallel test-cache dump memory-dump-01.mem commands16.txt pipt 2
+
+printf "Test %1d (test-cache 7): " $((++test))
+check_parallel test-cache dump memory-dump-03.mem commands09.txt pipt 4
+
+printf "Test %1d (test-cache 8): " $((++test))
+check_parallel test-cache dump memory-dump-03.mem commands12.txt pipt 64
+
 # ======================================================================
 echo "SUCCESS"
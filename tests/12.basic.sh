@@ -0,0 +1,44 @@
+#!/bin/bash
+
+## Basic tests for trace pre-translation
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_output_with_file() {
+
+    checkX "Trace pre-translation" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected memory file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    refoutput="${ref}/$5"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    mytmp1="$(new_tmp_file)"
+    mytmp2="$(new_tmp_file)"
+    "$1" "$2" "$memfile" "$cmdfile" "$mytmp1" $6 2>"$mytmp2"
+
+    diff -w "$mytmp1" "$refoutput" \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ======================================================================
+# test pretranslate on a few provided files
+printf "Test %1d (pretranslate dump, 1 thread): " $((++test))
+check_output_with_file pretranslate dump memory-dump-01.mem commands02.txt output/pretranslate-01-out.txt 1
+
+printf "Test %1d (pretranslate desc, 4 threads): " $((++test))
+check_output_with_file pretranslate desc memory-desc-01.txt commands02.txt output/pretranslate-01-out.txt 4
+
+# ======================================================================
+echo "SUCCESS"
@@ -0,0 +1,50 @@
+#!/bin/bash
+
+## Basic tests for precompiled memory images
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_output_with_image() {
+
+    checkX "Memory image" mkimage
+    checkX "Test Memory" test-memory
+
+    ref='tests/files'
+    memfile="${ref}/$2"
+    [ -f "$memfile" ] || error "Expected memory file \"$memfile\" not found."
+
+    refoutput="${ref}/$3"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    image="$(new_tmp_file)"
+    mytmp="$(new_tmp_file)"
+    mkimage "$1" "$memfile" "$image" 2>"$mytmp" || (cat "$mytmp"; echo "FAIL"; exit 1)
+
+    shift 3
+    # gets stdout in case of success, stderr in case of error
+    ACTUAL_OUTPUT="$(test-memory img "$image" "$@" 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ======================================================================
+sep=' '
+
+printf "Test %1d (image from dump  #1 addr 0x0): " $((++test))
+check_output_with_image dump memory-dump-01.mem output/memory-01-out.txt o "$sep" 0x0
+
+printf "Test %1d (image from desc. #1 addr 0x0): " $((++test))
+check_output_with_image desc memory-desc-01.txt output/memory-01-out.txt o "$sep" 0x0
+
+printf "Test %1d (image from desc. #2 addr 0x8000000000): " $((++test))
+check_output_with_image desc memory-desc-02.txt output/memory-02-B-out.txt o "$sep" 0x8000000000
+
+# ======================================================================
+echo "SUCCESS"
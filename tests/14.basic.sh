@@ -0,0 +1,63 @@
+#!/bin/bash
+
+## Basic tests for the multi-core simulation
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_output_with_file() {
+
+    checkX "Multi-core simulation" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    refoutput="${ref}/$5"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    cmdfiles=()
+    for cmdfile in "${@:6}"; do
+        [ -f "${ref}/$cmdfile" ] || error "Expected command file \"${ref}/$cmdfile\" not found."
+        cmdfiles+=("${ref}/$cmdfile")
+    done
+
+    mytmp="$(new_tmp_file)"
+    # gets stdout in case of success, stderr in case of error
+    # ($4: the interleaving, optionally followed by the coherence protocol and the L2 banks)
+    ACTUAL_OUTPUT="$("$1" "$2" "$memfile" $4 "${cmdfiles[@]}" 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ======================================================================
+# test test-multicore on a few provided files
+printf "Test %1d (test-multicore 1): " $((++test))
+check_output_with_file test-multicore dump memory-dump-03.mem rr output/multicore-01-out.txt commands09.txt commands10.txt
+
+printf "Test %1d (test-multicore 2): " $((++test))
+check_output_with_file test-multicore dump memory-dump-03.mem ts output/multicore-02-out.txt commands09.txt commands10.txt
+
+printf "Test %1d (test-multicore 3): " $((++test))
+check_output_with_file test-multicore dump memory-dump-03.mem ts output/multicore-02-out.txt commands11.txt
+
+printf "Test %1d (test-multicore 4): " $((++test))
+check_output_with_file test-multicore dump memory-dump-03.mem "ts mesi" output/multicore-03-out.txt commands12.txt
+
+printf "Test %1d (test-multicore 5): " $((++test))
+check_output_with_file test-multicore dump memory-dump-03.mem "ts moesi" output/multicore-04-out.txt commands12.txt
+
+printf "Test %1d (test-multicore 6): " $((++test))
+check_output_with_file test-multicore dump memory-dump-03.mem "ts banks=1x1:30:2" output/multicore-05-out.txt commands14.txt
+
+printf "Test %1d (test-multicore 7): " $((++test))
+check_output_with_file test-multicore dump memory-dump-03.mem "ts banks=4x1:30:2" output/multicore-06-out.txt commands14.txt
+
+# ======================================================================
+echo "SUCCESS"
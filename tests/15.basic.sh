@@ -0,0 +1,50 @@
+#!/bin/bash
+
+## Basic tests for the parameter sweep
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_output_with_file() {
+
+    checkX "Parameter sweep" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    configfile="${ref}/$5"
+    [ -f "$configfile" ] || error "Expected configuration file \"$configfile\" not found."
+
+    refoutput="${ref}/$6"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    mytmp="$(new_tmp_file)"
+    # gets stdout in case of success, stderr in case of error
+    ACTUAL_OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" "$configfile" $7 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ======================================================================
+# test sweep on a few provided files
+printf "Test %1d (sweep, 1 thread): " $((++test))
+check_output_with_file sweep dump memory-dump-01.mem commands02.txt sweep-configs-01.txt output/sweep-01-out.txt 1
+
+printf "Test %1d (sweep, 4 threads): " $((++test))
+check_output_with_file sweep dump memory-dump-01.mem commands02.txt sweep-configs-01.txt output/sweep-01-out.txt 4
+
+printf "Test %1d (sweep with writes, 3 threads): " $((++test))
+check_output_with_file sweep dump memory-dump-03.mem commands09.txt sweep-configs-01.txt output/sweep-02-out.txt 3
+
+# ======================================================================
+echo "SUCCESS"
@@ -0,0 +1,171 @@
+#!/bin/bash
+
+## Basic tests for the simulator context, run serially, pipelined,
+## interleaved with a second one, sampled, and with L2 set sampling
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_summary() {
+
+    checkX "Simulator" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    EXPECTED_OUTPUT="${7}"
+
+    mytmp="$(new_tmp_file)"
+    # gets stdout in case of success, stderr in case of error
+    # ($8, if any: the sampling)
+    ACTUAL_OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" "$5" "$6" ${8:+"$8"} 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(echo -e "$EXPECTED_OUTPUT") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            echo -e "Expected:\n$EXPECTED_OUTPUT"; \
+            echo -e "Actual:\n$ACTUAL_OUTPUT"; \
+            exit 1)
+}
+
+# checks that each L2 set simulated with 1 set out of $5 shows the same L1
+# misses and L2 hits as in the full simulation: the estimated L2 hit rate is
+# then exact on the sets it is computed from
+check_l2_sets() {
+
+    checkX "Simulator" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    FULL="$("$1" "$2" "$memfile" "$cmdfile" serial "" "" sets 2>&1 | grep '^L2 SET')"
+    SAMPLED="$("$1" "$2" "$memfile" "$cmdfile" serial "l2sample=$5" "" sets 2>&1 | grep '^L2 SET')"
+    DIFFERENT="$(grep -vxF -f <(echo "$FULL") <(echo "$SAMPLED") || true)"
+
+    [ "$(echo "$SAMPLED" | wc -l)" -eq $((512 / $5)) ] && [ -z "$DIFFERENT" ] \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            echo -e "Sampled sets differing from the full simulation:\n$DIFFERENT"; \
+            exit 1)
+}
+
+# checks how many of the 95% confidence intervals of the L2 hit rate, with
+# 1 L2 set out of 2, 4, ..., 256 simulated, miss the rate of the full
+# simulation: about 5% of them are expected to; more than $5 of these 8
+# (for $5 = 2: a chance below 1% at a true 95% level) fails
+check_l2_intervals() {
+
+    checkX "Simulator" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" serial "" 2>&1)"
+    for n in 2 4 8 16 32 64 128 256; do
+        OUTPUT="$(printf "%s\n%s\n" "$OUTPUT" "$("$1" "$2" "$memfile" "$cmdfile" serial "l2sample=$n" 2>&1)")"
+    done
+    # fields of the full run: L2 HITS and MISSES; of the sampled ones: the rate and its error
+    MISSED="$(echo "$OUTPUT" | awk '
+        /^ACCESSES/ && !full { full = 1; gsub(";", ""); true_rate = 100 * $11 / ($11 + $13) }
+        /^L2 SAMPLING/       { gsub("[;%]", ""); n++;
+                               if (true_rate < $(NF-2) - $NF || true_rate > $(NF-2) + $NF) missed++ }
+        END { print (n == 8 ? missed + 0 : "none") }')"
+
+    [ "$MISSED" != "none" ] && [ "$MISSED" -le "$5" ] \
+        && echo "PASS ($MISSED missed)" \
+        || (echo "FAIL ($MISSED missed)"; \
+            echo -e "$OUTPUT"; \
+            exit 1)
+}
+
+# ======================================================================
+# test test-sim on a few provided files
+printf "Test %1d (test-sim serial): " $((++test))
+check_summary test-sim dump memory-dump-01.mem commands02.txt serial "" \
+"ACCESSES: 16; L1I HITS: 6; L1D HITS: 4; L2 HITS: 0; MISSES: 6; TLB WALKS: 15; CYCLES: 708"
+
+printf "Test %1d (test-sim pipelined): " $((++test))
+check_summary test-sim dump memory-dump-01.mem commands02.txt pipelined "" \
+"ACCESSES: 16; L1I HITS: 6; L1D HITS: 4; L2 HITS: 0; MISSES: 6; TLB WALKS: 15; CYCLES: 708"
+
+printf "Test %1d (test-sim serial, several batches): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands13.txt serial "l1tlb=4x4 indexing=vipt" \
+"ACCESSES: 600; L1I HITS: 4; L1D HITS: 66; L2 HITS: 14; MISSES: 516; TLB WALKS: 4; CYCLES: 58100"
+
+printf "Test %1d (test-sim pipelined, several batches): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands13.txt pipelined "l1tlb=4x4 indexing=vipt" \
+"ACCESSES: 600; L1I HITS: 4; L1D HITS: 66; L2 HITS: 14; MISSES: 516; TLB WALKS: 4; CYCLES: 58100"
+
+printf "Test %1d (test-sim interleaved): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands13.txt interleaved "l1tlb=4x4 indexing=vipt" \
+"ACCESSES: 600; L1I HITS: 4; L1D HITS: 66; L2 HITS: 14; MISSES: 516; TLB WALKS: 4; CYCLES: 58100\n\
+ACCESSES: 600; L1I HITS: 4; L1D HITS: 66; L2 HITS: 14; MISSES: 516; TLB WALKS: 4; CYCLES: 58100"
+
+printf "Test %1d (test-sim sampled, windows covering everything): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands15.txt sampled "" \
+"SAMPLED: WINDOWS: 100; COMMANDS: 5000; DETAILED: 5000; EARLY STOP: no\n\
+WINDOWS: ACCESSES: 5000; L1I HITS: 2345; L1D HITS: 805; L2 HITS: 1041; MISSES: 809; TLB WALKS: 4; CYCLES: 114400\n\
+L1 MISS RATE: 37.00% +- 2.06%\n\
+MISS RATE: 16.18% +- 3.57%\n\
+CYCLES PER ACCESS: 22.88 +- 3.74" "period=50 window=50"
+
+printf "Test %1d (test-sim sampled, warm fast-forward): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands15.txt sampled "" \
+"SAMPLED: WINDOWS: 20; COMMANDS: 5000; DETAILED: 5000; EARLY STOP: no\n\
+WINDOWS: ACCESSES: 1000; L1I HITS: 499; L1D HITS: 165; L2 HITS: 192; MISSES: 144; TLB WALKS: 0; CYCLES: 20760\n\
+L1 MISS RATE: 33.60% +- 4.23%\n\
+MISS RATE: 14.40% +- 7.28%\n\
+CYCLES PER ACCESS: 20.76 +- 7.61" "period=250 window=50 ff=warm"
+
+printf "Test %1d (test-sim sampled, skipping, early stop): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands15.txt sampled "" \
+"SAMPLED: WINDOWS: 5; COMMANDS: 1250; DETAILED: 500; EARLY STOP: yes\n\
+WINDOWS: ACCESSES: 250; L1I HITS: 99; L1D HITS: 22; L2 HITS: 0; MISSES: 129; TLB WALKS: 0; CYCLES: 14940\n\
+L1 MISS RATE: 51.60% +- 4.54%\n\
+MISS RATE: 51.60% +- 4.54%\n\
+CYCLES PER ACCESS: 59.76 +- 4.99" "period=250 window=50 warmup=50 ff=skip target=10 min=5"
+
+printf "Test %1d (test-sim serial, 1 L2 set in 8): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands15.txt serial "l2sample=8" \
+"ACCESSES: 5000; L1I HITS: 2345; L1D HITS: 805; L2 HITS: 1012; MISSES: 838; TLB WALKS: 4; CYCLES: 117300\n\
+L2 SAMPLING: 64 OF 512 SETS; L1 MISSES: 1850 (223 SIMULATED); L2 HIT RATE: 54.71% +- 4.80%"
+
+printf "Test %1d (test-sim pipelined, 1 L2 set in 32): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands15.txt pipelined "l2sample=32" \
+"ACCESSES: 5000; L1I HITS: 2345; L1D HITS: 805; L2 HITS: 1018; MISSES: 832; TLB WALKS: 4; CYCLES: 116700\n\
+L2 SAMPLING: 16 OF 512 SETS; L1 MISSES: 1850 (60 SIMULATED); L2 HIT RATE: 55.00% +- 9.02%"
+
+for n in 2 4 8 16 32 64 128 256; do
+    printf "Test %1d (test-sim, 1 L2 set in %d simulated as in the full run): " $((++test)) $n
+    check_l2_sets test-sim dump memory-dump-03.mem commands15.txt $n
+done
+
+# on this trace, only the interval of 1 set in 16 (61.31% +- 4.89%) misses the true 56.27%
+printf "Test %1d (test-sim, L2 hit rate intervals missing the full run): " $((++test))
+check_l2_intervals test-sim dump memory-dump-03.mem commands15.txt 2
+
+printf "Test %1d (test-sim sampled, 1 L2 set in 16): " $((++test))
+check_summary test-sim dump memory-dump-03.mem commands15.txt sampled "l2sample=16" \
+"SAMPLED: WINDOWS: 20; COMMANDS: 5000; DETAILED: 5000; EARLY STOP: no\n\
+WINDOWS: ACCESSES: 1000; L1I HITS: 499; L1D HITS: 165; L2 HITS: 201; MISSES: 135; TLB WALKS: 0; CYCLES: 19860\n\
+L1 MISS RATE: 33.60% +- 4.23%\n\
+MISS RATE: 13.50% +- 8.59%\n\
+CYCLES PER ACCESS: 19.86 +- 8.90" "period=250 window=50 ff=warm"
+
+# ======================================================================
+echo "SUCCESS"
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+## Basic tests for the batches of simulations
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_output_with_file() {
+
+    checkX "Batch of simulations" "$1"
+
+    ref='tests/files'
+    manifest="${ref}/$2"
+    [ -f "$manifest" ] || error "Expected manifest file \"$manifest\" not found."
+
+    refoutput="${ref}/$3"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    mytmp="$(new_tmp_file)"
+    # gets stdout in any case (a failing job makes the tool fail), and stderr in case of error
+    # ($4: the number of threads, the length of the segments, the length of the warm-up)
+    ACTUAL_OUTPUT="$("$1" "$manifest" $4 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ======================================================================
+# test batch on a provided manifest (its last job fails)
+printf "Test %1d (batch, 1 thread): " $((++test))
+check_output_with_file batch batch-manifest-01.txt output/batch-01-out.txt "1"
+
+printf "Test %1d (batch, 4 threads): " $((++test))
+check_output_with_file batch batch-manifest-01.txt output/batch-01-out.txt "4"
+
+printf "Test %1d (batch, segments warmed up by all the commands before them): " $((++test))
+check_output_with_file batch batch-manifest-01.txt output/batch-03-out.txt "8 37 1000"
+
+printf "Test %1d (batch, segments warmed up by some commands): " $((++test))
+check_output_with_file batch batch-manifest-01.txt output/batch-02-out.txt "4 100 100"
+
+# ======================================================================
+echo "SUCCESS"
@@ -12,10 +12,32 @@
 #include <stdint.h>
 
 #define TLB_LINES 128 // the number of entries
+#define TLB_LINES_BITS 7 // log_2(TLB_LINES)
 
+/**
+ * A huge page entry (ps != PAGE_4K) holds the virtual page number and the
+ * physical page number of the first 4 kiB page it maps, i.e. with their
+ * page_size_vpn_bits(ps) low bits cleared.
+ */
 typedef struct tlb_entry
 {
     uint64_t tag : VIRT_PAGE_NUM;
     uint32_t phy_page_num : PHY_PAGE_NUM;
     uint8_t v : 1;
-} tlb_entry_t;
\ No newline at end of file
+    uint8_t ps : 2; // page_size_t of the mapping
+    uint16_t asid;  // address space of the mapping
+    uint32_t gen;   // generation of the TLB it was installed in (see tlb_invalidate_all())
+} tlb_entry_t;
+
+struct tlb_profile;
+
+/**
+ * @brief TLB statistics: hits are counted per size of the page that hit.
+ */
+typedef struct tlb_stats
+{
+    uint64_t hits[NB_PAGE_SIZES];
+    uint64_t misses;
+    struct tlb_profile *profile; // optional (may be NULL): misses per page, see tlb_profile.h
+} tlb_stats_t;
+
@@ -29,11 +29,16 @@
 
 /**
  * L1 ITLB, L1 DTLB, and L2 TLB are all direct-mapped.
+ *
+ * An entry may map a huge page (ps != PAGE_4K): it is then indexed and tagged
+ * with the virtual page number shifted right by page_size_vpn_bits(ps), and
+ * holds the physical page number of the first 4 kiB page it maps.
  */
 typedef struct {
   uint32_t tag : 32; // correcteur could be a #DEFINE
     uint32_t phy_page_num: PHY_PAGE_NUM;
     uint8_t v : 1;
+    uint8_t ps : 2; // page_size_t of the mapping
 }l1_itlb_entry_t;
 
 typedef l1_itlb_entry_t l1_dtlb_entry_t;
@@ -42,6 +47,193 @@ typedef struct {
   uint32_t tag : 30; // correcteur could be a #DEFINE
     uint32_t phy_page_num: PHY_PAGE_NUM;
     uint8_t v : 1;
+    uint8_t ps : 2; // page_size_t of the mapping
 }l2_tlb_entry_t;
 
 typedef enum {L1_ITLB, L1_DTLB, L2_TLB} tlb_t;
+#define NB_TLB_TYPES 3
+
+/**
+ * @brief TLB hierarchy statistics: hits are counted per TLB and per size of
+ * the page that hit; a miss in both levels costs one page walk.
+ */
+typedef struct {
+    uint64_t hits[NB_TLB_TYPES][NB_PAGE_SIZES];
+    uint64_t walks;
+    uint64_t context_switches;
+    uint64_t flushes; // full flushes due to context switches
+    uint64_t prefetches;      // translations installed by the prefetcher
+    uint64_t prefetch_hits;   // L2 misses served by the prefetch buffer
+    uint64_t prefetch_useful; // prefetched entries used at least once
+    uint64_t prefetch_useless; // prefetched entries evicted before any use
+    uint64_t back_invalidations; // L1 entries invalidated to keep L2 inclusive
+    uint64_t victim_fills;       // L1 victims moved to an exclusive L2
+} tlb_hrchy_stats_t;
+
+// ======================================================================
+// configurable (set-associative) hierarchy of TLBs
+
+#define TLB_MAX_WAYS 64 // one PLRU bit per way in a uint64_t
+
+/**
+ * @brief replacement policies within a set of a set-associative TLB
+ */
+typedef enum {
+    TLB_REPL_LRU,  // true LRU (last use timestamps)
+    TLB_REPL_PLRU, // bit pseudo-LRU (one MRU bit per way)
+    NB_TLB_REPL
+} tlb_repl_t;
+
+/**
+ * @brief geometry and replacement policy of one TLB of the hierarchy
+ */
+typedef struct {
+    uint32_t sets; // number of sets, a power of 2
+    uint32_t ways; // associativity, from 1 to TLB_MAX_WAYS
+    tlb_repl_t policy;
+} tlb_level_config_t;
+
+/**
+ * @brief what a context switch does to the TLBs
+ */
+typedef enum {
+    TLB_ASID_TAGGED, // entries are tagged with their ASID and kept
+    TLB_ASID_FLUSH,  // all entries are invalidated
+    NB_TLB_ASID_MODES
+} tlb_asid_mode_t;
+
+/**
+ * @brief content of the L2 TLB with respect to the L1 TLBs:
+ *  - inclusive: L2 holds every L1 entry; its victims are back-invalidated in L1;
+ *  - exclusive: L2 is a victim TLB holding L1 victims only; an L2 hit moves
+ *    the entry to L1 (and the L1 victim to L2), walks only fill L1;
+ *  - NINE (non-inclusive non-exclusive): walks fill both, no back-invalidation.
+ */
+typedef enum {
+    TLB_INCLUSIVE,
+    TLB_EXCLUSIVE,
+    TLB_NINE,
+    NB_TLB_INCLUSIONS
+} tlb_inclusion_t;
+
+#define TLB_PREFETCH_MAX_DEGREE 8
+#define TLB_DISTANCE_ENTRIES 64   // entries of the delta-history table, a power of 2
+#define TLB_DISTANCE_PREDICTIONS 2 // next deltas remembered per delta
+
+/**
+ * @brief TLB prefetchers, trained on L2 TLB misses (and first uses of
+ * prefetched entries):
+ *  - sequential: the next pages after the missing one;
+ *  - stride: the next pages along the last stride, once seen twice in a row;
+ *  - distance: the deltas that followed the current delta (between
+ *    consecutive missing pages) in the past.
+ */
+typedef enum {
+    TLB_PREFETCH_NONE,
+    TLB_PREFETCH_SEQUENTIAL,
+    TLB_PREFETCH_STRIDE,
+    TLB_PREFETCH_DISTANCE,
+    NB_TLB_PREFETCHERS
+} tlb_prefetch_t;
+
+/**
+ * @brief prefetcher configuration; prefetched translations go to the L2 TLB,
+ * or to a fully-associative prefetch buffer if buffer_entries is not 0
+ */
+typedef struct {
+    tlb_prefetch_t kind;
+    uint32_t degree;         // pages prefetched per trigger, up to TLB_PREFETCH_MAX_DEGREE
+    uint32_t buffer_entries; // 0 or up to TLB_MAX_WAYS
+} tlb_prefetch_config_t;
+
+/**
+ * @brief configuration of a whole hierarchy, levels indexed by tlb_t
+ */
+typedef struct {
+    tlb_level_config_t level[NB_TLB_TYPES];
+    tlb_asid_mode_t asid_mode;
+    tlb_prefetch_config_t prefetch;
+    tlb_inclusion_t inclusion;
+} tlb_hrchy_config_t;
+
+/**
+ * @brief the (direct-mapped, 16/16/64 lines) hierarchy described above
+ */
+#define TLB_HRCHY_CONFIG_DEFAULT                                   \
+    { .level = {                                                   \
+        [L1_ITLB] = { L1_ITLB_LINES, L1_ITLB_WAYS, TLB_REPL_LRU }, \
+        [L1_DTLB] = { L1_DTLB_LINES, L1_DTLB_WAYS, TLB_REPL_LRU }, \
+        [L2_TLB]  = { L2_TLB_LINES,  L2_TLB_WAYS,  TLB_REPL_LRU }  \
+      },                                                           \
+      .asid_mode = TLB_ASID_TAGGED,                                \
+      .prefetch = { TLB_PREFETCH_NONE, 0, 0 },                     \
+      .inclusion = TLB_INCLUSIVE }
+
+/**
+ * @brief entry of a configurable TLB. The tag is the virtual page number
+ * (shifted right by page_size_vpn_bits(ps)) without its set_bits low bits,
+ * so its width (tag_bits) depends on the number of sets.
+ */
+typedef struct {
+    uint64_t tag;
+    uint32_t phy_page_num: PHY_PAGE_NUM;
+    uint8_t v : 1;
+    uint8_t ps : 2; // page_size_t of the mapping
+    uint8_t prefetched : 1; // installed by the prefetcher and not used yet
+    uint16_t asid;  // address space of the mapping
+    uint32_t gen;   // generation of its TLB when installed
+} tlb_line_t;
+
+/**
+ * @brief one TLB of a configurable hierarchy; lines are stored set after set
+ */
+typedef struct {
+    uint32_t sets;
+    uint32_t ways;
+    uint8_t set_bits; // log_2(sets)
+    uint8_t tag_bits; // VIRT_PAGE_NUM - set_bits
+    tlb_repl_t policy;
+    tlb_line_t *lines; // sets * ways lines
+    uint64_t *stamps;  // LRU: last use of each line
+    uint64_t *mru;     // PLRU: MRU bits of each set
+    uint64_t clock;    // LRU: number of uses so far
+    uint32_t generation; // lines of older generations are invalid (O(1) flush)
+} tlb_level_t;
+
+/**
+ * @brief whether a line of a TLB is valid: its v bit is set and it was
+ * installed in the current generation of the TLB
+ */
+#define tlb_line_live(level, line) ((line)->v && (line)->gen == (level)->generation)
+
+/**
+ * @brief one entry of the delta-history table of the distance prefetcher
+ */
+typedef struct {
+    int64_t delta;
+    int64_t next[TLB_DISTANCE_PREDICTIONS]; // most recent first
+    uint8_t nb_next;
+} tlb_distance_entry_t;
+
+/**
+ * @brief state of the TLB prefetcher
+ */
+typedef struct {
+    uint64_t last_page; // last virtual page number it was trained on
+    int64_t last_delta;
+    uint8_t trained;    // number of pages it was trained on (saturating at 2)
+    tlb_distance_entry_t distances[TLB_DISTANCE_ENTRIES];
+    tlb_level_t buffer; // prefetch buffer: a single set, if configured
+} tlb_prefetcher_t;
+
+/**
+ * @brief a two-level hierarchy of set-associative TLBs, configured at run time
+ */
+typedef struct {
+    tlb_hrchy_config_t config;
+    tlb_level_t level[NB_TLB_TYPES];
+    tlb_prefetcher_t prefetcher;
+    addr_space_t space; // current address space
+    tlb_hrchy_stats_t stats;
+    struct tlb_profile *profile; // optional (NULL after init): L1 misses and walks per page, see tlb_profile.h
+} tlb_hrchy_t;
@@ -3,43 +3,48 @@
 #include "error.h"
 #include "addr_mng.h"
 #include "page_walk.h"
+#include "tlb_profile.h"
+#include <stdlib.h>
+#include <inttypes.h> // for PRIX32
 #define VALID 1
 
-static uint64_t compute_index(virt_addr_t *vaddr, tlb_t type)
+// low virtual page number bits covered by an entry mapping a page of the given size
+#define huge_mask(ps) ((UINT64_C(1) << page_size_vpn_bits(ps)) - 1)
+
+static uint64_t compute_index(const virt_addr_t *vaddr, tlb_t type, page_size_t size)
 {
+    uint64_t page_nbr = virt_addr_t_to_virtual_page_number(vaddr) >> page_size_vpn_bits(size);
     if (type == L1_DTLB || type == L1_ITLB)
     {
-        return virt_addr_t_to_virtual_page_number(vaddr) % L1_ITLB_LINES;
+        return page_nbr % L1_ITLB_LINES;
     }
     else
-        return virt_addr_t_to_virtual_page_number(vaddr) % L2_TLB_LINES;
+        return page_nbr % L2_TLB_LINES;
 }
 
-static uint64_t compute_page_from_tagAndIndex(uint32_t tag, int index, tlb_t type)
+static uint64_t compute_page_from_tagAndIndex(uint32_t tag, int index, tlb_t type, page_size_t size)
 {
     if (type == L1_DTLB || type == L1_ITLB)
     {
-        return ((((uint64_t)tag) << L1_ITLB_LINES_BITS) | index) << PAGE_OFFSET;
+        return (((((uint64_t)tag) << L1_ITLB_LINES_BITS) | index) << page_size_vpn_bits(size)) << PAGE_OFFSET;
     }
     else
-        return ((((uint64_t)tag) << L2_TLB_LINES_BITS) | index) << PAGE_OFFSET;
+        return (((((uint64_t)tag) << L2_TLB_LINES_BITS) | index) << page_size_vpn_bits(size)) << PAGE_OFFSET;
 }
 
-int tlb_entry_init(const virt_addr_t *vaddr,
-                   const phy_addr_t *paddr,
-                   void *tlb_entry,
-                   tlb_t tlb_type)
+static void entry_init_sized(const virt_addr_t *vaddr,
+                             const phy_addr_t *paddr,
+                             void *tlb_entry,
+                             tlb_t tlb_type,
+                             page_size_t size)
 {
-#define init(type, NOB)                                              \
-    ((type *)tlb_entry)->v = VALID;                                  \
-    ((type *)tlb_entry)->phy_page_num = paddr->phy_page_num;         \
-    uint64_t tmp = virt_addr_t_to_virtual_page_number(vaddr) >> NOB; \
+#define init(type, NOB)                                                                                  \
+    ((type *)tlb_entry)->v = VALID;                                                                      \
+    ((type *)tlb_entry)->ps = size;                                                                      \
+    ((type *)tlb_entry)->phy_page_num = paddr->phy_page_num & ~huge_mask(size);                          \
+    uint64_t tmp = (virt_addr_t_to_virtual_page_number(vaddr) >> page_size_vpn_bits(size)) >> NOB;       \
     ((type *)tlb_entry)->tag = tmp;
 
-    M_REQUIRE_NON_NULL(vaddr);
-    M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(tlb_entry);
-
     switch (tlb_type)
     {
     case L1_ITLB:
@@ -60,6 +65,18 @@ int tlb_entry_init(const virt_addr_t *vaddr,
     default:
         break;
     }
+}
+
+int tlb_entry_init(const virt_addr_t *vaddr,
+                   const phy_addr_t *paddr,
+                   void *tlb_entry,
+                   tlb_t tlb_type)
+{
+    M_REQUIRE_NON_NULL(vaddr);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(tlb_entry);
+
+    entry_init_sized(vaddr, paddr, tlb_entry, tlb_type, PAGE_4K);
     return ERR_NONE;
 }
 
@@ -122,20 +139,27 @@ int tlb_insert(uint32_t line_index, // correcteur this function can SEGFAULT
     return ERR_NONE;
 }
 
-int tlb_hit(const virt_addr_t *vaddr,
-            phy_addr_t *paddr,
-            const void *tlb,
-            tlb_t tlb_type)
+// looks vaddr up for each page size (one probe per size, each at its own index)
+static int tlb_hit_sized(const virt_addr_t *vaddr,
+                         phy_addr_t *paddr,
+                         const void *tlb,
+                         tlb_t tlb_type,
+                         page_size_t *size)
 {
-#define hit(type, NOB, NOV)                                                                               \
-    int index = virt_page_nbr % NOV;                                                                      \
-    type tmp = ((type *)tlb)[index];                                                                      \
-    uint64_t computed_virt_page = compute_page_from_tagAndIndex(tmp.tag, index, tlb_type) >> PAGE_OFFSET; \
-    if (computed_virt_page == virt_page_nbr && tmp.v)                                                     \
-    {                                                                                                     \
-        init_phy_addr(paddr, tmp.phy_page_num << PAGE_OFFSET, vaddr->page_offset);                        \
-        return 1;                                                                                         \
-    }                                                                                                     \
+#define hit(type, NOB, NOV)                                                                                      \
+    for (page_size_t s = PAGE_4K; s < NB_PAGE_SIZES; s++)                                                        \
+    {                                                                                                            \
+        int index = (virt_page_nbr >> page_size_vpn_bits(s)) % NOV;                                              \
+        type tmp = ((type *)tlb)[index];                                                                         \
+        uint64_t computed_virt_page = compute_page_from_tagAndIndex(tmp.tag, index, tlb_type, s) >> PAGE_OFFSET; \
+        if (computed_virt_page == (virt_page_nbr & ~huge_mask(s)) && tmp.v && tmp.ps == s)                      \
+        {                                                                                                        \
+            uint32_t phy_page_num = tmp.phy_page_num | (virt_page_nbr & huge_mask(s));                          \
+            init_phy_addr(paddr, phy_page_num << PAGE_OFFSET, vaddr->page_offset);                               \
+            *size = s;                                                                                           \
+            return 1;                                                                                            \
+        }                                                                                                        \
+    }
     M_REQUIRE_NON_NULL_CUSTOM_ERR(vaddr, 0);
     M_REQUIRE_NON_NULL_CUSTOM_ERR(paddr, 0);
     M_REQUIRE_NON_NULL_CUSTOM_ERR(tlb, 0);
@@ -161,6 +185,15 @@ int tlb_hit(const virt_addr_t *vaddr,
     return 0;
 }
 
+int tlb_hit(const virt_addr_t *vaddr,
+            phy_addr_t *paddr,
+            const void *tlb,
+            tlb_t tlb_type)
+{
+    page_size_t size = PAGE_4K;
+    return tlb_hit_sized(vaddr, paddr, tlb, tlb_type, &size);
+}
+
 int tlb_search(const void *mem_space,
                const virt_addr_t *vaddr,
                phy_addr_t *paddr,
@@ -170,38 +203,72 @@ int tlb_search(const void *mem_space,
                l2_tlb_entry_t *l2_tlb,
                int *hit_or_miss)
 {
-#define search(type, not_type, tlb, not_tlb)                                                            \
-    *hit_or_miss = tlb_hit(vaddr, paddr, tlb, type);                                                    \
-    if (*hit_or_miss)                                                                                   \
-        return ERR_NONE;                                                                                \
-    *hit_or_miss = tlb_hit(vaddr, paddr, l2_tlb, L2_TLB);                                               \
-    l1_dtlb_entry_t lvl1;                                                                               \
-    uint64_t tlb1_index = compute_index(vaddr, type);                                                   \
-    if (*hit_or_miss)                                                                                   \
-    {                                                                                                   \
-        tlb_entry_init(vaddr, paddr, &lvl1, type);                                                      \
-        tlb_insert(tlb1_index, &lvl1, tlb, type);                                                       \
-        return ERR_NONE;                                                                                \
-    }                                                                                                   \
-    M_EXIT_IF_ERR(page_walk(mem_space, vaddr, paddr), "error occured while pagewalking in tlb search"); \
-    uint64_t tlb2_index = compute_index(vaddr, L2_TLB);                                                 \
-    l2_tlb_entry_t tmp = l2_tlb[tlb2_index];                                                            \
-    virt_addr_t virt_addr;                                                                              \
-    phy_addr_t phys_addr;                                                                               \
-    init_virt_addr64(&virt_addr, compute_page_from_tagAndIndex(tmp.tag, tlb2_index, L2_TLB));           \
-    int check = tlb_hit(&virt_addr, &phys_addr, not_tlb, not_type);                                     \
-    if (check)                                                                                          \
-    {                                                                                                   \
-        uint64_t lolz = compute_index(&virt_addr, type);                                                \
-        not_tlb[lolz].v = 0;                                                                            \
-    }                                                                                                   \
-    l2_tlb_entry_t lvl2;                                                                                \
-    tlb_entry_init(vaddr, paddr, &lvl2, L2_TLB);                                                        \
-    tlb_insert(tlb2_index, &lvl2, l2_tlb, L2_TLB);                                                      \
-    tlb_entry_init(vaddr, paddr, &lvl1, type);                                                          \
-    tlb_insert(tlb1_index, &lvl1, tlb, type);
-
-    // tlb_hit can hit in l2 even if not in l1, so might remove too often
+    return tlb_search_with_stats(mem_space, vaddr, paddr, access, l1_itlb, l1_dtlb, l2_tlb, hit_or_miss, NULL);
+}
+
+int tlb_search_with_stats(const void *mem_space,
+                          const virt_addr_t *vaddr,
+                          phy_addr_t *paddr,
+                          mem_access_t access,
+                          l1_itlb_entry_t *l1_itlb,
+                          l1_dtlb_entry_t *l1_dtlb,
+                          l2_tlb_entry_t *l2_tlb,
+                          int *hit_or_miss,
+                          tlb_hrchy_stats_t *stats)
+{
+#define count(field) \
+    if (stats != NULL) \
+        stats->field++;
+
+#define search(type, not_type, tlb, not_tlb)                                                                       \
+    page_size_t size = PAGE_4K;                                                                                    \
+    *hit_or_miss = tlb_hit_sized(vaddr, paddr, tlb, type, &size);                                                  \
+    if (*hit_or_miss)                                                                                              \
+    {                                                                                                              \
+        count(hits[type][size]);                                                                                   \
+        return ERR_NONE;                                                                                           \
+    }                                                                                                              \
+    *hit_or_miss = tlb_hit_sized(vaddr, paddr, l2_tlb, L2_TLB, &size);                                             \
+    l1_dtlb_entry_t lvl1;                                                                                          \
+    if (*hit_or_miss)                                                                                              \
+    {                                                                                                              \
+        count(hits[L2_TLB][size]);                                                                                 \
+        entry_init_sized(vaddr, paddr, &lvl1, type, size);                                                         \
+        tlb_insert(compute_index(vaddr, type, size), &lvl1, tlb, type);                                            \
+        return ERR_NONE;                                                                                           \
+    }                                                                                                              \
+    count(walks);                                                                                                  \
+    M_EXIT_IF_ERR(page_walk_sized(mem_space, vaddr, paddr, &size), "error occured while pagewalking in tlb search"); \
+    uint64_t tlb2_index = compute_index(vaddr, L2_TLB, size);                                                      \
+    l2_tlb_entry_t tmp = l2_tlb[tlb2_index];                                                                       \
+    if (tmp.v)                                                                                                     \
+    {                                                                                                              \
+        virt_addr_t virt_addr;                                                                                     \
+        phy_addr_t phys_addr;                                                                                      \
+        page_size_t evicted_size = PAGE_4K;                                                                        \
+        init_virt_addr64(&virt_addr, compute_page_from_tagAndIndex(tmp.tag, tlb2_index, L2_TLB, tmp.ps));          \
+        if (tlb_hit_sized(&virt_addr, &phys_addr, not_tlb, not_type, &evicted_size))                               \
+        {                                                                                                          \
+            uint64_t victim_index = compute_index(&virt_addr, not_type, evicted_size);                             \
+            not_tlb[victim_index].v = 0;                                                                           \
+        }                                                                                                          \
+    }                                                                                                              \
+    l2_tlb_entry_t lvl2;                                                                                           \
+    entry_init_sized(vaddr, paddr, &lvl2, L2_TLB, size);                                                           \
+    tlb_insert(tlb2_index, &lvl2, l2_tlb, L2_TLB);                                                                 \
+    entry_init_sized(vaddr, paddr, &lvl1, type, size);                                                             \
+    tlb_insert(compute_index(vaddr, type, size), &lvl1, tlb, type);
+
+    // fixed geometry and inclusive L2: the other L1 drops its copy of a valid L2 victim;
+    // see tlb_hrchy_search() for the configurable hierarchy and its inclusion policies
+
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(vaddr);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(l1_itlb);
+    M_REQUIRE_NON_NULL(l1_dtlb);
+    M_REQUIRE_NON_NULL(l2_tlb);
+    M_REQUIRE_NON_NULL(hit_or_miss);
 
     switch (access)
     {
@@ -218,3 +285,652 @@ int tlb_search(const void *mem_space,
     }
     return ERR_NONE;
 }
+
+// ======================================================================
+// configurable (set-associative) hierarchy of TLBs
+
+#define line_at(level, set, way) (&(level)->lines[(size_t)(set) * (level)->ways + (way)])
+
+int tlb_level_config_parse(const char *spec, tlb_level_config_t *config)
+{
+    M_REQUIRE_NON_NULL(spec);
+    M_REQUIRE_NON_NULL(config);
+    char *end = NULL;
+    const unsigned long sets = strtoul(spec, &end, 10);
+    M_REQUIRE(end != spec && *end == 'x', ERR_BAD_PARAMETER, "bad TLB geometry \"%s\"", spec);
+    const char *ways_str = end + 1;
+    const unsigned long ways = strtoul(ways_str, &end, 10);
+    M_REQUIRE(end != ways_str, ERR_BAD_PARAMETER, "bad TLB geometry \"%s\"", spec);
+    M_REQUIRE(sets <= UINT32_MAX && ways <= UINT32_MAX, ERR_BAD_PARAMETER, "bad TLB geometry \"%s\"", spec);
+
+    config->sets = (uint32_t)sets;
+    config->ways = (uint32_t)ways;
+    config->policy = TLB_REPL_LRU;
+    if (*end == ':')
+    {
+        if (!strcmp(end + 1, "lru"))
+            config->policy = TLB_REPL_LRU;
+        else if (!strcmp(end + 1, "plru"))
+            config->policy = TLB_REPL_PLRU;
+        else
+            M_EXIT(ERR_BAD_PARAMETER, "unknown TLB replacement policy \"%s\"", end + 1);
+    }
+    else
+        M_REQUIRE(*end == '\0', ERR_BAD_PARAMETER, "bad TLB geometry \"%s\"", spec);
+    return ERR_NONE;
+}
+
+static int level_init(tlb_level_t *level, const tlb_level_config_t *config)
+{
+    M_REQUIRE(config->sets != 0 && (config->sets & (config->sets - 1)) == 0, ERR_BAD_PARAMETER,
+              "number of sets (%u) must be a power of 2", config->sets);
+    M_REQUIRE(config->ways >= 1 && config->ways <= TLB_MAX_WAYS, ERR_BAD_PARAMETER,
+              "number of ways (%u) out of bounds", config->ways);
+    M_REQUIRE(config->policy < NB_TLB_REPL, ERR_BAD_PARAMETER, "unknown policy %d", config->policy);
+
+    memset(level, 0, sizeof(tlb_level_t));
+    level->sets = config->sets;
+    level->ways = config->ways;
+    level->policy = config->policy;
+    while ((UINT32_C(1) << level->set_bits) < level->sets)
+        level->set_bits++;
+    M_REQUIRE(level->set_bits < VIRT_PAGE_NUM, ERR_BAD_PARAMETER, "too many sets (%u)", config->sets);
+    level->tag_bits = VIRT_PAGE_NUM - level->set_bits;
+
+    const size_t nb_lines = (size_t)level->sets * level->ways;
+    level->lines = calloc(nb_lines, sizeof(tlb_line_t));
+    level->stamps = calloc(nb_lines, sizeof(uint64_t));
+    level->mru = calloc(level->sets, sizeof(uint64_t));
+    if (level->lines == NULL || level->stamps == NULL || level->mru == NULL)
+    {
+        free(level->lines);
+        free(level->stamps);
+        free(level->mru);
+        memset(level, 0, sizeof(tlb_level_t));
+        return ERR_MEM;
+    }
+    return ERR_NONE;
+}
+
+static void level_flush(tlb_level_t *level)
+{
+    const size_t nb_lines = (size_t)level->sets * level->ways;
+    memset(level->lines, 0, nb_lines * sizeof(tlb_line_t));
+    memset(level->stamps, 0, nb_lines * sizeof(uint64_t));
+    memset(level->mru, 0, level->sets * sizeof(uint64_t));
+    level->clock = 0;
+    level->generation = 0;
+}
+
+// invalidates all lines in O(1), by starting a new generation; lines are only erased when it wraps
+static void level_invalidate_all(tlb_level_t *level)
+{
+    if (++level->generation == 0)
+        level_flush(level);
+}
+
+// records a use of the given way of the given set
+static void level_touch(tlb_level_t *level, uint32_t set, uint32_t way)
+{
+    switch (level->policy)
+    {
+    case TLB_REPL_LRU:
+        level->stamps[(size_t)set * level->ways + way] = ++level->clock;
+        break;
+    case TLB_REPL_PLRU:
+    {
+        const uint64_t all = level->ways == TLB_MAX_WAYS ? UINT64_MAX : (UINT64_C(1) << level->ways) - 1;
+        level->mru[set] |= UINT64_C(1) << way;
+        if (level->mru[set] == all)
+            level->mru[set] = UINT64_C(1) << way;
+    }
+    break;
+    default:
+        break;
+    }
+}
+
+// way to be replaced in the given set: an invalid one if any, otherwise chosen by the policy
+static uint32_t level_victim(const tlb_level_t *level, uint32_t set)
+{
+    for (uint32_t way = 0; way < level->ways; ++way)
+        if (!tlb_line_live(level, line_at(level, set, way)))
+            return way;
+
+    uint32_t victim = 0;
+    switch (level->policy)
+    {
+    case TLB_REPL_LRU:
+        for (uint32_t way = 1; way < level->ways; ++way)
+            if (level->stamps[(size_t)set * level->ways + way] < level->stamps[(size_t)set * level->ways + victim])
+                victim = way;
+        break;
+    case TLB_REPL_PLRU:
+        while (victim < level->ways - 1 && (level->mru[set] >> victim) & 1)
+            victim++;
+        break;
+    default:
+        break;
+    }
+    return victim;
+}
+
+// looks a virtual page number up for each page size; on hit, returns the line and its set
+static tlb_line_t *level_lookup(const tlb_level_t *level, uint16_t asid, uint64_t virt_page_nbr, uint32_t *set_out, uint32_t *way_out)
+{
+    for (page_size_t s = PAGE_4K; s < NB_PAGE_SIZES; s++)
+    {
+        const uint64_t page_nbr = virt_page_nbr >> page_size_vpn_bits(s);
+        const uint32_t set = (uint32_t)(page_nbr & (level->sets - 1));
+        const uint64_t tag = page_nbr >> level->set_bits;
+        for (uint32_t way = 0; way < level->ways; ++way)
+        {
+            tlb_line_t *line = line_at(level, set, way);
+            if (tlb_line_live(level, line) && line->ps == s && line->tag == tag && line->asid == asid)
+            {
+                *set_out = set;
+                *way_out = way;
+                return line;
+            }
+        }
+    }
+    return NULL;
+}
+
+// installs a translation and returns its line; evicted (if not NULL) gets the entry it replaced
+// (evicted->v is 0 if that line was not live) and evicted_page_nbr its virtual page number
+static tlb_line_t *level_fill(tlb_level_t *level, uint16_t asid, uint64_t virt_page_nbr, uint32_t phy_page_num,
+                              page_size_t size, tlb_line_t *evicted, uint64_t *evicted_page_nbr)
+{
+    const uint64_t page_nbr = virt_page_nbr >> page_size_vpn_bits(size);
+    const uint32_t set = (uint32_t)(page_nbr & (level->sets - 1));
+    const uint32_t way = level_victim(level, set);
+    tlb_line_t *line = line_at(level, set, way);
+
+    if (evicted != NULL)
+    {
+        *evicted = *line;
+        evicted->v = tlb_line_live(level, line);
+        *evicted_page_nbr = ((line->tag << level->set_bits) | set) << page_size_vpn_bits(line->ps);
+    }
+    line->tag = page_nbr >> level->set_bits;
+    line->phy_page_num = phy_page_num & ~huge_mask(size);
+    line->ps = size;
+    line->asid = asid;
+    line->prefetched = 0;
+    line->gen = level->generation;
+    line->v = VALID;
+    level_touch(level, set, way);
+    return line;
+}
+
+// invalidates the entry mapping exactly the given page, if present; returns the number of invalidated entries
+static int level_invalidate(tlb_level_t *level, uint16_t asid, uint64_t page_base, page_size_t size)
+{
+    int nb_invalidated = 0;
+    const uint64_t page_nbr = page_base >> page_size_vpn_bits(size);
+    const uint32_t set = (uint32_t)(page_nbr & (level->sets - 1));
+    const uint64_t tag = page_nbr >> level->set_bits;
+    for (uint32_t way = 0; way < level->ways; ++way)
+    {
+        tlb_line_t *line = line_at(level, set, way);
+        if (tlb_line_live(level, line) && line->ps == size && line->tag == tag && line->asid == asid)
+        {
+            line->v = 0;
+            nb_invalidated++;
+        }
+    }
+    return nb_invalidated;
+}
+
+// invalidates the entries of an address space mapping (part of) the virtual pages [first, last]
+static void level_invalidate_range(tlb_level_t *level, uint16_t asid, uint64_t first, uint64_t last)
+{
+    for (page_size_t s = PAGE_4K; s < NB_PAGE_SIZES; s++)
+    {
+        const uint64_t lo = first >> page_size_vpn_bits(s);
+        const uint64_t hi = last >> page_size_vpn_bits(s);
+        if (hi - lo < level->sets)
+        {
+            // fewer pages than sets: probe the set of each page
+            for (uint64_t page_nbr = lo; page_nbr <= hi; ++page_nbr)
+                level_invalidate(level, asid, page_nbr << page_size_vpn_bits(s), s);
+            continue;
+        }
+        for (uint32_t set = 0; set < level->sets; ++set)
+        {
+            for (uint32_t way = 0; way < level->ways; ++way)
+            {
+                tlb_line_t *line = line_at(level, set, way);
+                const uint64_t page_nbr = (line->tag << level->set_bits) | set;
+                if (tlb_line_live(level, line) && line->ps == s && line->asid == asid && page_nbr >= lo && page_nbr <= hi)
+                    line->v = 0;
+            }
+        }
+    }
+}
+
+// invalidates all entries of an address space
+static void level_invalidate_asid(tlb_level_t *level, uint16_t asid)
+{
+    const size_t nb_lines = (size_t)level->sets * level->ways;
+    for (size_t i = 0; i < nb_lines; ++i)
+        if (tlb_line_live(level, &level->lines[i]) && level->lines[i].asid == asid)
+            level->lines[i].v = 0;
+}
+
+int tlb_prefetch_config_parse(const char *spec, tlb_prefetch_config_t *config)
+{
+    M_REQUIRE_NON_NULL(spec);
+    M_REQUIRE_NON_NULL(config);
+    static const char *const names[NB_TLB_PREFETCHERS] = { "none", "seq", "stride", "dist" };
+
+    const char *end = strchr(spec, ':');
+    const size_t length = end == NULL ? strlen(spec) : (size_t)(end - spec);
+    config->kind = NB_TLB_PREFETCHERS;
+    for (tlb_prefetch_t k = TLB_PREFETCH_NONE; k < NB_TLB_PREFETCHERS; k++)
+        if (strlen(names[k]) == length && !strncmp(spec, names[k], length))
+            config->kind = k;
+    M_REQUIRE(config->kind < NB_TLB_PREFETCHERS, ERR_BAD_PARAMETER, "unknown TLB prefetcher \"%s\"", spec);
+    config->degree = 1;
+    config->buffer_entries = 0;
+
+    while (end != NULL)
+    {
+        const char *field = end + 1;
+        char *field_end = NULL;
+        const int is_buffer = !strncmp(field, "buf", 3);
+        const unsigned long value = strtoul(is_buffer ? field + 3 : field, &field_end, 10);
+        M_REQUIRE(field_end != (is_buffer ? field + 3 : field) && (*field_end == ':' || *field_end == '\0')
+                  && value <= UINT32_MAX, ERR_BAD_PARAMETER, "bad TLB prefetcher \"%s\"", spec);
+        if (is_buffer)
+            config->buffer_entries = (uint32_t)value;
+        else
+            config->degree = (uint32_t)value;
+        end = *field_end == ':' ? field_end : NULL;
+    }
+    return ERR_NONE;
+}
+
+int tlb_hrchy_init(tlb_hrchy_t *hrchy, const tlb_hrchy_config_t *config)
+{
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE(config->asid_mode < NB_TLB_ASID_MODES, ERR_BAD_PARAMETER, "unknown ASID mode %d", config->asid_mode);
+    M_REQUIRE(config->inclusion < NB_TLB_INCLUSIONS, ERR_BAD_PARAMETER, "unknown inclusion policy %d", config->inclusion);
+    M_REQUIRE(config->prefetch.kind < NB_TLB_PREFETCHERS, ERR_BAD_PARAMETER, "unknown prefetcher %d", config->prefetch.kind);
+    M_REQUIRE(config->prefetch.kind == TLB_PREFETCH_NONE
+              || (config->prefetch.degree >= 1 && config->prefetch.degree <= TLB_PREFETCH_MAX_DEGREE),
+              ERR_BAD_PARAMETER, "prefetch degree (%u) out of bounds", config->prefetch.degree);
+    memset(hrchy, 0, sizeof(tlb_hrchy_t));
+    hrchy->config = *config;
+    hrchy->space = (addr_space_t)ADDR_SPACE_DEFAULT;
+    for (tlb_t t = L1_ITLB; t < NB_TLB_TYPES; t++)
+    {
+        const int err = level_init(&hrchy->level[t], &config->level[t]);
+        if (err != ERR_NONE)
+        {
+            tlb_hrchy_free(hrchy);
+            return err;
+        }
+    }
+    if (config->prefetch.kind != TLB_PREFETCH_NONE && config->prefetch.buffer_entries != 0)
+    {
+        const tlb_level_config_t buffer = { 1, config->prefetch.buffer_entries, TLB_REPL_LRU };
+        const int err = level_init(&hrchy->prefetcher.buffer, &buffer);
+        if (err != ERR_NONE)
+        {
+            tlb_hrchy_free(hrchy);
+            return err;
+        }
+    }
+    return ERR_NONE;
+}
+
+void tlb_hrchy_free(tlb_hrchy_t *hrchy)
+{
+    if (hrchy == NULL)
+        return;
+    for (tlb_t t = L1_ITLB; t < NB_TLB_TYPES; t++)
+    {
+        free(hrchy->level[t].lines);
+        free(hrchy->level[t].stamps);
+        free(hrchy->level[t].mru);
+        memset(&hrchy->level[t], 0, sizeof(tlb_level_t));
+    }
+    free(hrchy->prefetcher.buffer.lines);
+    free(hrchy->prefetcher.buffer.stamps);
+    free(hrchy->prefetcher.buffer.mru);
+    memset(&hrchy->prefetcher, 0, sizeof(tlb_prefetcher_t));
+}
+
+// flushes all TLBs of the hierarchy, including the prefetch buffer
+static void hrchy_flush_all(tlb_hrchy_t *hrchy)
+{
+    for (tlb_t t = L1_ITLB; t < NB_TLB_TYPES; t++)
+        level_flush(&hrchy->level[t]);
+    if (hrchy->prefetcher.buffer.lines != NULL)
+        level_flush(&hrchy->prefetcher.buffer);
+}
+
+int tlb_hrchy_flush(tlb_hrchy_t *hrchy)
+{
+    M_REQUIRE_NON_NULL(hrchy);
+    for (tlb_t t = L1_ITLB; t < NB_TLB_TYPES; t++)
+        M_REQUIRE_NON_NULL(hrchy->level[t].lines);
+    hrchy_flush_all(hrchy);
+    tlb_level_t buffer = hrchy->prefetcher.buffer;
+    memset(&hrchy->prefetcher, 0, sizeof(tlb_prefetcher_t));
+    hrchy->prefetcher.buffer = buffer;
+    memset(&hrchy->stats, 0, sizeof(tlb_hrchy_stats_t));
+    hrchy->space = (addr_space_t)ADDR_SPACE_DEFAULT;
+    return ERR_NONE;
+}
+
+int tlb_hrchy_switch(tlb_hrchy_t *hrchy, const addr_space_t *space)
+{
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(space);
+    M_REQUIRE(space->pgd % PAGE_SIZE == 0, ERR_BAD_PARAMETER, "page-table root 0x%08" PRIX32 " is not page aligned", space->pgd);
+    hrchy->stats.context_switches++;
+    if (hrchy->config.asid_mode == TLB_ASID_FLUSH)
+    {
+        M_EXIT_IF_ERR(tlb_invalidate_all(hrchy), "flushing the TLB hierarchy");
+        hrchy->stats.flushes++;
+    }
+    hrchy->space = *space;
+    return ERR_NONE;
+}
+
+// ======================================================================
+// invalidation, in every TLB of the hierarchy and in the prefetch buffer
+
+// the TLBs of a hierarchy, followed by its prefetch buffer if any; returns their number
+static size_t hrchy_levels(tlb_hrchy_t *hrchy, tlb_level_t *levels[NB_TLB_TYPES + 1])
+{
+    size_t nb_levels = 0;
+    for (tlb_t t = L1_ITLB; t < NB_TLB_TYPES; t++)
+        levels[nb_levels++] = &hrchy->level[t];
+    if (hrchy->prefetcher.buffer.lines != NULL)
+        levels[nb_levels++] = &hrchy->prefetcher.buffer;
+    return nb_levels;
+}
+
+int tlb_invalidate_page(tlb_hrchy_t *hrchy, uint16_t asid, const virt_addr_t *vaddr)
+{
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(vaddr);
+    const uint64_t virt_page_nbr = virt_addr_t_to_virtual_page_number(vaddr);
+    tlb_level_t *levels[NB_TLB_TYPES + 1];
+    const size_t nb_levels = hrchy_levels(hrchy, levels);
+    for (size_t i = 0; i < nb_levels; ++i)
+    {
+        for (page_size_t s = PAGE_4K; s < NB_PAGE_SIZES; s++)
+            level_invalidate(levels[i], asid, virt_page_nbr & ~huge_mask(s), s);
+    }
+    return ERR_NONE;
+}
+
+int tlb_invalidate_range(tlb_hrchy_t *hrchy, uint16_t asid, uint64_t from, uint64_t to)
+{
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE(from <= to, ERR_BAD_PARAMETER, "empty range [0x%" PRIX64 ", 0x%" PRIX64 ")", from, to);
+    if (from == to)
+        return ERR_NONE;
+    tlb_level_t *levels[NB_TLB_TYPES + 1];
+    const size_t nb_levels = hrchy_levels(hrchy, levels);
+    for (size_t i = 0; i < nb_levels; ++i)
+        level_invalidate_range(levels[i], asid, from >> PAGE_OFFSET, (to - 1) >> PAGE_OFFSET);
+    return ERR_NONE;
+}
+
+int tlb_invalidate_asid(tlb_hrchy_t *hrchy, uint16_t asid)
+{
+    M_REQUIRE_NON_NULL(hrchy);
+    tlb_level_t *levels[NB_TLB_TYPES + 1];
+    const size_t nb_levels = hrchy_levels(hrchy, levels);
+    for (size_t i = 0; i < nb_levels; ++i)
+        level_invalidate_asid(levels[i], asid);
+    return ERR_NONE;
+}
+
+int tlb_invalidate_all(tlb_hrchy_t *hrchy)
+{
+    M_REQUIRE_NON_NULL(hrchy);
+    tlb_level_t *levels[NB_TLB_TYPES + 1];
+    const size_t nb_levels = hrchy_levels(hrchy, levels);
+    for (size_t i = 0; i < nb_levels; ++i)
+        level_invalidate_all(levels[i]);
+    return ERR_NONE;
+}
+
+// accounts L1 misses and page walks to a virtual page of the current address space, if profiled
+static int profile_record(tlb_hrchy_t *hrchy, uint64_t virt_page_nbr, uint32_t misses, uint32_t walks)
+{
+    if (hrchy->profile == NULL)
+        return ERR_NONE;
+    return tlb_profile_record(hrchy->profile, hrchy->space.asid, virt_page_nbr, misses, walks);
+}
+
+// installs a translation in L2; if L2 is inclusive, its victim is removed from both L1 TLBs
+static tlb_line_t *l2_install(tlb_hrchy_t *hrchy, uint16_t asid, uint64_t virt_page_nbr, uint32_t phy_page_num, page_size_t size)
+{
+    tlb_line_t evicted;
+    uint64_t evicted_page_nbr = 0;
+    tlb_line_t *line = level_fill(&hrchy->level[L2_TLB], asid, virt_page_nbr, phy_page_num, size, &evicted, &evicted_page_nbr);
+    if (evicted.v)
+    {
+        if (hrchy->config.inclusion == TLB_INCLUSIVE)
+        {
+            hrchy->stats.back_invalidations += (uint64_t)level_invalidate(&hrchy->level[L1_ITLB], evicted.asid, evicted_page_nbr, evicted.ps);
+            hrchy->stats.back_invalidations += (uint64_t)level_invalidate(&hrchy->level[L1_DTLB], evicted.asid, evicted_page_nbr, evicted.ps);
+        }
+        if (evicted.prefetched)
+            hrchy->stats.prefetch_useless++;
+    }
+    return line;
+}
+
+// installs a translation in an L1 TLB; if L2 is exclusive, the L1 victim is moved to L2
+static void l1_install(tlb_hrchy_t *hrchy, tlb_t type, uint16_t asid, uint64_t virt_page_nbr, uint32_t phy_page_num, page_size_t size)
+{
+    tlb_line_t evicted;
+    uint64_t evicted_page_nbr = 0;
+    level_fill(&hrchy->level[type], asid, virt_page_nbr, phy_page_num, size, &evicted, &evicted_page_nbr);
+    if (hrchy->config.inclusion == TLB_EXCLUSIVE && evicted.v)
+    {
+        hrchy->stats.victim_fills++;
+        l2_install(hrchy, evicted.asid, evicted_page_nbr, evicted.phy_page_num, evicted.ps);
+    }
+}
+
+// speculatively translates a virtual page into the L2 TLB or the prefetch buffer
+static void prefetch_page(const void *mem_space, tlb_hrchy_t *hrchy, uint64_t page_nbr)
+{
+    const uint16_t asid = hrchy->space.asid;
+    tlb_level_t *buffer = &hrchy->prefetcher.buffer;
+    uint32_t set = 0;
+    uint32_t way = 0;
+    if ((page_nbr >> VIRT_PAGE_NUM) != 0
+        || level_lookup(&hrchy->level[L1_ITLB], asid, page_nbr, &set, &way) != NULL
+        || level_lookup(&hrchy->level[L1_DTLB], asid, page_nbr, &set, &way) != NULL
+        || level_lookup(&hrchy->level[L2_TLB], asid, page_nbr, &set, &way) != NULL
+        || (buffer->lines != NULL && level_lookup(buffer, asid, page_nbr, &set, &way) != NULL))
+        return;
+
+    virt_addr_t vaddr;
+    phy_addr_t paddr;
+    page_size_t size = PAGE_4K;
+    // physical page 0 holds the default PGD: a translation to it is an unmapped (null) entry
+    if (init_virt_addr64(&vaddr, page_nbr << PAGE_OFFSET) != ERR_NONE
+        || profile_record(hrchy, page_nbr, 0, 1) != ERR_NONE
+        || page_walk_from(mem_space, hrchy->space.pgd, &vaddr, &paddr, &size) != ERR_NONE
+        || paddr.phy_page_num == 0)
+        return;
+
+    hrchy->stats.prefetches++;
+    tlb_line_t *line = NULL;
+    if (buffer->lines != NULL)
+    {
+        tlb_line_t evicted;
+        uint64_t evicted_page_nbr = 0;
+        line = level_fill(buffer, asid, page_nbr, paddr.phy_page_num, size, &evicted, &evicted_page_nbr);
+        if (evicted.v && evicted.prefetched)
+            hrchy->stats.prefetch_useless++;
+    }
+    else
+        line = l2_install(hrchy, asid, page_nbr, paddr.phy_page_num, size);
+    line->prefetched = 1;
+}
+
+static inline size_t distance_slot(int64_t delta)
+{
+    return (size_t)(((uint64_t)delta * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (TLB_DISTANCE_ENTRIES - 1);
+}
+
+// remembers that delta next followed delta prev
+static void distance_record(tlb_prefetcher_t *prefetcher, int64_t prev, int64_t next)
+{
+    tlb_distance_entry_t *entry = &prefetcher->distances[distance_slot(prev)];
+    if (entry->nb_next == 0 || entry->delta != prev)
+    {
+        entry->delta = prev;
+        entry->nb_next = 0;
+    }
+    uint8_t i = 0;
+    while (i < entry->nb_next && entry->next[i] != next)
+        ++i;
+    if (i == entry->nb_next && entry->nb_next < TLB_DISTANCE_PREDICTIONS)
+        entry->nb_next++;
+    if (i == TLB_DISTANCE_PREDICTIONS)
+        i = TLB_DISTANCE_PREDICTIONS - 1;
+    for (; i > 0; --i) // most recent first
+        entry->next[i] = entry->next[i - 1];
+    entry->next[0] = next;
+}
+
+// trains the prefetcher on a virtual page number (mapped by a page of the given size), then prefetches
+static void prefetcher_train(const void *mem_space, tlb_hrchy_t *hrchy, uint64_t virt_page_nbr, page_size_t size)
+{
+    tlb_prefetcher_t *prefetcher = &hrchy->prefetcher;
+    const tlb_prefetch_config_t *config = &hrchy->config.prefetch;
+    const int64_t delta = (int64_t)(virt_page_nbr - prefetcher->last_page);
+    uint64_t candidates[TLB_PREFETCH_MAX_DEGREE];
+    size_t nb_candidates = 0;
+
+    switch (config->kind)
+    {
+    case TLB_PREFETCH_SEQUENTIAL:
+    {
+        const uint64_t span = UINT64_C(1) << page_size_vpn_bits(size);
+        for (uint32_t k = 1; k <= config->degree; ++k)
+            candidates[nb_candidates++] = (virt_page_nbr & ~huge_mask(size)) + k * span;
+    }
+    break;
+    case TLB_PREFETCH_STRIDE:
+        if (prefetcher->trained >= 2 && delta != 0 && delta == prefetcher->last_delta)
+        {
+            for (uint32_t k = 1; k <= config->degree; ++k)
+                candidates[nb_candidates++] = virt_page_nbr + (uint64_t)(k * delta);
+        }
+        break;
+    case TLB_PREFETCH_DISTANCE:
+        if (prefetcher->trained >= 2)
+            distance_record(prefetcher, prefetcher->last_delta, delta);
+        if (prefetcher->trained >= 1)
+        {
+            const tlb_distance_entry_t *entry = &prefetcher->distances[distance_slot(delta)];
+            for (uint8_t i = 0; entry->delta == delta && i < entry->nb_next && nb_candidates < config->degree; ++i)
+                candidates[nb_candidates++] = virt_page_nbr + (uint64_t)entry->next[i];
+        }
+        break;
+    default:
+        return;
+    }
+
+    if (prefetcher->trained >= 1)
+        prefetcher->last_delta = delta;
+    prefetcher->last_page = virt_page_nbr;
+    if (prefetcher->trained < 2)
+        prefetcher->trained++;
+    for (size_t i = 0; i < nb_candidates; ++i)
+        prefetch_page(mem_space, hrchy, candidates[i]);
+}
+
+int tlb_hrchy_search(const void *mem_space,
+                     const virt_addr_t *vaddr,
+                     phy_addr_t *paddr,
+                     mem_access_t access,
+                     tlb_hrchy_t *hrchy,
+                     int *hit_or_miss)
+{
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(vaddr);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(hit_or_miss);
+
+    const tlb_t type = access == INSTRUCTION ? L1_ITLB : L1_DTLB;
+    const uint64_t virt_page_nbr = virt_addr_t_to_virtual_page_number(vaddr);
+    const uint16_t asid = hrchy->space.asid;
+    uint32_t set = 0;
+    uint32_t way = 0;
+
+    const tlb_t order[] = { type, L2_TLB };
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); ++i)
+    {
+        tlb_level_t *level = &hrchy->level[order[i]];
+        tlb_line_t *line = level_lookup(level, asid, virt_page_nbr, &set, &way);
+        if (line != NULL)
+        {
+            const page_size_t size = line->ps;
+            const uint32_t phy_page_num = line->phy_page_num | (virt_page_nbr & huge_mask(size));
+            const int first_use = line->prefetched;
+            line->prefetched = 0;
+            level_touch(level, set, way);
+            hrchy->stats.hits[order[i]][size]++;
+            init_phy_addr(paddr, phy_page_num << PAGE_OFFSET, vaddr->page_offset);
+            if (order[i] == L2_TLB)
+            {
+                M_EXIT_IF_ERR(profile_record(hrchy, virt_page_nbr, 1, 0), "error occured while profiling in tlb search");
+                if (hrchy->config.inclusion == TLB_EXCLUSIVE)
+                    line->v = 0; // moved to L1
+                l1_install(hrchy, type, asid, virt_page_nbr, phy_page_num, size);
+            }
+            *hit_or_miss = 1;
+            if (first_use)
+            {
+                hrchy->stats.prefetch_useful++;
+                prefetcher_train(mem_space, hrchy, virt_page_nbr, size);
+            }
+            return ERR_NONE;
+        }
+    }
+
+    // L2 miss: served by the prefetch buffer, if any, or by a page walk
+    tlb_level_t *buffer = &hrchy->prefetcher.buffer;
+    tlb_line_t *prefetched = buffer->lines == NULL ? NULL : level_lookup(buffer, asid, virt_page_nbr, &set, &way);
+    page_size_t size = PAGE_4K;
+    M_EXIT_IF_ERR(profile_record(hrchy, virt_page_nbr, 1, prefetched == NULL), "error occured while profiling in tlb search");
+    if (prefetched != NULL)
+    {
+        *hit_or_miss = 1;
+        hrchy->stats.prefetch_hits++;
+        hrchy->stats.prefetch_useful++;
+        size = prefetched->ps;
+        prefetched->v = 0;
+        init_phy_addr(paddr, (prefetched->phy_page_num | (virt_page_nbr & huge_mask(size))) << PAGE_OFFSET, vaddr->page_offset);
+    }
+    else
+    {
+        *hit_or_miss = 0;
+        hrchy->stats.walks++;
+        M_EXIT_IF_ERR(page_walk_from(mem_space, hrchy->space.pgd, vaddr, paddr, &size), "error occured while pagewalking in tlb search");
+    }
+
+    if (hrchy->config.inclusion != TLB_EXCLUSIVE)
+        l2_install(hrchy, asid, virt_page_nbr, paddr->phy_page_num, size);
+    l1_install(hrchy, type, asid, virt_page_nbr, paddr->phy_page_num, size);
+    prefetcher_train(mem_space, hrchy, virt_page_nbr, size);
+    return ERR_NONE;
+}
@@ -96,3 +96,176 @@ int tlb_search(const void *mem_space,
                l1_dtlb_entry_t *l1_dtlb,
                l2_tlb_entry_t *l2_tlb,
                int *hit_or_miss);
+
+//=========================================================================
+/**
+ * @brief Same as tlb_search(), also accounting hits and page walks in stats.
+ *
+ * @param stats (modified) statistics to update, may be NULL
+ * (other parameters: see tlb_search())
+ * @return error code
+ */
+
+int tlb_search_with_stats(const void *mem_space,
+                          const virt_addr_t *vaddr,
+                          phy_addr_t *paddr,
+                          mem_access_t access,
+                          l1_itlb_entry_t *l1_itlb,
+                          l1_dtlb_entry_t *l1_dtlb,
+                          l2_tlb_entry_t *l2_tlb,
+                          int *hit_or_miss,
+                          tlb_hrchy_stats_t *stats);
+
+// ======================================================================
+// configurable (set-associative) hierarchy of TLBs
+
+//=========================================================================
+/**
+ * @brief Parse the configuration of one TLB, written "SETSxWAYS[:lru|:plru]"
+ * (e.g. "16x1", "4x4:plru"); the policy defaults to LRU.
+ *
+ * @param spec the string to parse
+ * @param config (modified) the parsed configuration
+ * @return error code
+ */
+
+int tlb_level_config_parse(const char *spec, tlb_level_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Parse a prefetcher configuration, written "KIND[:DEGREE][:bufN]"
+ * where KIND is none, seq, stride or dist (e.g. "seq:2", "dist:1:buf16");
+ * the degree defaults to 1 and translations go to the L2 TLB unless a
+ * prefetch buffer of N entries is given.
+ *
+ * @param spec the string to parse
+ * @param config (modified) the parsed configuration
+ * @return error code
+ */
+
+int tlb_prefetch_config_parse(const char *spec, tlb_prefetch_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Allocate and flush a TLB hierarchy.
+ *
+ * @param hrchy (modified) the hierarchy to initialize
+ * @param config its configuration (see TLB_HRCHY_CONFIG_DEFAULT)
+ * @return error code
+ */
+
+int tlb_hrchy_init(tlb_hrchy_t *hrchy, const tlb_hrchy_config_t *config);
+
+//=========================================================================
+/**
+ * @brief Free the memory held by a TLB hierarchy.
+ *
+ * @param hrchy the hierarchy to free
+ */
+
+void tlb_hrchy_free(tlb_hrchy_t *hrchy);
+
+//=========================================================================
+/**
+ * @brief Invalidate all entries of a TLB hierarchy, reset its statistics and
+ * switch it back to the default address space.
+ *
+ * @param hrchy the hierarchy to flush
+ * @return error code
+ */
+
+int tlb_hrchy_flush(tlb_hrchy_t *hrchy);
+
+//=========================================================================
+/**
+ * @brief Switch a TLB hierarchy to another address space: the following
+ * searches walk its page tables and, in TLB_ASID_TAGGED mode, only hit
+ * entries of its ASID; in TLB_ASID_FLUSH mode, all entries are invalidated.
+ * The initial address space is ADDR_SPACE_DEFAULT.
+ *
+ * @param hrchy the hierarchy
+ * @param space the address space switched to
+ * @return error code
+ */
+
+int tlb_hrchy_switch(tlb_hrchy_t *hrchy, const addr_space_t *space);
+
+//=========================================================================
+/**
+ * @brief Ask a configurable TLB hierarchy for the translation.
+ * With an inclusive L2, same behavior as tlb_search() (L2 victims are
+ * invalidated in both L1 TLBs); see tlb_inclusion_t for the other policies.
+ * Searches happen in the current address space of the hierarchy, with the
+ * configured prefetcher; statistics are accounted in hrchy->stats.
+ * If hrchy->profile is set, each miss of the L1 TLB and each page walk
+ * (on demand or prefetching) are also accounted to their virtual page.
+ *
+ * @param mem_space pointer to the memory space
+ * @param vaddr pointer to virtual address
+ * @param paddr (modified) pointer to physical address (returned from TLB)
+ * @param access to distinguish between fetching instructions and reading/writing data
+ * @param hrchy the TLB hierarchy
+ * @param hit_or_miss (modified) hit (1) or miss (0)
+ * @return error code
+ */
+
+int tlb_hrchy_search(const void *mem_space,
+                     const virt_addr_t *vaddr,
+                     phy_addr_t *paddr,
+                     mem_access_t access,
+                     tlb_hrchy_t *hrchy,
+                     int *hit_or_miss);
+
+//=========================================================================
+/**
+ * @brief Invalidate, in every TLB of a configurable hierarchy (and its
+ * prefetch buffer), the entries of an address space translating a virtual
+ * address (whatever the size of their page).
+ *
+ * @param hrchy the TLB hierarchy
+ * @param asid the address space
+ * @param vaddr the virtual address
+ * @return error code
+ */
+
+int tlb_invalidate_page(tlb_hrchy_t *hrchy, uint16_t asid, const virt_addr_t *vaddr);
+
+//=========================================================================
+/**
+ * @brief Invalidate, in every TLB of a configurable hierarchy (and its
+ * prefetch buffer), the entries of an address space mapping (part of) the
+ * virtual addresses in [from, to).
+ *
+ * @param hrchy the TLB hierarchy
+ * @param asid the address space
+ * @param from first virtual address of the range
+ * @param to first virtual address after the range
+ * @return error code
+ */
+
+int tlb_invalidate_range(tlb_hrchy_t *hrchy, uint16_t asid, uint64_t from, uint64_t to);
+
+//=========================================================================
+/**
+ * @brief Invalidate all entries of an address space in a configurable
+ * hierarchy (and its prefetch buffer).
+ *
+ * @param hrchy the TLB hierarchy
+ * @param asid the address space
+ * @return error code
+ */
+
+int tlb_invalidate_asid(tlb_hrchy_t *hrchy, uint16_t asid);
+
+//=========================================================================
+/**
+ * @brief Invalidate all entries of a configurable hierarchy (and its
+ * prefetch buffer) in O(1), by starting a new generation of each TLB
+ * (see tlb_line_live()). Unlike tlb_hrchy_flush(), statistics, replacement
+ * state and the address space are kept.
+ *
+ * @param hrchy the TLB hierarchy
+ * @return error code
+ */
+
+int tlb_invalidate_all(tlb_hrchy_t *hrchy);
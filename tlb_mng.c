@@ -4,10 +4,15 @@
 #include "addr.h"
 #include "addr_mng.h"
 #include <stdint.h>
+#include <string.h>
 #include "page_walk.h"
+#include "tlb_profile.h"
 
 #define VALID 1;
 
+// low virtual page number bits covered by an entry mapping a page of the given size
+#define huge_mask(ps) ((UINT64_C(1) << page_size_vpn_bits(ps)) - 1)
+
 int tlb_entry_init(const virt_addr_t *vaddr, const phy_addr_t *paddr, tlb_entry_t *tlb_entry)
 {
     M_REQUIRE_NON_NULL(vaddr);
@@ -16,9 +21,210 @@ int tlb_entry_init(const virt_addr_t *vaddr, const phy_addr_t *paddr, tlb_entry_
     tlb_entry->v = VALID;
     tlb_entry->phy_page_num = paddr->phy_page_num;
     tlb_entry->tag = virt_addr_t_to_virtual_page_number(vaddr);
+    tlb_entry->ps = PAGE_4K;
+    tlb_entry->asid = 0;
+    tlb_entry->gen = 0;
+    return ERR_NONE;
+}
+
+// ======================================================================
+// hash index of the TLB entries
+
+static inline uint64_t index_key(uint16_t asid, uint64_t tag, page_size_t size)
+{
+    return (((((uint64_t)asid << VIRT_PAGE_NUM) | tag) << 2) | size) + 1;
+}
+
+static inline size_t index_slot(uint64_t key)
+{
+    return (size_t)((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (TLB_INDEX_SLOTS - 1);
+}
+
+// slot holding key, or the empty slot where it would be inserted
+static size_t index_find(const tlb_index_t *index, uint64_t key)
+{
+    size_t i = index_slot(key);
+    while (index->keys[i] != 0 && index->keys[i] != key)
+        i = (i + 1) & (TLB_INDEX_SLOTS - 1);
+    return i;
+}
+
+static void index_insert(tlb_index_t *index, const tlb_entry_t *entry, uint32_t line_index)
+{
+    const size_t i = index_find(index, index_key(entry->asid, entry->tag, entry->ps));
+    if (index->keys[i] == 0)
+        index->nb_entries[entry->ps]++;
+    index->keys[i] = index_key(entry->asid, entry->tag, entry->ps);
+    index->lines[i] = line_index;
+}
+
+// removal with backward shifting, so that no probe sequence is broken;
+// nothing is done if the key of the entry now belongs to another line
+static void index_remove(tlb_index_t *index, const tlb_entry_t *entry, uint32_t line_index)
+{
+    size_t i = index_find(index, index_key(entry->asid, entry->tag, entry->ps));
+    if (index->keys[i] == 0 || index->lines[i] != line_index)
+        return;
+    index->nb_entries[entry->ps]--;
+    size_t j = i;
+    for (;;)
+    {
+        j = (j + 1) & (TLB_INDEX_SLOTS - 1);
+        if (index->keys[j] == 0)
+            break;
+        const size_t home = index_slot(index->keys[j]);
+        // move j to the hole i unless its home slot lies cyclically in ]i, j]
+        if ((i < j) ? (home <= i || home > j) : (home <= i && home > j))
+        {
+            index->keys[i] = index->keys[j];
+            index->lines[i] = index->lines[j];
+            i = j;
+        }
+    }
+    index->keys[i] = 0;
+}
+
+int tlb_index_init(tlb_index_t *index, const tlb_entry_t *tlb, const list_t *ll)
+{
+    M_REQUIRE_NON_NULL(index);
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(ll);
+    memset(index, 0, sizeof(tlb_index_t));
+    for_all_nodes(node, ll)
+    {
+        M_REQUIRE(node->value < TLB_LINES, ERR_BAD_PARAMETER, "%u is out of bounds", node->value);
+        index->nodes[node->value] = node;
+    }
+    for (uint32_t line = 0; line < TLB_LINES; ++line)
+    {
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(index->nodes[line], ERR_BAD_PARAMETER);
+        if (tlb[line].v)
+            index_insert(index, &tlb[line], line);
+    }
     return ERR_NONE;
 }
 
+// ======================================================================
+// replacement policies other than LRU (which only moves nodes of the list)
+
+#if (1 << TLB_LINES_BITS) != TLB_LINES
+#error "TLB_LINES_BITS must be log_2(TLB_LINES)"
+#endif
+#if TLB_LINES > 256
+#error "the stack of freed lines holds line numbers on 8 bits"
+#endif
+
+static uint32_t fifo_victim(replacement_policy_t *policy)
+{
+    const uint32_t victim = policy->state.hand;
+    policy->state.hand = (victim + 1) % TLB_LINES;
+    return victim;
+}
+
+static uint32_t random_victim(replacement_policy_t *policy)
+{
+    // xorshift64
+    uint64_t x = policy->state.seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    policy->state.seed = x;
+    return (uint32_t)(x % TLB_LINES);
+}
+
+static void no_hit(replacement_policy_t *policy, uint32_t line_index)
+{
+    (void)policy;
+    (void)line_index;
+}
+
+static void clock_hit(replacement_policy_t *policy, uint32_t line_index)
+{
+    policy->state.referenced[line_index] = 1;
+}
+
+// the hand clears the reference bits it passes over, up to an unreferenced line
+static uint32_t clock_victim(replacement_policy_t *policy)
+{
+    replacement_state_t *state = &policy->state;
+    while (state->referenced[state->hand])
+    {
+        state->referenced[state->hand] = 0;
+        state->hand = (state->hand + 1) % TLB_LINES;
+    }
+    const uint32_t victim = state->hand;
+    state->hand = (victim + 1) % TLB_LINES;
+    return victim;
+}
+
+// makes every node on the path to the line point away from it
+static void plru_hit(replacement_policy_t *policy, uint32_t line_index)
+{
+    uint32_t node = 1;
+    for (int level = TLB_LINES_BITS - 1; level >= 0; --level)
+    {
+        const uint32_t bit = (line_index >> level) & 1;
+        policy->state.tree[node] = (uint8_t)!bit;
+        node = 2 * node + bit;
+    }
+}
+
+// follows the node bits from the root
+static uint32_t plru_victim(replacement_policy_t *policy)
+{
+    uint32_t node = 1;
+    while (node < TLB_LINES)
+        node = 2 * node + policy->state.tree[node];
+    return node - TLB_LINES;
+}
+
+int replacement_policy_init(replacement_policy_t *replacement_policy, replacement_kind_t kind)
+{
+    M_REQUIRE_NON_NULL(replacement_policy);
+    M_REQUIRE(kind < NB_REPL_KINDS, ERR_BAD_PARAMETER, "unknown replacement policy %d", kind);
+    static const on_hit_t hits[NB_REPL_KINDS] = { NULL, no_hit, no_hit, clock_hit, plru_hit };
+    static const pick_victim_t victims[NB_REPL_KINDS] = { NULL, fifo_victim, random_victim, clock_victim, plru_victim };
+    replacement_policy->on_hit = hits[kind];
+    replacement_policy->pick_victim = victims[kind];
+    memset(&replacement_policy->state, 0, sizeof(replacement_state_t));
+    replacement_policy->state.seed = UINT64_C(0x9E3779B97F4A7C15);
+    return ERR_NONE;
+}
+
+int replacement_kind_parse(const char *name, replacement_kind_t *kind)
+{
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(kind);
+    static const char *const names[NB_REPL_KINDS] = { "lru", "fifo", "random", "clock", "plru" };
+    for (replacement_kind_t k = REPL_LRU; k < NB_REPL_KINDS; k++)
+    {
+        if (!strcmp(name, names[k]))
+        {
+            *kind = k;
+            return ERR_NONE;
+        }
+    }
+    M_EXIT(ERR_BAD_PARAMETER, "unknown replacement policy \"%s\"", name);
+}
+
+// records a hit on a line (whose node in the list is given)
+#define policy_hit(policy, line_index, node)            \
+    do {                                                \
+        if ((policy)->on_hit != NULL)                   \
+            (policy)->on_hit((policy), (line_index));   \
+        else                                            \
+            (policy)->move_back((policy)->ll, (node));  \
+    } while (0)
+
+// ======================================================================
+// turns a freshly initialized (4 kiB) entry into one mapping the whole page of the given size
+static void tlb_entry_set_size(tlb_entry_t *tlb_entry, page_size_t size)
+{
+    tlb_entry->ps = size;
+    tlb_entry->tag &= ~huge_mask(size);
+    tlb_entry->phy_page_num &= ~huge_mask(size);
+}
+
 int tlb_flush(tlb_entry_t *table)
 {
     M_REQUIRE_NON_NULL(table);
@@ -38,10 +244,12 @@ int tlb_insert(uint32_t line_index,
     return ERR_NONE;
 }
 
-int tlb_hit(const virt_addr_t *vaddr,
-            phy_addr_t *paddr,
-            const tlb_entry_t *tlb,
-            replacement_policy_t *replacement_policy)
+static int tlb_hit_sized(const virt_addr_t *vaddr,
+                         phy_addr_t *paddr,
+                         const tlb_entry_t *tlb,
+                         replacement_policy_t *replacement_policy,
+                         uint16_t asid,
+                         page_size_t *size)
 {
 
     //0 to indicate it failed (and we did not find the desired entry in the tlb)
@@ -50,41 +258,244 @@ int tlb_hit(const virt_addr_t *vaddr,
     M_REQUIRE_NON_NULL_CUSTOM_ERR(tlb, 0);
     M_REQUIRE_NON_NULL_CUSTOM_ERR(replacement_policy, 0);
     uint64_t virt_page_nbr = virt_addr_t_to_virtual_page_number(vaddr);
+    tlb_index_t *index = replacement_policy->index;
+    if (index != NULL)
+    {
+        for (page_size_t ps = PAGE_4K; ps < NB_PAGE_SIZES; ps++)
+        {
+            if (index->nb_entries[ps] == 0)
+                continue;
+            const size_t i = index_find(index, index_key(asid, virt_page_nbr & ~huge_mask(ps), ps));
+            if (index->keys[i] != 0 && tlb_entry_live(tlb[index->lines[i]], replacement_policy))
+            {
+                const tlb_entry_t *tmp = &tlb[index->lines[i]];
+                uint32_t phy_page_num = tmp->phy_page_num | (virt_page_nbr & huge_mask(ps));
+                init_phy_addr(paddr, phy_page_num << PAGE_OFFSET, vaddr->page_offset);
+                policy_hit(replacement_policy, index->lines[i], index->nodes[index->lines[i]]);
+                *size = ps;
+                return 1;
+            }
+        }
+        return 0;
+    }
     for_all_nodes_reverse(node, replacement_policy->ll)
     {
         tlb_entry_t tmp = tlb[node->value];
-        if (tmp.tag == virt_page_nbr && tmp.v)
+        if (tmp.tag == (virt_page_nbr & ~huge_mask(tmp.ps)) && tmp.asid == asid && tlb_entry_live(tmp, replacement_policy))
         {
-            init_phy_addr(paddr, tmp.phy_page_num << PAGE_OFFSET, vaddr->page_offset);
-            replacement_policy->move_back(replacement_policy->ll, node);
+            uint32_t phy_page_num = tmp.phy_page_num | (virt_page_nbr & huge_mask(tmp.ps));
+            init_phy_addr(paddr, phy_page_num << PAGE_OFFSET, vaddr->page_offset);
+            policy_hit(replacement_policy, node->value, node);
+            *size = tmp.ps;
             return 1;
         }
     }
     return 0;
 }
 
+int tlb_hit(const virt_addr_t *vaddr,
+            phy_addr_t *paddr,
+            const tlb_entry_t *tlb,
+            replacement_policy_t *replacement_policy)
+{
+    page_size_t size = PAGE_4K;
+    return tlb_hit_sized(vaddr, paddr, tlb, replacement_policy, 0, &size);
+}
+
 int tlb_search(const void *mem_space,
                const virt_addr_t *vaddr,
                phy_addr_t *paddr,
                tlb_entry_t *tlb,
                replacement_policy_t *replacement_policy,
                int *hit_or_miss)
+{
+    return tlb_search_with_stats(mem_space, vaddr, paddr, tlb, replacement_policy, hit_or_miss, NULL);
+}
+
+int tlb_search_with_stats(const void *mem_space,
+                          const virt_addr_t *vaddr,
+                          phy_addr_t *paddr,
+                          tlb_entry_t *tlb,
+                          replacement_policy_t *replacement_policy,
+                          int *hit_or_miss,
+                          tlb_stats_t *stats)
+{
+    const addr_space_t space = ADDR_SPACE_DEFAULT;
+    return tlb_search_in(mem_space, &space, vaddr, paddr, tlb, replacement_policy, hit_or_miss, stats);
+}
+
+// line to be replaced: one holding no live entry if any (never filled, or invalidated), otherwise the one
+// chosen by the policy; for LRU, such a line is at the front of the list, and node is set to it
+static uint32_t tlb_victim(replacement_policy_t *replacement_policy, node_t **node)
+{
+    if (replacement_policy->pick_victim == NULL)
+    {
+        *node = list_front(replacement_policy->ll);
+        return (*node)->value;
+    }
+    replacement_state_t *state = &replacement_policy->state;
+    if (state->nb_freed > 0)
+        return state->freed[--state->nb_freed];
+    if (state->filled < TLB_LINES)
+        return state->filled++;
+    return replacement_policy->pick_victim(replacement_policy);
+}
+
+int tlb_search_in(const void *mem_space,
+                  const addr_space_t *space,
+                  const virt_addr_t *vaddr,
+                  phy_addr_t *paddr,
+                  tlb_entry_t *tlb,
+                  replacement_policy_t *replacement_policy,
+                  int *hit_or_miss,
+                  tlb_stats_t *stats)
 {
     M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(space);
     M_REQUIRE_NON_NULL(vaddr);
     M_REQUIRE_NON_NULL(paddr);
     M_REQUIRE_NON_NULL(tlb);
     M_REQUIRE_NON_NULL(replacement_policy);
     M_REQUIRE_NON_NULL(hit_or_miss);
-    *hit_or_miss = tlb_hit(vaddr, paddr, tlb, replacement_policy);
+    page_size_t size = PAGE_4K;
+    *hit_or_miss = tlb_hit_sized(vaddr, paddr, tlb, replacement_policy, space->asid, &size);
+    if (stats != NULL)
+    {
+        if (*hit_or_miss)
+            stats->hits[size]++;
+        else
+            stats->misses++;
+    }
     if (!*hit_or_miss)
     {
-        M_EXIT_IF_ERR(page_walk(mem_space, vaddr, paddr), "error occured while pagewalking in tlb search");
-        int tlb_index = replacement_policy->ll->front->value;
+        if (stats != NULL && stats->profile != NULL)
+            M_EXIT_IF_ERR(tlb_profile_record(stats->profile, space->asid, virt_addr_t_to_virtual_page_number(vaddr), 1, 1),
+                          "error occured while profiling in tlb search");
+        M_EXIT_IF_ERR(page_walk_from(mem_space, space->pgd, vaddr, paddr, &size), "error occured while pagewalking in tlb search");
+        node_t *node = NULL;
+        const uint32_t tlb_index = tlb_victim(replacement_policy, &node);
         tlb_entry_t t;
         M_EXIT_IF_ERR(tlb_entry_init(vaddr, paddr, &t), "ERROR in tlb_entry_init");
+        tlb_entry_set_size(&t, size);
+        t.asid = space->asid;
+        t.gen = replacement_policy->generation;
+        if (replacement_policy->index != NULL)
+        {
+            if (tlb[tlb_index].v)
+                index_remove(replacement_policy->index, &tlb[tlb_index], tlb_index);
+            index_insert(replacement_policy->index, &t, tlb_index);
+        }
         M_EXIT_IF_ERR(tlb_insert(tlb_index, &t, tlb), "Error in tlb_inset");
-        move_back(replacement_policy->ll, replacement_policy->ll->front);
+        policy_hit(replacement_policy, tlb_index, node);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+// invalidation
+
+// the line is to be refilled before any live one is evicted (see tlb_victim())
+static void invalidate_line(tlb_entry_t *tlb, replacement_policy_t *replacement_policy, uint32_t line_index)
+{
+    if (replacement_policy->index != NULL)
+        index_remove(replacement_policy->index, &tlb[line_index], line_index);
+    tlb[line_index].v = 0;
+    if (replacement_policy->pick_victim != NULL)
+    {
+        replacement_state_t *state = &replacement_policy->state;
+        state->freed[state->nb_freed++] = (uint8_t)line_index;
+        return;
+    }
+    if (replacement_policy->index != NULL)
+    {
+        move_front(replacement_policy->ll, replacement_policy->index->nodes[line_index]);
+        return;
+    }
+    for_all_nodes(node, replacement_policy->ll)
+    {
+        if (node->value == line_index)
+        {
+            move_front(replacement_policy->ll, node);
+            return;
+        }
+    }
+}
+
+int tlb_invalidate_page(tlb_entry_t *tlb,
+                        replacement_policy_t *replacement_policy,
+                        uint16_t asid,
+                        const virt_addr_t *vaddr)
+{
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(replacement_policy);
+    M_REQUIRE_NON_NULL(vaddr);
+    const uint64_t virt_page_nbr = virt_addr_t_to_virtual_page_number(vaddr);
+    const tlb_index_t *index = replacement_policy->index;
+    if (index == NULL)
+        return tlb_invalidate_range(tlb, replacement_policy, asid,
+                                    virt_page_nbr << PAGE_OFFSET, (virt_page_nbr + 1) << PAGE_OFFSET);
+
+    for (page_size_t ps = PAGE_4K; ps < NB_PAGE_SIZES; ps++)
+    {
+        const size_t i = index_find(index, index_key(asid, virt_page_nbr & ~huge_mask(ps), ps));
+        if (index->keys[i] != 0 && tlb_entry_live(tlb[index->lines[i]], replacement_policy))
+            invalidate_line(tlb, replacement_policy, index->lines[i]);
+    }
+    return ERR_NONE;
+}
+
+int tlb_invalidate_range(tlb_entry_t *tlb,
+                         replacement_policy_t *replacement_policy,
+                         uint16_t asid,
+                         uint64_t from,
+                         uint64_t to)
+{
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(replacement_policy);
+    M_REQUIRE(from <= to, ERR_BAD_PARAMETER, "empty range [0x%" PRIX64 ", 0x%" PRIX64 ")", from, to);
+    if (from == to)
+        return ERR_NONE;
+    // pages [first, last] of the range
+    const uint64_t first = from >> PAGE_OFFSET;
+    const uint64_t last = (to - 1) >> PAGE_OFFSET;
+    for (uint32_t line = 0; line < TLB_LINES; ++line)
+    {
+        const tlb_entry_t *entry = &tlb[line];
+        if (tlb_entry_live(*entry, replacement_policy) && entry->asid == asid
+            && entry->tag <= last && entry->tag + huge_mask(entry->ps) >= first)
+            invalidate_line(tlb, replacement_policy, line);
+    }
+    return ERR_NONE;
+}
+
+int tlb_invalidate_asid(tlb_entry_t *tlb,
+                        replacement_policy_t *replacement_policy,
+                        uint16_t asid)
+{
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(replacement_policy);
+    for (uint32_t line = 0; line < TLB_LINES; ++line)
+    {
+        if (tlb_entry_live(tlb[line], replacement_policy) && tlb[line].asid == asid)
+            invalidate_line(tlb, replacement_policy, line);
+    }
+    return ERR_NONE;
+}
+
+int tlb_invalidate_all(tlb_entry_t *tlb,
+                       replacement_policy_t *replacement_policy)
+{
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(replacement_policy);
+    // every line is to be refilled (LRU: in list order)
+    replacement_policy->state.filled = 0;
+    replacement_policy->state.nb_freed = 0;
+    if (++replacement_policy->generation == 0)
+    {
+        // wrapped around: entries of generation 0 would become live again
+        M_EXIT_IF_ERR(tlb_flush(tlb), "flushing the TLB");
+        if (replacement_policy->index != NULL)
+            M_EXIT_IF_ERR(tlb_index_init(replacement_policy->index, tlb, replacement_policy->ll), "rebuilding the TLB index");
     }
     return ERR_NONE;
 }
@@ -17,13 +17,109 @@
 typedef node_t* (*push_back_t)(list_t *, const list_content_t *);
 typedef void (*move_back_t)(list_t *, const node_t *);
 
+#define TLB_INDEX_SLOTS (2 * TLB_LINES) // must be a power of 2
+
+/**
+ * @brief Hash index of the valid TLB entries, from (ASID, page size, tag) to the
+ * TLB line holding it and to the node of that line in the LRU list.
+ * Open addressing with linear probing; key 0 marks an empty slot.
+ */
+typedef struct tlb_index
+{
+    uint64_t keys[TLB_INDEX_SLOTS];
+    uint16_t lines[TLB_INDEX_SLOTS];
+    node_t *nodes[TLB_LINES];            // node of the LRU list holding each line
+    uint32_t nb_entries[NB_PAGE_SIZES];  // number of indexed entries per page size
+} tlb_index_t;
+
+/**
+ * @brief replacement policies of the fully-associative TLB; they only choose
+ * among live lines: a line without a live entry (never filled, or invalidated)
+ * is always filled first. LRU moves an invalidated line to the front of its
+ * list; the other policies keep the lines to be filled in their state.
+ */
+typedef enum {
+    REPL_LRU,       // least recently used (the list of the policy, in use order)
+    REPL_FIFO,      // oldest filled line first
+    REPL_RANDOM,    // uniformly random line (xorshift, fixed seed)
+    REPL_CLOCK,     // second chance: one reference bit per line, cleared by the hand
+    REPL_TREE_PLRU, // binary tree of TLB_LINES - 1 bits pointing to the pseudo-LRU line
+    NB_REPL_KINDS
+} replacement_kind_t;
+
+/**
+ * @brief state of the policies other than LRU
+ */
+typedef struct
+{
+    uint32_t hand;                 // FIFO: next line to replace; CLOCK: clock hand
+    uint64_t seed;                 // RANDOM: generator state
+    uint8_t referenced[TLB_LINES]; // CLOCK: reference bits
+    uint8_t tree[TLB_LINES];       // tree-PLRU: node bits, root at 1, children of n at 2n and 2n+1
+    uint32_t filled;               // lines [0, filled) were filled since the last tlb_invalidate_all()
+    uint32_t nb_freed;             // number of lines in freed
+    uint8_t freed[TLB_LINES];      // stack of the lines invalidated since, refilled first
+} replacement_state_t;
+
+struct replacement_policy;
+typedef void (*on_hit_t)(struct replacement_policy *, uint32_t line_index);
+typedef uint32_t (*pick_victim_t)(struct replacement_policy *);
+
 typedef struct replacement_policy
 {
     list_t *ll;
     push_back_t push_back;
     move_back_t move_back;
+    tlb_index_t *index; // optional (may be NULL): O(1) lookups, see tlb_index_init()
+    uint32_t generation; // entries of older generations are invalid, see tlb_invalidate_all()
+    // optional (both NULL for LRU), see replacement_policy_init():
+    on_hit_t on_hit;           // records a use of a line, hit or just filled
+    pick_victim_t pick_victim; // line to be replaced on a miss
+    replacement_state_t state;
 } replacement_policy_t;
 
+/**
+ * @brief whether an entry of a TLB managed with the given policy is valid:
+ * its v bit is set and it was installed in the current generation
+ */
+#define tlb_entry_live(entry, policy) ((entry).v && (entry).gen == (policy)->generation)
+
+//=========================================================================
+/**
+ * @brief Select the replacement policy of a TLB: sets the on_hit and
+ * pick_victim members of a policy (whose list, and index if any, are already
+ * set) and resets their state. REPL_LRU uses the list only.
+ * Both the hit and the miss paths of every policy are O(1) (CLOCK amortized).
+ *
+ * @param replacement_policy (modified) the policy
+ * @param kind the replacement policy to be used
+ * @return error code
+ */
+int replacement_policy_init(replacement_policy_t *replacement_policy, replacement_kind_t kind);
+
+//=========================================================================
+/**
+ * @brief Parse the name of a replacement policy: lru, fifo, random, clock or plru.
+ *
+ * @param name the string to parse
+ * @param kind (modified) the parsed policy
+ * @return error code
+ */
+int replacement_kind_parse(const char *name, replacement_kind_t *kind);
+
+//=========================================================================
+/**
+ * @brief Build the hash index of a TLB and of its LRU list.
+ * It is then kept up to date by tlb_search() as long as the policy using it
+ * is passed. To be called again after tlb_flush() or any direct TLB update.
+ *
+ * @param index (modified) the index to be built
+ * @param tlb pointer to the TLB
+ * @param ll the LRU list, holding every TLB line index exactly once
+ * @return error code
+ */
+int tlb_index_init(tlb_index_t *index, const tlb_entry_t *tlb, const list_t *ll);
+
 //=========================================================================
 /**
  * @brief Clean a TLB (invalidate, reset...).
@@ -94,3 +190,101 @@ int tlb_search(const void *mem_space,
                tlb_entry_t *tlb,
                replacement_policy_t *replacement_policy,
                int *hit_or_miss);
+
+//=========================================================================
+/**
+ * @brief Same as tlb_search(), also accounting the hit/miss in stats.
+ * If stats->profile is set, each miss and its page walk are also accounted
+ * to the missing virtual page.
+ *
+ * @param stats (modified) statistics to update, may be NULL
+ * (other parameters: see tlb_search())
+ * @return error code
+ */
+int tlb_search_with_stats(const void *mem_space,
+                          const virt_addr_t *vaddr,
+                          phy_addr_t *paddr,
+                          tlb_entry_t *tlb,
+                          replacement_policy_t *replacement_policy,
+                          int *hit_or_miss,
+                          tlb_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Same as tlb_search_with_stats(), in the given address space:
+ * only entries tagged with its ASID may hit, misses walk its page tables
+ * and install entries tagged with its ASID. The other functions act in
+ * the default address space (ADDR_SPACE_DEFAULT).
+ *
+ * @param space the current address space
+ * (other parameters: see tlb_search_with_stats())
+ * @return error code
+ */
+int tlb_search_in(const void *mem_space,
+                  const addr_space_t *space,
+                  const virt_addr_t *vaddr,
+                  phy_addr_t *paddr,
+                  tlb_entry_t *tlb,
+                  replacement_policy_t *replacement_policy,
+                  int *hit_or_miss,
+                  tlb_stats_t *stats);
+
+//=========================================================================
+/**
+ * @brief Invalidate the entry translating a virtual address in an address
+ * space (whatever the size of its page), if any.
+ *
+ * @param tlb pointer to the TLB
+ * @param replacement_policy its replacement policy (and index, if any)
+ * @param asid the address space
+ * @param vaddr the virtual address
+ * @return error code
+ */
+int tlb_invalidate_page(tlb_entry_t *tlb,
+                        replacement_policy_t *replacement_policy,
+                        uint16_t asid,
+                        const virt_addr_t *vaddr);
+
+//=========================================================================
+/**
+ * @brief Invalidate all entries of an address space mapping (part of) the
+ * virtual addresses in [from, to).
+ *
+ * @param tlb pointer to the TLB
+ * @param replacement_policy its replacement policy (and index, if any)
+ * @param asid the address space
+ * @param from first virtual address of the range
+ * @param to first virtual address after the range
+ * @return error code
+ */
+int tlb_invalidate_range(tlb_entry_t *tlb,
+                         replacement_policy_t *replacement_policy,
+                         uint16_t asid,
+                         uint64_t from,
+                         uint64_t to);
+
+//=========================================================================
+/**
+ * @brief Invalidate all entries of an address space.
+ *
+ * @param tlb pointer to the TLB
+ * @param replacement_policy its replacement policy (and index, if any)
+ * @param asid the address space
+ * @return error code
+ */
+int tlb_invalidate_asid(tlb_entry_t *tlb,
+                        replacement_policy_t *replacement_policy,
+                        uint16_t asid);
+
+//=========================================================================
+/**
+ * @brief Invalidate all entries, in O(1): the generation of the policy is
+ * incremented, so that all entries installed before become invalid (their
+ * v bit is left as is). Entries are only erased when the generation wraps.
+ *
+ * @param tlb pointer to the TLB
+ * @param replacement_policy its replacement policy (and index, if any)
+ * @return error code
+ */
+int tlb_invalidate_all(tlb_entry_t *tlb,
+                       replacement_policy_t *replacement_policy);
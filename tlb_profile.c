@@ -0,0 +1,218 @@
+/**
+ * @file tlb_profile.c
+ * @brief attribution of the TLB misses and page walks to virtual pages
+ *
+ * @date 2018-19
+ */
+
+#include "tlb_profile.h"
+#include "error.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// number of virtual page number bits below the entry of each grain
+static const uint8_t grain_shift[NB_TLB_PROFILE_GRAINS] = {
+    0,
+    PMD_ENTRY + PTE_ENTRY,
+    PUD_ENTRY + PMD_ENTRY + PTE_ENTRY
+};
+
+static const char *const grain_name[NB_TLB_PROFILE_GRAINS] = { "PAGES", "PUD REGIONS (1 GiB)", "PGD REGIONS (512 GiB)" };
+
+#define VPN_MASK ((UINT64_C(1) << VIRT_PAGE_NUM) - 1)
+
+static inline uint64_t profile_key(uint16_t asid, uint64_t virt_page_nbr)
+{
+    return (((uint64_t)asid << VIRT_PAGE_NUM) | (virt_page_nbr & VPN_MASK)) + 1;
+}
+
+static inline size_t profile_slot(uint64_t key, size_t capacity)
+{
+    return (size_t)((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (capacity - 1);
+}
+
+// slot holding key, or the empty slot where it would be inserted
+static size_t profile_find(const tlb_profile_slot_t *slots, size_t capacity, uint64_t key)
+{
+    size_t i = profile_slot(key, capacity);
+    while (slots[i].key != 0 && slots[i].key != key)
+        i = (i + 1) & (capacity - 1);
+    return i;
+}
+
+static int profile_grow(tlb_profile_t *profile)
+{
+    const size_t capacity = 2 * profile->capacity;
+    tlb_profile_slot_t *slots = calloc(capacity, sizeof(tlb_profile_slot_t));
+    M_EXIT_IF_NULL(slots, capacity * sizeof(tlb_profile_slot_t));
+    for (size_t i = 0; i < profile->capacity; ++i)
+    {
+        if (profile->slots[i].key != 0)
+            slots[profile_find(slots, capacity, profile->slots[i].key)] = profile->slots[i];
+    }
+    free(profile->slots);
+    profile->slots = slots;
+    profile->capacity = capacity;
+    return ERR_NONE;
+}
+
+int tlb_profile_init(tlb_profile_t *profile)
+{
+    M_REQUIRE_NON_NULL(profile);
+    memset(profile, 0, sizeof(tlb_profile_t));
+    profile->slots = calloc(TLB_PROFILE_MIN_SLOTS, sizeof(tlb_profile_slot_t));
+    M_EXIT_IF_NULL(profile->slots, TLB_PROFILE_MIN_SLOTS * sizeof(tlb_profile_slot_t));
+    profile->capacity = TLB_PROFILE_MIN_SLOTS;
+    return ERR_NONE;
+}
+
+void tlb_profile_free(tlb_profile_t *profile)
+{
+    if (profile != NULL)
+    {
+        free(profile->slots);
+        memset(profile, 0, sizeof(tlb_profile_t));
+    }
+}
+
+int tlb_profile_record(tlb_profile_t *profile, uint16_t asid, uint64_t virt_page_nbr,
+                       uint32_t misses, uint32_t walks)
+{
+    M_REQUIRE_NON_NULL(profile);
+    M_REQUIRE_NON_NULL(profile->slots);
+    const uint64_t key = profile_key(asid, virt_page_nbr);
+    size_t i = profile_find(profile->slots, profile->capacity, key);
+    if (profile->slots[i].key == 0)
+    {
+        if (4 * (profile->nb_pages + 1) > 3 * profile->capacity)
+        {
+            M_EXIT_IF_ERR(profile_grow(profile), "growing the TLB profile");
+            i = profile_find(profile->slots, profile->capacity, key);
+        }
+        profile->slots[i].key = key;
+        profile->nb_pages++;
+    }
+    profile->slots[i].misses += misses;
+    profile->slots[i].walks += walks;
+    profile->misses += misses;
+    profile->walks += walks;
+    return ERR_NONE;
+}
+
+// ======================================================================
+// reports
+
+// by increasing ASID then address
+static int row_cmp_address(const void *a, const void *b)
+{
+    const tlb_profile_row_t *r1 = a;
+    const tlb_profile_row_t *r2 = b;
+    if (r1->asid != r2->asid)
+        return r1->asid < r2->asid ? -1 : 1;
+    if (r1->first_page != r2->first_page)
+        return r1->first_page < r2->first_page ? -1 : 1;
+    return 0;
+}
+
+// by decreasing misses, then walks, then by increasing ASID and address
+static int row_cmp_top(const void *a, const void *b)
+{
+    const tlb_profile_row_t *r1 = a;
+    const tlb_profile_row_t *r2 = b;
+    if (r1->misses != r2->misses)
+        return r1->misses > r2->misses ? -1 : 1;
+    if (r1->walks != r2->walks)
+        return r1->walks > r2->walks ? -1 : 1;
+    return row_cmp_address(a, b);
+}
+
+int tlb_profile_top(const tlb_profile_t *profile, tlb_profile_grain_t grain,
+                    tlb_profile_row_t *rows, size_t n, size_t *nb_rows)
+{
+    M_REQUIRE_NON_NULL(profile);
+    M_REQUIRE_NON_NULL(nb_rows);
+    M_REQUIRE(grain < NB_TLB_PROFILE_GRAINS, ERR_BAD_PARAMETER, "unknown grain %d", grain);
+    M_REQUIRE(n == 0 || rows != NULL, ERR_BAD_PARAMETER, "%s", "rows is NULL");
+    *nb_rows = 0;
+    if (profile->nb_pages == 0 || n == 0)
+        return ERR_NONE;
+
+    tlb_profile_row_t *all = calloc(profile->nb_pages, sizeof(tlb_profile_row_t));
+    M_EXIT_IF_NULL(all, profile->nb_pages * sizeof(tlb_profile_row_t));
+    const uint64_t region_mask = ~((UINT64_C(1) << grain_shift[grain]) - 1);
+    size_t nb = 0;
+    for (size_t i = 0; i < profile->capacity; ++i)
+    {
+        const tlb_profile_slot_t *slot = &profile->slots[i];
+        if (slot->key != 0)
+        {
+            all[nb].asid = (uint16_t)((slot->key - 1) >> VIRT_PAGE_NUM);
+            all[nb].first_page = ((slot->key - 1) & VPN_MASK) & region_mask;
+            all[nb].misses = slot->misses;
+            all[nb].walks = slot->walks;
+            all[nb].pages = 1;
+            ++nb;
+        }
+    }
+
+    // merges the pages of a same region
+    if (grain != TLB_PROFILE_PAGE)
+    {
+        qsort(all, nb, sizeof(tlb_profile_row_t), row_cmp_address);
+        size_t merged = 0;
+        for (size_t i = 1; i < nb; ++i)
+        {
+            if (row_cmp_address(&all[merged], &all[i]) == 0)
+            {
+                all[merged].misses += all[i].misses;
+                all[merged].walks += all[i].walks;
+                all[merged].pages += all[i].pages;
+            }
+            else
+                all[++merged] = all[i];
+        }
+        nb = merged + 1;
+    }
+
+    qsort(all, nb, sizeof(tlb_profile_row_t), row_cmp_top);
+    *nb_rows = nb < n ? nb : n;
+    memcpy(rows, all, *nb_rows * sizeof(tlb_profile_row_t));
+    free(all);
+    return ERR_NONE;
+}
+
+int tlb_profile_print(FILE *output, const tlb_profile_t *profile, size_t n)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(profile);
+    fprintf(output, "TLB PROFILE: %" PRIu64 " misses, %" PRIu64 " walks, %zu pages\n",
+            profile->misses, profile->walks, profile->nb_pages);
+    if (n == 0)
+        return ERR_NONE;
+
+    tlb_profile_row_t *rows = calloc(n, sizeof(tlb_profile_row_t));
+    M_EXIT_IF_NULL(rows, n * sizeof(tlb_profile_row_t));
+    for (tlb_profile_grain_t grain = TLB_PROFILE_PAGE; grain < NB_TLB_PROFILE_GRAINS; ++grain)
+    {
+        size_t nb_rows = 0;
+        const int err = tlb_profile_top(profile, grain, rows, n, &nb_rows);
+        if (err != ERR_NONE)
+        {
+            free(rows);
+            return err;
+        }
+        fprintf(output, "TOP %zu %s:\n", n, grain_name[grain]);
+        for (size_t i = 0; i < nb_rows; ++i)
+        {
+            fprintf(output, "  ASID 0x%04" PRIX16 " @0x%016" PRIX64 ": %" PRIu64 " misses, %" PRIu64 " walks",
+                    rows[i].asid, rows[i].first_page << PAGE_OFFSET, rows[i].misses, rows[i].walks);
+            if (grain != TLB_PROFILE_PAGE)
+                fprintf(output, ", %" PRIu64 " pages", rows[i].pages);
+            fputc('\n', output);
+        }
+    }
+    free(rows);
+    return ERR_NONE;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+/**
+ * @file tlb_profile.h
+ * @brief attribution of the TLB misses and page walks to virtual pages,
+ * and to the regions mapped by one PGD or PUD entry
+ *
+ * @date 2018-19
+ */
+
+#include "addr.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define TLB_PROFILE_MIN_SLOTS 64 // initial capacity of the table (a power of 2)
+
+/**
+ * @brief counters of one virtual page; key 0 marks an empty slot
+ */
+typedef struct {
+    uint64_t key;    // ((ASID << VIRT_PAGE_NUM) | virtual page number) + 1
+    uint32_t misses; // TLB misses on the page
+    uint32_t walks;  // page walks translating the page (demand or prefetch)
+} tlb_profile_slot_t;
+
+/**
+ * @brief per-page counters: open addressing with linear probing, the table
+ * doubling when it gets 3/4 full. Recording is O(1) amortized.
+ */
+typedef struct tlb_profile {
+    tlb_profile_slot_t *slots;
+    size_t capacity; // number of slots, a power of 2
+    size_t nb_pages; // number of used slots
+    uint64_t misses; // totals over all pages
+    uint64_t walks;
+} tlb_profile_t;
+
+/**
+ * @brief granularity of a report: a single page, or all the pages mapped
+ * through one PUD entry (1 GiB) or one PGD entry (512 GiB)
+ */
+typedef enum {
+    TLB_PROFILE_PAGE,
+    TLB_PROFILE_PUD,
+    TLB_PROFILE_PGD,
+    NB_TLB_PROFILE_GRAINS
+} tlb_profile_grain_t;
+
+/**
+ * @brief one line of a report
+ */
+typedef struct {
+    uint16_t asid;
+    uint64_t first_page; // first virtual page number of the page or region
+    uint64_t misses;
+    uint64_t walks;
+    uint64_t pages;      // number of pages of the region with a miss or a walk
+} tlb_profile_row_t;
+
+//=========================================================================
+/**
+ * @brief Allocate an empty profile.
+ *
+ * @param profile (modified) the profile to initialize
+ * @return error code
+ */
+int tlb_profile_init(tlb_profile_t *profile);
+
+//=========================================================================
+/**
+ * @brief Free the memory of a profile.
+ *
+ * @param profile the profile to free
+ */
+void tlb_profile_free(tlb_profile_t *profile);
+
+//=========================================================================
+/**
+ * @brief Account TLB misses and page walks to a virtual page.
+ *
+ * @param profile (modified) the profile
+ * @param asid the address space of the page
+ * @param virt_page_nbr the virtual page number (in 4 kiB pages)
+ * @param misses number of misses to add
+ * @param walks number of page walks to add
+ * @return error code
+ */
+int tlb_profile_record(tlb_profile_t *profile, uint16_t asid, uint64_t virt_page_nbr,
+                       uint32_t misses, uint32_t walks);
+
+//=========================================================================
+/**
+ * @brief The pages or regions with the most misses (then the most walks),
+ * in decreasing order; ties are broken by increasing ASID and address.
+ *
+ * @param profile the profile
+ * @param grain the granularity of the rows
+ * @param rows (modified) array of (at least) n rows
+ * @param n maximum number of rows
+ * @param nb_rows (modified) number of rows filled
+ * @return error code
+ */
+int tlb_profile_top(const tlb_profile_t *profile, tlb_profile_grain_t grain,
+                    tlb_profile_row_t *rows, size_t n, size_t *nb_rows);
+
+//=========================================================================
+/**
+ * @brief Print the totals and the top n pages, PUD regions and PGD regions.
+ *
+ * @param output the stream to print to
+ * @param profile the profile
+ * @param n number of rows of each top list
+ * @return error code
+ */
+int tlb_profile_print(FILE *output, const tlb_profile_t *profile, size_t n);
@@ -0,0 +1,117 @@
+/**
+ * @file translate.c
+ * @brief Trace pre-translation
+ *
+ * @date 2019
+ */
+
+#include "translate.h"
+#include "page_walk.h"
+#include "error.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+// work of one thread: a chunk of consecutive commands
+typedef struct
+{
+    const void *mem_space;
+    pte_t pgd; // page-table root in effect at the first command
+    command_t *first;
+    size_t nb_commands;
+    int error;
+} translate_chunk_t;
+
+static void *translate_chunk(void *arg)
+{
+    translate_chunk_t *chunk = arg;
+    virt_addr_t *vaddrs = calloc(chunk->nb_commands, sizeof(virt_addr_t));
+    phy_addr_t *paddrs = calloc(chunk->nb_commands, sizeof(phy_addr_t));
+    if (vaddrs == NULL || paddrs == NULL)
+    {
+        chunk->error = ERR_MEM;
+    }
+    else
+    {
+        // one batch per run of accesses between context switches (and invalidations)
+        pte_t pgd = chunk->pgd;
+        size_t begin = 0;
+        while (begin < chunk->nb_commands && chunk->error == ERR_NONE)
+        {
+            if (chunk->first[begin].order == SWITCH)
+                pgd = chunk->first[begin].pgd;
+            if (chunk->first[begin].order == SWITCH || chunk->first[begin].order == INVALIDATE)
+            {
+                ++begin;
+                continue;
+            }
+            size_t end = begin;
+            while (end < chunk->nb_commands && chunk->first[end].order != SWITCH && chunk->first[end].order != INVALIDATE)
+            {
+                vaddrs[end - begin] = chunk->first[end].vaddr;
+                ++end;
+            }
+            chunk->error = page_walk_batch(chunk->mem_space, pgd, vaddrs, paddrs, end - begin);
+            for (size_t i = begin; chunk->error == ERR_NONE && i < end; ++i)
+            {
+                chunk->first[i].paddr = paddrs[i - begin];
+                chunk->first[i].translated = 1;
+            }
+            begin = end;
+        }
+    }
+    free(paddrs);
+    free(vaddrs);
+    return NULL;
+}
+
+int program_translate(const void *mem_space, program_t *program, size_t nb_threads)
+{
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE(nb_threads > 0 && nb_threads <= TRANSLATE_MAX_THREADS, ERR_BAD_PARAMETER,
+              "number of threads (%zu) is not in [1, %d]", nb_threads, TRANSLATE_MAX_THREADS);
+    if (program->nb_lines == 0)
+        return ERR_NONE;
+    M_REQUIRE_NON_NULL(program->listing);
+
+    if (nb_threads > program->nb_lines)
+        nb_threads = program->nb_lines;
+    translate_chunk_t chunks[TRANSLATE_MAX_THREADS];
+    pthread_t threads[TRANSLATE_MAX_THREADS];
+    const size_t chunk_size = (program->nb_lines + nb_threads - 1) / nb_threads;
+
+    size_t nb_started = 0;
+    pte_t pgd = PGD_DEFAULT_ROOT;
+    size_t scanned = 0; // commands scanned for context switches so far
+    for (size_t t = 0; t < nb_threads; ++t)
+    {
+        const size_t begin = t * chunk_size;
+        if (begin >= program->nb_lines)
+            break;
+        for (; scanned < begin; ++scanned)
+            if (program->listing[scanned].order == SWITCH)
+                pgd = program->listing[scanned].pgd;
+        chunks[t].mem_space = mem_space;
+        chunks[t].pgd = pgd;
+        chunks[t].first = program->listing + begin;
+        chunks[t].nb_commands = begin + chunk_size > program->nb_lines ? program->nb_lines - begin : chunk_size;
+        chunks[t].error = ERR_NONE;
+        if (pthread_create(&threads[t], NULL, translate_chunk, &chunks[t]) != 0)
+        {
+            // run it in this thread instead
+            translate_chunk(&chunks[t]);
+            threads[t] = pthread_self();
+        }
+        ++nb_started;
+    }
+
+    int error = ERR_NONE;
+    for (size_t t = 0; t < nb_started; ++t)
+    {
+        if (!pthread_equal(threads[t], pthread_self()))
+            pthread_join(threads[t], NULL);
+        if (error == ERR_NONE)
+            error = chunks[t].error;
+    }
+    return error;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/**
+ * @file translate.h
+ * @brief Trace pre-translation: translate a whole program once so that it can
+ * be replayed (e.g. by the cache simulator) without any translation cost.
+ *
+ * @date 2019
+ */
+
+#include "commands.h"
+#include <stddef.h> // for size_t
+
+#define TRANSLATE_MAX_THREADS 64
+
+/**
+ * @brief Translate the virtual address of every command of a program, setting
+ * their paddr (and translated) fields. The page tables are assumed not to change
+ * during the program; context switches (SWITCH commands) select the page-table
+ * root used for the following commands and are not translated themselves, nor
+ * are TLB invalidations (INVALIDATE commands). The program is split into (at
+ * most) nb_threads chunks of consecutive commands, translated in parallel, each
+ * with page_walk_batch().
+ *
+ * @param mem_space starting address of the memory space
+ * @param program (modified) the program to be translated
+ * @param nb_threads number of threads to use (1 to TRANSLATE_MAX_THREADS)
+ * @return error code
+ */
+int program_translate(const void *mem_space, program_t *program, size_t nb_threads);
@@ -0,0 +1,131 @@
+/**
+ * @file ws_pool.c
+ * @brief work-stealing pool of threads
+ *
+ * @date 2019
+ */
+
+#include "ws_pool.h"
+#include "error.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define WS_CACHE_LINE 64 // to keep the queues of the workers on separate lines
+
+/**
+ * @brief the tasks left to a worker: tasks[begin] to tasks[end - 1] of the
+ * pool, taken from begin by the worker, stolen from end by the others
+ */
+typedef struct
+{
+    _Alignas(WS_CACHE_LINE) pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+} ws_queue_t;
+
+typedef struct
+{
+    ws_task_t run;
+    void *arg;
+    size_t nb_workers;
+    size_t *tasks; // the tasks of each worker, one worker after the other
+    ws_queue_t *queues;
+    atomic_int error; // first error of a task
+} ws_pool_t;
+
+typedef struct
+{
+    ws_pool_t *pool;
+    size_t worker;
+} ws_worker_arg_t;
+
+// takes a task from the queue of worker victim: its first one for the worker itself, its last one otherwise
+static int take(ws_pool_t *pool, size_t victim, int own, size_t *task)
+{
+    ws_queue_t *queue = &pool->queues[victim];
+    int taken = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->begin < queue->end)
+    {
+        *task = own ? pool->tasks[queue->begin++] : pool->tasks[--queue->end];
+        taken = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return taken;
+}
+
+// no task is ever added: once all queues are seen empty, there is nothing left to do
+static void *work(void *arg)
+{
+    const ws_worker_arg_t *a = arg;
+    ws_pool_t *pool = a->pool;
+    while (atomic_load(&pool->error) == ERR_NONE)
+    {
+        size_t task = 0;
+        int taken = take(pool, a->worker, 1, &task);
+        for (size_t k = 1; !taken && k < pool->nb_workers; ++k)
+            taken = take(pool, (a->worker + k) % pool->nb_workers, 0, &task);
+        if (!taken)
+            break;
+        const int err = pool->run(pool->arg, task, a->worker);
+        if (err != ERR_NONE)
+        {
+            int none = ERR_NONE;
+            atomic_compare_exchange_strong(&pool->error, &none, err);
+        }
+    }
+    return NULL;
+}
+
+int ws_pool_run(ws_task_t run, void *arg, size_t nb_tasks, size_t nb_workers)
+{
+    M_REQUIRE_NON_NULL(run);
+    M_REQUIRE(nb_workers > 0 && nb_workers <= WS_POOL_MAX_WORKERS, ERR_BAD_PARAMETER,
+              "number of workers (%zu) is not in [1, %d]", nb_workers, WS_POOL_MAX_WORKERS);
+    if (nb_tasks == 0)
+        return ERR_NONE;
+    if (nb_workers > nb_tasks)
+        nb_workers = nb_tasks;
+
+    ws_pool_t pool = { run, arg, nb_workers, NULL, NULL, ERR_NONE };
+    pool.tasks = calloc(nb_tasks, sizeof(size_t));
+    pool.queues = aligned_alloc(WS_CACHE_LINE, nb_workers * sizeof(ws_queue_t));
+    if (pool.tasks == NULL || pool.queues == NULL)
+    {
+        free(pool.tasks);
+        free(pool.queues);
+        return ERR_MEM;
+    }
+    // round robin: worker w gets tasks w, w + nb_workers, ...
+    size_t next = 0;
+    for (size_t w = 0; w < nb_workers; ++w)
+    {
+        pthread_mutex_init(&pool.queues[w].lock, NULL);
+        pool.queues[w].begin = next;
+        for (size_t t = w; t < nb_tasks; t += nb_workers)
+            pool.tasks[next++] = t;
+        pool.queues[w].end = next;
+    }
+
+    pthread_t threads[WS_POOL_MAX_WORKERS];
+    int started[WS_POOL_MAX_WORKERS] = { 0 };
+    ws_worker_arg_t args[WS_POOL_MAX_WORKERS];
+    for (size_t w = 0; w < nb_workers; ++w)
+        args[w] = (ws_worker_arg_t){ &pool, w };
+    for (size_t w = 1; w < nb_workers; ++w)
+        started[w] = pthread_create(&threads[w], NULL, work, &args[w]) == 0;
+    work(&args[0]);
+    for (size_t w = 1; w < nb_workers; ++w)
+    {
+        if (started[w])
+            pthread_join(threads[w], NULL);
+    }
+
+    for (size_t w = 0; w < nb_workers; ++w)
+        pthread_mutex_destroy(&pool.queues[w].lock);
+    free(pool.queues);
+    free(pool.tasks);
+    return atomic_load(&pool.error);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * @file ws_pool.h
+ * @brief work-stealing pool of threads running a fixed set of independent
+ * tasks: the tasks are dealt round robin to the workers, each worker taking
+ * its own tasks in the given order, and, once out of tasks, stealing the
+ * last task of another worker. Tasks are coarse (whole traces or large
+ * parts of them): each queue is protected by its own mutex.
+ *
+ * @date 2019
+ */
+
+#include <stddef.h> // for size_t
+
+#define WS_POOL_MAX_WORKERS 64
+
+/**
+ * @brief a task: runs task number task (of nb_tasks) on behalf of worker
+ * number worker (of nb_workers); an error stops the pool
+ */
+typedef int (*ws_task_t)(void *arg, size_t task, size_t worker);
+
+//=========================================================================
+/**
+ * @brief Run tasks 0 to nb_tasks - 1 on nb_workers threads (the calling
+ * thread being worker 0), until all are done or one of them fails. A worker
+ * which cannot be started leaves its tasks to be stolen by the others.
+ *
+ * @param run the function running a task
+ * @param arg its first argument
+ * @param nb_tasks the number of tasks, best given from the longest to the shortest
+ * @param nb_workers the number of workers, from 1 to WS_POOL_MAX_WORKERS
+ * @return error code: the first error of a task
+ */
+int ws_pool_run(ws_task_t run, void *arg, size_t nb_tasks, size_t nb_workers);